@@ -0,0 +1,104 @@
+#ifndef AOT_RUNTIME_H
+#define AOT_RUNTIME_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+// Native code for one basic block, generated by chip8-aot. It is entered at
+// any of its instructions (entry) with executed < budget instructions run so
+// far, stops once budget is reached and returns the new count. A statically
+// known successor whose valid flag is set is tail-called rather than returned
+// to the runner.
+using AotBlockCode = uint32_t (*)(Chip8& chip8, const uint8_t* valid, uint32_t budget, uint32_t executed,
+                                  uint16_t entry);
+
+struct AotBlock {
+    uint16_t start;
+    uint16_t end;
+    AotBlockCode code;
+};
+
+// A ROM recompiled to C++ and linked into the program. It is used for a
+// loaded ROM with the same bytes and quirk profile; each block only runs while
+// memory still holds the bytes it was compiled from.
+struct AotProgram {
+    const char* name;
+    const uint8_t* rom;
+    size_t romSize;
+    uint64_t romHash;       // HashBytes(rom, romSize)
+    QuirkProfile quirks;
+    const AotBlock* blocks;
+    size_t blockCount;
+};
+
+// Generated files register their program during static initialization
+void RegisterAotProgram(const AotProgram& program);
+
+// The registered program compiled from exactly these bytes for profile, or null
+const AotProgram* FindAotProgram(const uint8_t* rom, size_t size, QuirkProfile profile);
+
+struct AotRegistration {
+    explicit AotRegistration(const AotProgram& program) { RegisterAotProgram(program); }
+};
+
+// What recompiled code may touch inside a Chip8; anything beyond plain
+// register arithmetic runs through the interpreter's own handlers
+class AotAccess {
+public:
+    static uint8_t* Registers(Chip8& chip8) { return chip8.m_Register; }
+    static uint16_t& Index(Chip8& chip8) { return chip8.m_IndexRegister; }
+    static uint8_t& DelayTimer(Chip8& chip8) { return chip8.m_DelayTimer; }
+    static uint8_t& SoundTimer(Chip8& chip8) { return chip8.m_SoundTimer; }
+    static const uint8_t* Keypad(const Chip8& chip8) { return chip8.m_Keypad; }
+
+    // Leaves the block with the next instruction at pc
+    static uint32_t Exit(Chip8& chip8, uint16_t pc, uint32_t executed) {
+        chip8.m_ProgramCounter = pc;
+        return executed;
+    }
+
+    // Runs the instruction at address through its handler, with the program
+    // counter already past it as the interpreter has it
+    template <QuirkProfile Profile>
+    static void Call(Chip8& chip8, uint16_t address, OpcodeId id, uint16_t opcode) {
+        Instruction ins{ nullptr, opcode, static_cast<uint16_t>(opcode & 0x0FFF),
+                         static_cast<uint8_t>((opcode >> 8) & 0xF), static_cast<uint8_t>((opcode >> 4) & 0xF),
+                         static_cast<uint8_t>(opcode & 0xFF), static_cast<uint8_t>(opcode & 0xF) };
+        chip8.m_ProgramCounter = address + 2;
+        Chip8::s_Handlers[static_cast<size_t>(Profile)][static_cast<size_t>(id)](chip8, ins);
+    }
+};
+
+// Runs a Chip8 on a linked AotProgram. Addresses without a valid block
+// (computed jump targets, code outside the image, blocks overwritten at run
+// time) are interpreted one instruction at a time.
+class AotRunner {
+private:
+    const AotProgram& m_Program;
+    std::array<uint16_t, MEMORY_SIZE> m_BlockIndex{}; // Block index + 1 by instruction address
+    std::bitset<MEMORY_SIZE> m_Code;                   // Bytes inside any block
+    std::vector<uint8_t> m_Valid;
+
+    void InvalidateRange(unsigned int address, unsigned int last);
+
+public:
+    explicit AotRunner(const AotProgram& program);
+
+    const AotProgram& GetProgram() const { return m_Program; }
+
+    void Execute(Chip8& chip8, uint32_t cycles);
+    void Invalidate(uint16_t address, uint16_t length);
+
+    // Re-checks every block against memory, after a load or reset
+    void Flush(const Chip8& chip8);
+};
+
+} // namespace Chip8Emulator
+
+#endif // AOT_RUNTIME_H
@@ -0,0 +1,56 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "chip8.hpp"
+#include "triple_buffer.hpp"
+
+namespace Chip8Emulator{
+
+constexpr unsigned int AUDIO_SAMPLE_RATE = 44100;
+constexpr double BEEP_FREQUENCY = 440.0;  // Hz, the plain CHIP-8 square wave
+constexpr float AUDIO_VOLUME = 0.25f;
+
+// XO-CHIP plays its 128-bit pattern at 4000 * 2^((pitch - 64) / 48) bits per second
+constexpr double PATTERN_BASE_RATE = 4000.0;
+
+// What the buzzer sounds like while the sound timer runs
+struct Tone {
+    uint8_t pattern[AUDIO_PATTERN_SIZE];
+    uint8_t pitch;
+    bool usePattern; // Otherwise a BEEP_FREQUENCY square wave
+};
+
+// Synthesizes the buzzer on the audio thread. The emulation thread raises and
+// drops a flag as the sound timer starts and stops, and publishes the tone
+// only when it changes; the audio callback reads the flag before every sample,
+// so a tone lasts exactly as long as the timer, to the sample. Neither side
+// ever blocks or allocates.
+class ToneGenerator {
+public:
+    // Emulation side
+    void SetPlaying(bool playing) { m_Playing.store(playing, std::memory_order_relaxed); }
+    void SetTone(const Tone& tone);
+
+    // Audio side: fills frames mono float samples
+    void Generate(float* samples, size_t frames);
+
+private:
+    std::atomic<bool> m_Playing{false};
+    TripleBuffer<Tone> m_Tones;
+    Tone m_Published{};
+
+    // Audio thread state
+    Tone m_Tone{};
+    double m_Step = BEEP_FREQUENCY / AUDIO_SAMPLE_RATE; // Periods (square) or bits (pattern) per sample
+    double m_Phase = 0.0;
+};
+
+// The buzzer state of chip8, for ToneGenerator::SetTone
+Tone CurrentTone(const Chip8& chip8);
+
+} // namespace Chip8Emulator
+
+#endif // AUDIO_H
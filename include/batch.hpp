@@ -0,0 +1,76 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "chip8.hpp"
+#include "save_state.hpp"
+
+namespace Chip8Emulator{
+
+// Lanes are padded to a multiple of the widest SIMD vector (32 bytes for AVX2)
+constexpr size_t BATCH_LANE_ALIGNMENT = 32;
+
+// Runs many Chip8 machines in lockstep. All state is stored structure-of-arrays,
+// lane index innermost, so one instruction executed by every lane at the same
+// PC is a handful of vector operations. Lanes that diverge (different PC or a
+// self-modified opcode) are executed as separate masked groups within the
+// same cycle. Each lane behaves exactly like a single Chip8 instance.
+class Chip8Batch {
+private:
+    size_t m_Lanes;
+    size_t m_Stride;
+
+    // Element [i * m_Stride + lane]
+    std::unique_ptr<uint8_t[]> m_Data;          // MEMORY_SIZE rows
+    std::unique_ptr<uint8_t[]> m_Register;      // REGISTER_COUNT rows
+    std::unique_ptr<uint16_t[]> m_Stack;        // STACK_LEVELS rows
+    std::unique_ptr<uint8_t[]> m_Keypad;        // KEY_COUNT rows
+
+    // Element [lane]
+    std::unique_ptr<uint16_t[]> m_IndexRegister;
+    std::unique_ptr<uint16_t[]> m_ProgramCounter;
+    std::unique_ptr<uint8_t[]> m_StackPointer;
+    std::unique_ptr<uint8_t[]> m_DelayTimer;
+    std::unique_ptr<uint8_t[]> m_SoundTimer;
+
+    // Lane masks (0xFF or 0x00): lanes executing the current group, and lanes
+    // that have not executed an instruction yet this cycle
+    std::unique_ptr<uint8_t[]> m_Active;
+    std::unique_ptr<uint8_t[]> m_Pending;
+
+    // Element [lane * VIDEO_HEIGHT + row]; one contiguous array for all lanes
+    std::unique_ptr<uint64_t[]> m_Display;
+
+    std::vector<Xorshift> m_RandGen;
+
+    uint8_t* Row(uint8_t* base, unsigned int row) const { return base + row * m_Stride; }
+    uint8_t* Register(unsigned int x) const { return Row(m_Register.get(), x); }
+
+    void Step();
+    void Execute(const Instruction& ins, OpcodeId id);
+
+public:
+    explicit Chip8Batch(size_t lanes);
+    void LoadROM(const char* filename);
+    void Run(uint32_t cycles);
+    void DecrementTimers();
+
+    size_t GetLaneCount() const { return m_Lanes; }
+    void SetKeys(size_t lane, uint16_t keys);
+    void Seed(size_t lane, uint64_t seed);
+    // The lane's machine in Chip8's save state format, so a Chip8 can load
+    // it and carry on, or compare itself against it
+    void SaveState(size_t lane, MachineState& state) const;
+
+    // VIDEO_HEIGHT packed rows per lane, lanes back to back
+    const uint64_t* getDisplays() const { return m_Display.get(); }
+    const uint64_t* getDisplay(size_t lane) const { return m_Display.get() + lane * VIDEO_HEIGHT; }
+    const uint8_t* getSoundTimers() const { return m_SoundTimer.get(); }
+};
+
+} // namespace Chip8Emulator
+
+#endif // BATCH_H
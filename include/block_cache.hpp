@@ -0,0 +1,54 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+constexpr unsigned int MAX_BLOCK_LENGTH = 32;
+
+// True for instructions that may change the program counter or write memory
+bool EndsBlock(OpcodeId id);
+// True for the stores, Fx33 and Fx55. The block cache and the JIT keep them
+// inside a block and leave it early only if the store overwrote the block.
+bool WritesMemory(OpcodeId id);
+
+// A straight-line run of decoded instructions. The last instruction is the
+// only one that may change the program counter; stores may appear anywhere.
+struct DecodedBlock {
+    uint16_t start;
+    uint16_t end;
+    uint16_t count;
+    bool valid;
+    uint32_t stores; // Bit i set: instruction i writes memory
+    Instruction instructions[MAX_BLOCK_LENGTH];
+};
+
+static_assert(MAX_BLOCK_LENGTH <= 32, "DecodedBlock::stores has a bit per instruction");
+
+// Caches decoded blocks keyed by their start address and executes them whole.
+// Blocks overlapping a memory write are invalidated and rebuilt on next use;
+// a block that invalidates itself stops after the store.
+class BlockCache {
+private:
+    std::array<uint16_t, MEMORY_SIZE> m_BlockIndex{};
+    std::vector<DecodedBlock> m_Blocks;
+    CodeMap m_CodeBytes;
+
+    const DecodedBlock* Lookup(const Chip8& chip8, uint16_t pc);
+    void Build(const Chip8& chip8, uint16_t pc, DecodedBlock& block);
+    uint32_t ExecuteWithStores(Chip8& chip8, const DecodedBlock& block, uint32_t count);
+    void InvalidateRange(unsigned int address, unsigned int last);
+
+public:
+    void Execute(Chip8& chip8, uint32_t cycles);
+    void Invalidate(uint16_t address, uint16_t length);
+    void Flush();
+};
+
+} // namespace Chip8Emulator
+
+#endif // BLOCK_CACHE_H
@@ -0,0 +1,85 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "chip8.hpp"
+#include "emulation_thread.hpp"
+
+namespace Chip8Emulator{
+
+// Raw is a headerless stream of 1-bpp frames: for each plane, each row's
+// width / 8 bytes, most significant bit leftmost. Ppm writes one P6 image per
+// frame to <path>-000000.ppm, <path>-000001.ppm, ... Gif writes one animated
+// GIF, each frame only the rectangle that changed since the last.
+enum class CaptureFormat {
+    Raw,
+    Ppm,
+    Gif
+};
+
+// Parses "raw", "ppm" or "gif"
+bool ParseCaptureFormat(const std::string& name, CaptureFormat& format);
+
+constexpr uint32_t CAPTURE_RING_FRAMES = 256;
+
+class FrameEncoder;
+
+// Records one display per 60 Hz tick. Capture copies the display into a
+// preallocated ring slot; a background thread encodes and writes the frames.
+class FrameCapture {
+public:
+    // PPM and GIF frames are drawn on a canvas the size of the variant's
+    // largest display, scaled up by scale; low-resolution frames fill it too.
+    // Throws runtime_error if the output cannot be opened.
+    FrameCapture(const std::string& path, CaptureFormat format, Variant variant, unsigned int scale = 1,
+                 uint32_t ringFrames = CAPTURE_RING_FRAMES);
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Emulation side, once per tick. With the ring full the frame is dropped
+    // and false returned, unless wait is set: then it waits for the encoder,
+    // for runs that have no real-time clock to keep.
+    bool Capture(const Chip8& chip8, bool wait = false);
+
+    // Encodes what is queued, finishes the output and rethrows any encoder error
+    void Stop();
+
+    uint64_t GetCapturedCount() const { return m_Tick - m_Dropped; }
+    uint64_t GetDroppedCount() const { return m_Dropped; }
+
+private:
+    struct Slot {
+        Frame frame;
+        uint64_t tick;
+    };
+
+    std::unique_ptr<FrameEncoder> m_Encoder;
+    std::vector<Slot> m_Slots;
+
+    // Producer-owned counters
+    uint64_t m_Tick = 0;
+    uint64_t m_Dropped = 0;
+
+    alignas(64) std::atomic<uint64_t> m_Head{0}; // Next slot to encode
+    alignas(64) std::atomic<uint64_t> m_Tail{0}; // Next slot to fill
+    std::atomic<uint32_t> m_Signal{0};           // Bumped on every push and on stop
+    std::atomic<bool> m_Stopping{false};
+    std::atomic<bool> m_Failed{false};           // Set once m_Error is
+
+    std::thread m_Thread;
+    std::exception_ptr m_Error;
+
+    void Main();
+};
+
+} // namespace Chip8Emulator
+
+#endif // CAPTURE_H
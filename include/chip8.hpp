@@ -2,27 +2,228 @@
 #define CHIP8_H
 
 #include <iostream>
+#include <cstdint>
+#include <cstddef>
 #include <chrono>
-#include <random>
-#include <unordered_map>
+#include <type_traits>
 #include <array>
-#include <functional>
-#include <set>
+#include <bitset>
+#include <memory>
+#include <string>
+#include "xorshift.hpp"
+
+// Set to 1 (CMake option CHIP8_PROFILE) to collect a Profiler for every Chip8
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+
+// Set to 1 (CMake option CHIP8_TRACE) to allow a per-instruction Tracer
+#ifndef CHIP8_TRACE
+#define CHIP8_TRACE 0
+#endif
+
+// Instrumented builds interpret every instruction, idle loops included
+#define CHIP8_INSTRUMENTED (CHIP8_PROFILE || CHIP8_TRACE)
 
 namespace Chip8Emulator{
 
 constexpr unsigned int KEY_COUNT = 16;
-constexpr unsigned int MEMORY_SIZE = 4096;
+constexpr unsigned int MEMORY_SIZE = 4096;          // CHIP-8 and SUPER-CHIP address space
+constexpr unsigned int MAX_MEMORY_SIZE = 0x10000;   // XO-CHIP address space
 constexpr unsigned int REGISTER_COUNT = 16;
 constexpr unsigned int STACK_LEVELS = 16;
 constexpr unsigned int VIDEO_HEIGHT = 32;
 constexpr unsigned int VIDEO_WIDTH = 64;
+constexpr unsigned int HIRES_HEIGHT = 64;
+constexpr unsigned int HIRES_WIDTH = 128;
+constexpr unsigned int MAX_PLANES = 4;
+constexpr unsigned int AUDIO_PATTERN_SIZE = 16;
 constexpr unsigned int START_ADDR = 0x200;
 constexpr unsigned int FONTSET_START_ADDR = 0x50;
+constexpr unsigned int BIG_FONTSET_START_ADDR = 0xA0;
+
+// Each display plane is packed 64 pixels per uint64_t, most significant bit
+// first, row after row: one word per row in low resolution (64x32) and two in
+// high resolution (128x64).
+constexpr unsigned int DISPLAY_WORDS = HIRES_HEIGHT * HIRES_WIDTH / 64;
+
+// Platform the ROM was written for. SuperChip adds the 128x64 mode, scrolling,
+// 16x16 sprites, the large font and flag registers; XoChip adds 64 KB of
+// memory, bitplanes, F000 nnnn, 5xy2/5xy3 and the audio pattern buffer.
+enum class Variant : uint8_t {
+    Chip8,
+    SuperChip,
+    XoChip
+};
+
+// Parses "chip8", "schip" or "xochip"
+bool ParseVariant(const std::string& name, Variant& variant);
+// The name ParseVariant accepts
+const char* VariantName(Variant variant);
+
+// Behaviours on which CHIP-8 implementations disagree
+struct Quirks {
+    bool shiftUsesVy;       // 8xy6/8xyE set Vx to Vy shifted instead of shifting Vx
+    bool memoryIncrementsI; // Fx55/Fx65 leave I just past the last register
+    bool logicResetsVf;     // 8xy1/8xy2/8xy3 clear VF
+    bool wrapSprites;       // Dxyn wraps at the screen edges instead of clipping
+    bool jumpUsesVx;        // Bxnn jumps to xnn + Vx instead of nnn + V0
+};
+
+// Modern is what this core has always run; Cosmac is the original COSMAC VIP
+// interpreter. Each profile gets its own instantiation of the handlers that
+// depend on a quirk, so a profile's code has no branches for the others.
+enum class QuirkProfile : uint8_t {
+    Modern,
+    Cosmac,
+    SuperChip,
+    XoChip,
+    Count
+};
+
+// Indexed by QuirkProfile
+inline constexpr Quirks QUIRK_PROFILES[] = {
+    { false, false, false, false, false },
+    { true,  true,  true,  false, false },
+    { false, false, false, false, true  },
+    { true,  true,  false, true,  false },
+};
+
+static_assert(std::size(QUIRK_PROFILES) == static_cast<size_t>(QuirkProfile::Count));
+
+constexpr const Quirks& GetQuirks(QuirkProfile profile) {
+    return QUIRK_PROFILES[static_cast<size_t>(profile)];
+}
+
+// The profile SetVariant selects
+constexpr QuirkProfile DefaultQuirkProfile(Variant variant) {
+    switch (variant) {
+        case Variant::SuperChip: return QuirkProfile::SuperChip;
+        case Variant::XoChip: return QuirkProfile::XoChip;
+        default: return QuirkProfile::Modern;
+    }
+}
+
+// Parses "modern", "cosmac", "schip" or "xochip"
+bool ParseQuirkProfile(const std::string& name, QuirkProfile& profile);
+// The name ParseQuirkProfile accepts
+const char* QuirkProfileName(QuirkProfile profile);
+
+// Decode table index: high nibble and low byte of the opcode packed into 12 bits
+constexpr unsigned int DECODE_TABLE_SIZE = 16 * 256;
+
+enum class OpcodeId : uint8_t {
+    Unknown,
+    OP_00E0, OP_00EE, OP_1nnn, OP_2nnn, OP_3xkk, OP_4xkk, OP_5xy0, OP_6xkk, OP_7xkk,
+    OP_8xy0, OP_8xy1, OP_8xy2, OP_8xy3, OP_8xy4, OP_8xy5, OP_8xy6, OP_8xy7, OP_8xyE,
+    OP_9xy0, OP_Annn, OP_Bnnn, OP_Cxkk, OP_Dxyn, OP_Ex9E, OP_ExA1,
+    OP_Fx07, OP_Fx0A, OP_Fx15, OP_Fx18, OP_Fx1E, OP_Fx29, OP_Fx33, OP_Fx55, OP_Fx65,
+    // SUPER-CHIP
+    OP_00Cn, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF, OP_Fx30, OP_Fx75, OP_Fx85,
+    // XO-CHIP
+    OP_00Dn, OP_5xy2, OP_5xy3, OP_F000, OP_Fn01, OP_F002, OP_Fx3A,
+    Count
+};
+
+class Chip8;
+class BlockCache;
+class JitCompiler;
+class AotRunner;
+class AotAccess;
+class Debugger;
+struct MachineState;
+class Profiler;
+class Tracer;
+
+// Interpreter decodes and runs one instruction at a time and is the reference
+// behaviour; BlockCache runs cached, pre-decoded straight-line blocks; Jit
+// runs blocks translated to native x86-64 code; Aot runs the ROM's basic
+// blocks recompiled to C++ by chip8-aot and linked in, where there are any.
+enum class ExecutionMode {
+    Interpreter,
+    BlockCache,
+    Jit,
+    Aot
+};
+
+// Parses "interpreter", "block", "jit" or "aot"
+bool ParseExecutionMode(const std::string& name, ExecutionMode& mode);
+
+// A decoded opcode: the handler to run plus its operands, extracted once
+struct Instruction {
+    void (*handler)(Chip8&, const Instruction&);
+    uint16_t opcode;
+    uint16_t nnn;
+    uint8_t x;
+    uint8_t y;
+    uint8_t kk;
+    uint8_t n;
+};
+
+// Opcodes a variant does not define decode as Unknown
+OpcodeId DecodeOpcodeId(uint16_t opcode, Variant variant = Variant::Chip8);
+
+// Calls func(first, last) for the bytes [address, address + length) of the
+// 4 KB space the translated backends cover: once, or twice when the write
+// wraps past 0xFFF as Fx55 and Fx33 can
+template <typename Func>
+void ForEachWrittenRange(uint16_t address, uint16_t length, Func func) {
+    unsigned int first = address & (MEMORY_SIZE - 1);
+    unsigned int end = first + length;
+    if (length == 0) {
+        return;
+    }
+    if (end > MEMORY_SIZE) {
+        func(first, MEMORY_SIZE - 1);
+        func(0u, (end - 1) & (MEMORY_SIZE - 1));
+    } else {
+        func(first, end - 1);
+    }
+}
+
+// The bytes of the 4 KB space that hold translated code, summarized per
+// 64-byte page in one word so a store away from all code costs one test
+class CodeMap {
+public:
+    void Set(unsigned int address) {
+        m_Bytes.set(address);
+        m_Pages |= 1ull << (address / PAGE_SIZE);
+    }
+
+    // True if any byte of [first, last] holds code
+    bool Touches(unsigned int first, unsigned int last) const {
+        uint64_t pages = (~0ull << (first / PAGE_SIZE)) & (~0ull >> (63 - last / PAGE_SIZE));
+        if ((m_Pages & pages) == 0) {
+            return false;
+        }
+        for (unsigned int i = first; i <= last; i++) {
+            if (m_Bytes.test(i)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Reset() {
+        m_Bytes.reset();
+        m_Pages = 0;
+    }
 
-class Chip8 {
 private:
-    uint8_t m_Data[MEMORY_SIZE]{};
+    static constexpr unsigned int PAGE_SIZE = MEMORY_SIZE / 64;
+
+    std::bitset<MEMORY_SIZE> m_Bytes;
+    uint64_t m_Pages = 0;
+};
+
+// Everything that makes up a running CHIP-8 machine, as one trivially
+// copyable block: copying it forks the machine, random stream included.
+// Only CHIP-8's 4 KB of memory and its one low-resolution plane are held
+// here; the larger variants keep their memory or display in buffers Chip8
+// allocates for them. Chip8 inherits it privately, so the fields read as its
+// own members.
+struct Chip8State {
+    uint8_t m_Memory[MEMORY_SIZE]{};
     uint8_t m_Register[REGISTER_COUNT]{};
     uint16_t m_IndexRegister{};
     uint16_t m_ProgramCounter{};
@@ -30,74 +231,230 @@ private:
     uint16_t m_Stack[STACK_LEVELS]{};
     uint8_t m_DelayTimer{};
     uint8_t m_SoundTimer{};
-    uint16_t m_Opcode{};
     uint8_t m_Keypad[KEY_COUNT]{};
-    uint32_t m_Display[VIDEO_WIDTH * VIDEO_HEIGHT]{};
-    std::default_random_engine m_RandGen;
-    std::uniform_int_distribution<uint8_t> m_RandomByte;
-
-    using OpcodeFunc = void (Chip8::*)();
-    std::unordered_map<uint8_t, OpcodeFunc> m_OpcodeTable;
-    std::unordered_map<uint8_t, OpcodeFunc> m_OpcodeTable0;
-    std::unordered_map<uint8_t, OpcodeFunc> m_OpcodeTable8;
-    std::unordered_map<uint8_t, OpcodeFunc> m_OpcodeTableE;
-    std::unordered_map<uint8_t, OpcodeFunc> m_OpcodeTableF;
-
-    void OP_00E0();
-    void OP_00EE();
-    void OP_1nnn();
-    void OP_2nnn();
-    void OP_3xkk();
-    void OP_4xkk();
-    void OP_5xy0();
-    void OP_6xkk();
-    void OP_7xkk();
-    void OP_8xy0();
-    void OP_8xy1();
-    void OP_8xy2();
-    void OP_8xy3();
-    void OP_8xy4();
-    void OP_8xy5();
-    void OP_8xy6();
-    void OP_8xy7();
-    void OP_8xyE();
-    void OP_9xy0();
-    void OP_Annn();
-    void OP_Bnnn();
-    void OP_Cxkk();
-    void OP_Dxyn();
-    void OP_Ex9E();
-    void OP_ExA1();
-    void OP_Fx07();
-    void OP_Fx0A();
-    void OP_Fx15();
-    void OP_Fx18();
-    void OP_Fx1E();
-    void OP_Fx29();
-    void OP_Fx33();
-    void OP_Fx55();
-    void OP_Fx65();
-
-    void Nibble0();
-    void Nibble8();
-    void NibbleE();
-    void NibbleF();
-
-    void InitializeOpcodeTable();
-    void ExecuteOpcode(const std::unordered_map<uint8_t, OpcodeFunc>& byteMap, uint8_t opcode);
-    void DecodeOpcode();
-    void setOpcodeFunction(uint8_t opcode, void (Chip8::*func)());
+    uint64_t m_LowResPlane[VIDEO_HEIGHT]{};
+    uint64_t m_DirtyRows = ~0ull; // Bit n set: display row n changed since ClearDisplayDirty()
+    Variant m_Variant = Variant::Chip8;
+    QuirkProfile m_QuirkProfile = QuirkProfile::Modern;
+    uint16_t m_AddressMask = MEMORY_SIZE - 1;
+    bool m_HiRes = false;
+    uint8_t m_PlaneMask = 1;   // Planes drawn to, cleared and scrolled
+    uint8_t m_Flags[REGISTER_COUNT]{};
+    uint8_t m_AudioPattern[AUDIO_PATTERN_SIZE]{};
+    uint8_t m_Pitch = 64;
+    Xorshift m_RandGen;
+    uint64_t m_CycleCount = 0;
+    uint64_t m_IdleCycles = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<Chip8State>, "Forking copies Chip8State as raw bytes");
+static_assert(sizeof(Chip8State) < 5 * 1024, "A CHIP-8 fork should stay a small copy");
+
+class Chip8 : private Chip8State {
+private:
+    // The variant's memory and display: Chip8State's own arrays on CHIP-8,
+    // the buffers below on SUPER-CHIP and XO-CHIP. Plane p starts at
+    // m_Display + p * DISPLAY_WORDS.
+    uint8_t* m_Data = m_Memory;
+    uint64_t* m_Display = m_LowResPlane;
+    std::unique_ptr<uint8_t[]> m_ExtendedMemory;    // XO-CHIP's 64 KB
+    std::unique_ptr<uint64_t[]> m_ExtendedDisplay;  // SUPER-CHIP's hi-res plane, XO-CHIP's four
+    size_t m_ExtendedDisplayWords = 0;
+
+    ExecutionMode m_Mode = ExecutionMode::Interpreter;
+    std::unique_ptr<BlockCache> m_BlockCache;
+    std::unique_ptr<JitCompiler> m_Jit;
+    std::unique_ptr<AotRunner> m_Aot;
+#if CHIP8_PROFILE
+    std::unique_ptr<Profiler> m_Profiler;
+#endif
+#if CHIP8_TRACE
+    Tracer* m_Tracer = nullptr;
+#endif
+
+    friend class BlockCache;
+    friend class JitCompiler;
+    friend class AotRunner;
+    friend class AotAccess;
+    friend class Chip8Batch;
+    friend class Debugger;
+
+    using OpcodeFunc = void (*)(Chip8&, const Instruction&);
+    using HandlerTable = std::array<OpcodeFunc, static_cast<size_t>(OpcodeId::Count)>;
+
+    // One table per QuirkProfile
+    static const HandlerTable s_Handlers[static_cast<size_t>(QuirkProfile::Count)];
+
+    template <QuirkProfile Profile>
+    static constexpr HandlerTable MakeHandlerTable();
+
+    template <void (Chip8::*Func)(const Instruction&)>
+    static void Invoke(Chip8& chip8, const Instruction& ins) { (chip8.*Func)(ins); }
+
+    static Instruction Decode(uint16_t opcode, Variant variant = Variant::Chip8,
+                              QuirkProfile profile = QuirkProfile::Modern);
+
+    // Interpreter loop of the selected profile, bound by SetQuirkProfile
+    void (Chip8::*m_Interpret)(uint32_t cycles) = &Chip8::Interpret<QuirkProfile::Modern>;
+
+    template <QuirkProfile Profile>
+    void Interpret(uint32_t cycles);
+
+    template <QuirkProfile Profile>
+    void Step();
+
+    template <QuirkProfile Profile, typename Hooks>
+    uint32_t InterpretWithHooks(uint32_t cycles, Hooks& hooks);
+
+    void OP_Unknown(const Instruction& ins);
+    void OP_00E0(const Instruction& ins);
+    void OP_00EE(const Instruction& ins);
+    void OP_1nnn(const Instruction& ins);
+    void OP_2nnn(const Instruction& ins);
+    void OP_3xkk(const Instruction& ins);
+    void OP_4xkk(const Instruction& ins);
+    void OP_5xy0(const Instruction& ins);
+    void OP_6xkk(const Instruction& ins);
+    void OP_7xkk(const Instruction& ins);
+    void OP_8xy0(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_8xy1(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_8xy2(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_8xy3(const Instruction& ins);
+    void OP_8xy4(const Instruction& ins);
+    void OP_8xy5(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_8xy6(const Instruction& ins);
+    void OP_8xy7(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_8xyE(const Instruction& ins);
+    void OP_9xy0(const Instruction& ins);
+    void OP_Annn(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_Bnnn(const Instruction& ins);
+    void OP_Cxkk(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_Dxyn(const Instruction& ins);
+    void OP_Ex9E(const Instruction& ins);
+    void OP_ExA1(const Instruction& ins);
+    void OP_Fx07(const Instruction& ins);
+    void OP_Fx0A(const Instruction& ins);
+    void OP_Fx15(const Instruction& ins);
+    void OP_Fx18(const Instruction& ins);
+    void OP_Fx1E(const Instruction& ins);
+    void OP_Fx29(const Instruction& ins);
+    void OP_Fx33(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_Fx55(const Instruction& ins);
+    template <QuirkProfile Profile> void OP_Fx65(const Instruction& ins);
+    void OP_00Cn(const Instruction& ins);
+    void OP_00FB(const Instruction& ins);
+    void OP_00FC(const Instruction& ins);
+    void OP_00FD(const Instruction& ins);
+    void OP_00FE(const Instruction& ins);
+    void OP_00FF(const Instruction& ins);
+    void OP_Fx30(const Instruction& ins);
+    void OP_Fx75(const Instruction& ins);
+    void OP_Fx85(const Instruction& ins);
+    void OP_00Dn(const Instruction& ins);
+    void OP_5xy2(const Instruction& ins);
+    void OP_5xy3(const Instruction& ins);
+    void OP_F000(const Instruction& ins);
+    void OP_Fn01(const Instruction& ins);
+    void OP_F002(const Instruction& ins);
+    void OP_Fx3A(const Instruction& ins);
+
+    // Skips the next instruction; on XO-CHIP that is both words of F000 nnnn
+    void SkipNext();
+
+    // Draws an n-row 8-pixel or (n == 0, SUPER-CHIP on) 16x16 sprite into every selected plane
+    template <QuirkProfile Profile>
+    void DrawSprite(const Instruction& ins);
+
+    void SetResolution(bool hiRes);
+    void ScrollVertical(int rows);
+    void ScrollHorizontal(int pixels);
+
+    void OnMemoryWrite(uint16_t address, uint16_t length);
+    // Drops translated code after memory was replaced wholesale
+    void FlushBackends();
+    // Points m_Data and m_Display at the variant's storage, allocating or
+    // freeing the buffers the larger variants need
+    void SelectStorage();
+    // Words of display storage the variant uses, all planes together
+    size_t GetDisplayStorageWords() const;
+    uint64_t* Plane(unsigned int plane) { return m_Display + plane * DISPLAY_WORDS; }
+    // Gives a copy of other its own caches for other's execution mode
+    void CopyBackends(const Chip8& other);
+    // Gives a copy of other its own copy of other's extended memory and display
+    void CopyStorage(const Chip8& other);
+
+    // Runs cycles on the selected backend
+    void Execute(uint32_t cycles);
+
+    // How many of the next cycles can be skipped because the machine is
+    // spinning in a busy-wait that cannot end before the keypad or the timers
+    // change, neither of which happens inside Run()
+    uint32_t IdleCycles(uint32_t cycles) const;
+    bool IsTimerPollLoop(uint16_t head) const;
+    bool IsTimerPollLoopShape(uint16_t head) const;
+    // Cycles to run before IdleCycles is worth asking again
+    uint32_t CyclesToIdleCheck() const;
 
 public:
     Chip8();
+    explicit Chip8(uint64_t seed);
+    // Forks other: the machine state is copied as one block, along with the
+    // larger variants' memory and display, and the copy rebuilds its own
+    // caches for the same execution mode. Forking into an interpreting
+    // instance of the same variant allocates nothing.
+    Chip8(const Chip8& other);
+    Chip8& operator=(const Chip8& other);
+    // Selects the platform and its default quirk profile and resets the
+    // machine, so call it before LoadROM
+    void SetVariant(Variant variant);
+    Variant GetVariant() const { return m_Variant; }
+    // Overrides the variant's quirk profile; call it after SetVariant
+    void SetQuirkProfile(QuirkProfile profile);
+    QuirkProfile GetQuirkProfile() const { return m_QuirkProfile; }
     void LoadROM(const char* filename);
+    void LoadROM(const uint8_t* data, size_t size);
+    void Reset();
+    void SaveState(MachineState& state) const;
+    void LoadState(const MachineState& state);
     void Cycle();
-    void DecrementTimers(std::function<void()> beepCallback);
+    void Run(uint32_t cycles);
+    // Interprets up to cycles instructions, calling hooks.BeforeStep(*this)
+    // ahead of each and stopping early when it returns false; returns the
+    // number run. Busy-waits are not skipped. Instantiated for Debugger only.
+    template <typename Hooks>
+    uint32_t RunWithHooks(uint32_t cycles, Hooks& hooks);
+    // Aot looks up its recompiled program in LoadROM, so select it first
+    void SetExecutionMode(ExecutionMode mode);
+    ExecutionMode GetExecutionMode() const { return m_Mode; }
+    // Null unless the core is built with CHIP8_PROFILE
+    const Profiler* GetProfiler() const;
+    // Traces every following instruction into tracer (not owned); ignored
+    // unless the core is built with CHIP8_TRACE
+    void SetTracer(Tracer* tracer);
+    uint64_t GetCycleCount() const { return m_CycleCount; } // Cycles executed through Run()
+    uint64_t GetIdleCycles() const { return m_IdleCycles; } // Of those, cycles skipped as busy-waiting
+    void DecrementTimers();
+    // The buzzer sounds while this is non-zero
+    uint8_t GetSoundTimer() const { return m_SoundTimer; }
+    void Seed(uint64_t seed) { m_RandGen.Seed(seed); }
 
     uint8_t* getKeypad() { return m_Keypad; }
-    uint32_t* getDisplay() { return m_Display; }
+    // Plane 0; in low resolution these are the 32 rows of a CHIP-8 display
+    const uint64_t* getDisplay() const { return m_Display; }
+    const uint64_t* GetPlane(unsigned int plane) const { return m_Display + plane * DISPLAY_WORDS; }
+    unsigned int GetPlaneCount() const { return m_Variant == Variant::XoChip ? MAX_PLANES : 1; }
+    unsigned int GetDisplayWidth() const { return m_HiRes ? HIRES_WIDTH : VIDEO_WIDTH; }
+    unsigned int GetDisplayHeight() const { return m_HiRes ? HIRES_HEIGHT : VIDEO_HEIGHT; }
+    unsigned int GetDisplayRowWords() const { return m_HiRes ? 2 : 1; }
+    // FNV-1a over the visible rows of every plane
+    uint64_t GetDisplayHash() const;
+    const uint8_t* GetAudioPattern() const { return m_AudioPattern; }
+    uint8_t GetPitch() const { return m_Pitch; }
+    bool IsDisplayDirty() const { return m_DirtyRows != 0; }
+    uint64_t GetDirtyRows() const { return m_DirtyRows; }
+    void ClearDisplayDirty() { m_DirtyRows = 0; }
 
-    ~Chip8() = default;
+    ~Chip8();
 };
 
 } // namespace Chip8Emulator
@@ -0,0 +1,42 @@
+#ifndef CHIP8_C_H
+#define CHIP8_C_H
+
+/* Stable C interface to a batch of Chip8 instances stepped on all cores.
+ * Instances are numbered 0..count-1. Framebuffers are VIDEO_HEIGHT (32)
+ * uint64_t rows per instance, most significant bit = leftmost pixel. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8_env chip8_env;
+
+/* Loads rom_path into count instances. Instance i draws its random numbers
+ * from seed i. Returns NULL on failure. */
+chip8_env* chip8_env_create(size_t count, const char* rom_path);
+void chip8_env_destroy(chip8_env* env);
+
+size_t chip8_env_count(const chip8_env* env);
+
+/* Runs every instance for frames 60 Hz frames. keys holds one 16-bit keypad
+ * mask per instance (bit n = key n) and may be NULL. Returns the number of
+ * instances halted by an invalid opcode; they stay halted until reset. */
+size_t chip8_env_step(chip8_env* env, const uint16_t* keys, unsigned int frames);
+
+/* One pointer per instance into the live framebuffers. The array and the
+ * rows stay valid until chip8_env_destroy and are updated in place by step. */
+const uint64_t* const* chip8_env_framebuffers(const chip8_env* env);
+
+/* Restarts each instance whose mask byte is non-zero; NULL resets all.
+ * A reset instance is reseeded with its index, so given the same keys it
+ * repeats the run it made after chip8_env_create. */
+void chip8_env_reset(chip8_env* env, const uint8_t* mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHIP8_C_H */
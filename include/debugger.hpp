@@ -0,0 +1,161 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+// Watchpoint kinds, combinable
+constexpr uint8_t WATCH_READ = 1;
+constexpr uint8_t WATCH_WRITE = 2;
+constexpr uint8_t WATCH_ACCESS = WATCH_READ | WATCH_WRITE;
+
+// Register number of I in a RegisterCondition; 0-15 are V0-VF
+constexpr uint8_t REGISTER_I = 16;
+
+enum class Compare : uint8_t {
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual
+};
+
+// A condition on one register, e.g. "V3 == 5" or "I >= 0x300"
+struct RegisterCondition {
+    uint8_t reg;
+    Compare compare;
+    uint16_t value;
+};
+
+// Parses "<Vx|I> <op> <value>" with op one of == != < <= > >= and value
+// decimal or 0x hex; spaces are optional
+bool ParseRegisterCondition(const std::string& text, RegisterCondition& condition);
+std::string FormatRegisterCondition(const RegisterCondition& condition);
+
+enum class StopReason {
+    Step,       // Step or StepOver finished
+    Breakpoint, // About to run the instruction at a breakpoint
+    Watchpoint, // The last instruction touched a watched byte
+    Limit       // The cycle budget ran out
+};
+
+struct StopInfo {
+    StopReason reason;
+    uint16_t address; // Watched byte touched, for Watchpoint
+    uint8_t access;   // WATCH_READ or WATCH_WRITE, for Watchpoint
+};
+
+// Interactive control of one Chip8: PC and register-condition breakpoints,
+// memory watchpoints, single-step and step-over. Instructions run through
+// Chip8::RunWithHooks, which calls BeforeStep ahead of each one; Run() never
+// does, so a machine without a debugger pays nothing for it. While attached
+// every instruction is interpreted, whatever the execution mode.
+class Debugger {
+public:
+    // Timers tick every cyclesPerFrame instructions run through the debugger
+    explicit Debugger(Chip8& chip8, uint32_t cyclesPerFrame = 10);
+
+    Chip8& GetMachine() { return m_Chip8; }
+
+    // A breakpoint with a condition only stops when it holds. Conditional
+    // breakpoints without an address are checked before every instruction.
+    void AddBreakpoint(uint16_t address);
+    void AddBreakpoint(uint16_t address, const RegisterCondition& condition);
+    void AddBreakpoint(const RegisterCondition& condition);
+    // Removes every breakpoint at address; false if there was none
+    bool RemoveBreakpoint(uint16_t address);
+    // Removes every breakpoint without an address
+    void RemoveConditionBreakpoints();
+
+    // Watches [address, address + length) for reads, writes or both by
+    // instructions; opcode fetches are not reads. Sprites count as reading
+    // every byte they span, clipped rows included.
+    void AddWatchpoint(uint16_t address, uint16_t length, uint8_t kind);
+    bool RemoveWatchpoint(uint16_t address, uint16_t length, uint8_t kind);
+    void ClearAll();
+
+    // Runs one instruction, ignoring a breakpoint at the PC
+    StopInfo Step();
+    // As Step, but runs a 2nnn call until it returns to the next instruction
+    StopInfo StepOver(uint64_t maxCycles);
+    // Runs until a breakpoint or watchpoint, or for maxCycles instructions;
+    // a breakpoint at the PC it starts from does not stop it
+    StopInfo Continue(uint64_t maxCycles);
+
+    // Lines of "=> 0x0200  00E0  CLS", marking the PC with => and breakpoints with *
+    std::string Disassembly(uint16_t address, unsigned int count) const;
+
+    // Machine state, for front ends
+    uint8_t GetRegister(unsigned int reg) const { return m_Chip8.m_Register[reg & 0xF]; }
+    void SetRegister(unsigned int reg, uint8_t value) { m_Chip8.m_Register[reg & 0xF] = value; }
+    uint16_t GetIndex() const { return m_Chip8.m_IndexRegister; }
+    void SetIndex(uint16_t value) { m_Chip8.m_IndexRegister = value; }
+    uint16_t GetProgramCounter() const { return m_Chip8.m_ProgramCounter; }
+    void SetProgramCounter(uint16_t value) { m_Chip8.m_ProgramCounter = value; }
+    uint8_t GetStackPointer() const { return m_Chip8.m_StackPointer; }
+    uint16_t GetStackEntry(unsigned int level) const { return m_Chip8.m_Stack[level % STACK_LEVELS]; }
+    uint8_t GetDelayTimer() const { return m_Chip8.m_DelayTimer; }
+    uint8_t GetSoundTimer() const { return m_Chip8.m_SoundTimer; }
+    void SetTimers(uint8_t delay, uint8_t sound) { m_Chip8.m_DelayTimer = delay; m_Chip8.m_SoundTimer = sound; }
+    // Size of the variant's address space
+    uint32_t GetMemorySize() const { return m_Chip8.m_AddressMask + 1u; }
+    uint8_t ReadMemory(uint16_t address) const { return m_Chip8.m_Data[address & m_Chip8.m_AddressMask]; }
+    // Invalidates translated code the write overlaps
+    void WriteMemory(uint16_t address, const uint8_t* data, uint16_t length);
+
+    // Hook for Chip8::RunWithHooks: false stops before the instruction at the PC
+    bool BeforeStep(const Chip8& chip8);
+
+private:
+    struct Breakpoint {
+        uint16_t address;
+        bool anywhere;
+        bool conditional;
+        RegisterCondition condition;
+    };
+
+    struct Watchpoint {
+        uint16_t address;
+        uint16_t length;
+        uint8_t kind;
+    };
+
+    Chip8& m_Chip8;
+    uint32_t m_CyclesPerFrame;
+    uint32_t m_FrameCycle = 0;
+
+    std::vector<Breakpoint> m_Breakpoints;
+    std::vector<uint8_t> m_BreakAt;     // Per address: some breakpoint has it
+    bool m_HasAnywhere = false;
+    std::vector<Watchpoint> m_Watchpoints;
+    std::vector<uint8_t> m_Watched;     // Per address: union of watch kinds
+
+    bool m_Resuming = false;            // Next BeforeStep ignores breakpoints
+    bool m_SteppingOver = false;
+    uint16_t m_ReturnAddress = 0;
+    uint8_t m_ReturnDepth = 0;
+    bool m_Stopped = false;
+    bool m_WatchHit = false;            // Stop before the next instruction
+    StopInfo m_Stop{};
+
+    // Memory the instruction at the PC reads or writes, besides its own fetch
+    struct Access {
+        uint16_t address;
+        uint16_t length;
+        uint8_t kind;
+    };
+    static Access FindAccess(const Chip8& chip8);
+
+    StopInfo Run(uint64_t maxCycles);
+    bool Holds(const RegisterCondition& condition) const;
+    void RebuildWatched();
+};
+
+} // namespace Chip8Emulator
+
+#endif // DEBUGGER_H
@@ -0,0 +1,36 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+// Mnemonic form of one instruction, e.g. "LD V1, 0x05" or "DRW V0, V1, 5".
+// next is the word after opcode, only read for XO-CHIP's F000 nnnn.
+// Opcodes the variant does not define come out as "DW 0x...."
+std::string Disassemble(uint16_t opcode, Variant variant = Variant::Chip8, uint16_t next = 0);
+
+// 4 for XO-CHIP's F000 nnnn, 2 for everything else
+unsigned int InstructionLength(uint16_t opcode, Variant variant);
+
+// Straight-line code [start, end): entered only at start, and only its last
+// instruction may branch or write memory
+struct BasicBlock {
+    uint32_t start;
+    uint32_t end;
+};
+
+// Recovers the control-flow graph of a ROM image as loaded at START_ADDR:
+// every basic block reachable from START_ADDR through 1nnn, 2nnn (and its
+// return address), 00EE and both sides of every skip, in address order.
+// Computed jumps (Bnnn), unknown opcodes and the end of the image stop a
+// path, so code only reached through them is not included.
+std::vector<BasicBlock> FindBasicBlocks(const uint8_t* rom, size_t size, Variant variant = Variant::Chip8);
+
+} // namespace Chip8Emulator
+
+#endif // DISASSEMBLER_H
@@ -0,0 +1,114 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <array>
+#include <cstdint>
+
+namespace Chip8Emulator{
+
+// The display is packed 64 pixels per uint64_t; the most significant bit is x = 0.
+constexpr uint64_t DISPLAY_ROW_MSB = uint64_t{1} << 63;
+
+constexpr uint32_t DISPLAY_PIXEL_ON = 0xFFFFFFFF;  // White
+constexpr uint32_t DISPLAY_PIXEL_OFF = 0xFF000000; // Opaque black
+
+// XO-CHIP colours by plane bits (bit n = plane n), as R8G8B8A8
+inline constexpr uint32_t DISPLAY_PALETTE[16] = {
+    DISPLAY_PIXEL_OFF, DISPLAY_PIXEL_ON, 0xFF0066FF, 0xFF002266,
+    0xFFFF9933,        0xFF6633CC,       0xFF33CC66, 0xFF999999,
+    0xFF444444,        0xFF00CCFF,       0xFF3333CC, 0xFFCC9966,
+    0xFF66FF99,        0xFFFF66CC,       0xFF99FFFF, 0xFFCCCCCC
+};
+
+namespace detail {
+
+constexpr std::array<uint32_t, 32> MakeBitMasks() {
+    std::array<uint32_t, 32> masks{};
+    for (unsigned int x = 0; x < 32; x++) {
+        masks[x] = 0x80000000u >> x;
+    }
+    return masks;
+}
+
+// masks[x] selects pixel x of a 32-pixel half row
+inline constexpr std::array<uint32_t, 32> HALF_ROW_BITS = MakeBitMasks();
+
+inline void ExpandHalfRow(uint32_t bits, uint32_t* out, uint32_t on, uint32_t off) {
+    for (unsigned int x = 0; x < 32; x++) {
+        uint32_t select = 0u - static_cast<uint32_t>((bits & HALF_ROW_BITS[x]) != 0);
+        out[x] = off ^ ((on ^ off) & select);
+    }
+}
+
+} // namespace detail
+
+// Branchless expansion of rows [first, last) into 32-bit pixels. Each row is
+// width / 64 packed words (one for a width of 32). The per-pixel select is a
+// compare and a mask, so the inner loops vectorize. width must be a multiple
+// of 32.
+inline void ExpandDisplayRows(const uint64_t* rows, unsigned int first, unsigned int last, unsigned int width,
+                              uint32_t* pixels, uint32_t on, uint32_t off) {
+    const unsigned int words = (width + 63) / 64;
+    for (unsigned int y = first; y < last; y++) {
+        uint32_t* out = pixels + y * width;
+        for (unsigned int word = 0; word < words; word++) {
+            uint64_t row = rows[y * words + word];
+            detail::ExpandHalfRow(static_cast<uint32_t>(row >> 32), out + 64 * word, on, off);
+            if (width > 64 * word + 32) {
+                detail::ExpandHalfRow(static_cast<uint32_t>(row), out + 64 * word + 32, on, off);
+            }
+        }
+    }
+}
+
+// Expansion of several planes laid out like ExpandDisplayRows: plane p sets
+// bit p of the palette index of each pixel
+inline void ExpandBitplaneRows(const uint64_t* const* planes, unsigned int planeCount, unsigned int first,
+                               unsigned int last, unsigned int width, uint32_t* pixels, const uint32_t* palette) {
+    const unsigned int words = (width + 63) / 64;
+    for (unsigned int y = first; y < last; y++) {
+        uint32_t* out = pixels + y * width;
+        for (unsigned int x = 0; x < width; x++) {
+            unsigned int index = 0;
+            for (unsigned int plane = 0; plane < planeCount; plane++) {
+                uint64_t row = planes[plane][y * words + x / 64];
+                index |= static_cast<unsigned int>((row >> (63 - x % 64)) & 1) << plane;
+            }
+            out[x] = palette[index];
+        }
+    }
+}
+
+// Bit n set where row n, rowWords packed words wide, differs between two displays
+inline uint64_t DiffDisplayRows(const uint64_t* a, const uint64_t* b, unsigned int height = 32,
+                                unsigned int rowWords = 1) {
+    uint64_t rows = 0;
+    for (unsigned int y = 0; y < height; y++) {
+        bool changed = false;
+        for (unsigned int word = 0; word < rowWords; word++) {
+            changed |= a[y * rowWords + word] != b[y * rowWords + word];
+        }
+        rows |= uint64_t{changed} << y;
+    }
+    return rows;
+}
+
+constexpr uint64_t DISPLAY_HASH_SEED = 0xcbf29ce484222325ULL;
+
+// 64-bit FNV-1a over count packed words, used to compare runs. Passing the
+// previous result as seed chains several planes into one hash.
+inline uint64_t HashDisplay(const uint64_t* rows, unsigned int count = 32, uint64_t seed = DISPLAY_HASH_SEED) {
+    uint64_t hash = seed;
+    const auto* bytes = reinterpret_cast<const uint8_t*>(rows);
+
+    for (unsigned int i = 0; i < count * sizeof(uint64_t); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+} // namespace Chip8Emulator
+
+#endif // DISPLAY_H
@@ -0,0 +1,125 @@
+#ifndef EMULATION_THREAD_H
+#define EMULATION_THREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include "chip8.hpp"
+#include "triple_buffer.hpp"
+
+namespace Chip8Emulator{
+
+class FrameCapture;
+class InputRecorder;
+class ToneGenerator;
+
+constexpr uint32_t CPU_CLOCK_SPEED = 600; // 600 Hz
+constexpr uint32_t TIMER_FREQUENCY = 60; // 60 Hz
+constexpr uint32_t CYCLES_PER_FRAME = CPU_CLOCK_SPEED / TIMER_FREQUENCY;
+
+// Ticks are scheduled at exact multiples of 1/TIMER_FREQUENCY s, computed in
+// integer nanoseconds from the start of the run, so there is no drift. Further
+// behind than this (a suspended process, a debugger) the schedule restarts
+// instead of bursting through the backlog.
+constexpr std::chrono::milliseconds MAX_SCHEDULE_LAG{250};
+
+// The clock runs a whole number of instructions per timer tick
+constexpr uint32_t CyclesPerFrame(uint32_t clockHz) {
+    return clockHz / TIMER_FREQUENCY;
+}
+
+// A finished display, as handed to the render thread. Only the first
+// planeCount planes and height * width / 64 words of each are meaningful.
+struct Frame {
+    uint64_t planes[MAX_PLANES][DISPLAY_WORDS];
+    uint16_t width;
+    uint16_t height;
+    uint8_t planeCount;
+    uint64_t cycle;
+};
+
+// Copies chip8's visible display into frame
+void CopyDisplay(const Chip8& chip8, Frame& frame);
+
+// Runs a Chip8 (cycles, timers, rewind, input recording) on its own thread so
+// that a slow or vsync-blocked renderer cannot distort the emulated clock. The
+// thread owns the Chip8 between Start() and Stop(); the render thread talks to
+// it only through the keypad mask, the frame triple buffer and the tone generator.
+class EmulationThread {
+public:
+    // Every 60 Hz tick samples the keypad, runs cyclesPerFrame instructions and
+    // decrements the timers. Deterministic runs (and recordings) have no
+    // rewind, so the session depends only on the seed and the input. Without a
+    // tone generator the buzzer goes nowhere. A capture records every tick's
+    // display, dropping frames rather than stalling the clock.
+    EmulationThread(Chip8& chip8, uint32_t cyclesPerFrame, bool deterministic, InputRecorder* recorder = nullptr,
+                    ToneGenerator* tone = nullptr, FrameCapture* capture = nullptr);
+    ~EmulationThread();
+
+    EmulationThread(const EmulationThread&) = delete;
+    EmulationThread& operator=(const EmulationThread&) = delete;
+
+    void Start();
+
+    // Joins the thread and rethrows anything the core threw
+    void Stop();
+
+    bool IsRunning() const { return m_Running.load(std::memory_order_acquire); }
+
+    // Render thread side
+    void SetKeys(uint16_t keys) { m_Keys.store(keys, std::memory_order_relaxed); }
+    void SetRewinding(bool rewinding) { m_Rewinding.store(rewinding, std::memory_order_relaxed); }
+
+    // Turbo runs ticks back to back with no throttling. Emulated time (and so
+    // the timers) still advances per tick; rewind history is not recorded.
+    void SetTurbo(bool turbo) { m_Turbo.store(turbo, std::memory_order_relaxed); }
+    bool IsTurbo() const { return m_Turbo.load(std::memory_order_relaxed); }
+
+    // Instructions per second over the last turbo measurement window, and
+    // over all turbo time so far
+    double GetEffectiveHz() const { return m_EffectiveHz.load(std::memory_order_relaxed); }
+    double GetAverageTurboHz() const;
+
+    // Swaps in the newest published frame; false if there is none since the last call
+    bool UpdateFrame() { return m_Frames.Update(); }
+    const Frame& GetFrame() const { return m_Frames.Front(); }
+
+private:
+    Chip8& m_Chip8;
+    uint32_t m_CyclesPerFrame;
+    bool m_Deterministic;
+    InputRecorder* m_Recorder;
+    ToneGenerator* m_Tone;
+    FrameCapture* m_Capture;
+
+    std::thread m_Thread;
+    std::atomic<bool> m_Running{false};
+    std::atomic<bool> m_StopRequested{false};
+    std::exception_ptr m_Error;
+
+    std::atomic<uint16_t> m_Keys{0};
+    std::atomic<bool> m_Rewinding{false};
+    std::atomic<bool> m_Turbo{false};
+    std::atomic<double> m_EffectiveHz{0.0};
+    std::atomic<uint64_t> m_TurboCycles{0};
+    std::atomic<uint64_t> m_TurboNanoseconds{0};
+    TripleBuffer<Frame> m_Frames;
+
+    void Main();
+    void RunLoop();
+
+    // One 60 Hz tick: keypad, cyclesPerFrame instructions, timers
+    void Tick();
+
+    // Publishes the display if it changed since the last publish
+    void PublishFrame();
+
+    // Starts or stops the buzzer to match the sound timer
+    void PublishSound();
+};
+
+} // namespace Chip8Emulator
+
+#endif // EMULATION_THREAD_H
@@ -0,0 +1,59 @@
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "chip8.hpp"
+#include "rom.hpp"
+#include "thread_pool.hpp"
+
+namespace Chip8Emulator{
+
+constexpr int ENVIRONMENT_CYCLES_PER_FRAME = 10; // 600 Hz CPU, 60 Hz timers
+
+// Many independent Chip8 instances of one ROM, stepped in parallel on a
+// ThreadPool. Each worker task runs a contiguous chunk of instances for the
+// requested number of frames. Step() neither copies nor allocates.
+class Environment {
+public:
+    Environment(size_t count, const char* filename, unsigned int threads = 0,
+                int cyclesPerFrame = ENVIRONMENT_CYCLES_PER_FRAME);
+
+    // keys holds one 16-bit keypad mask per instance, or is null for no input.
+    // Returns the number of instances halted by an unknown opcode.
+    size_t Step(const uint16_t* keys, unsigned int frames);
+
+    // Restarts every instance whose mask byte is non-zero (all if mask is null).
+    // Instance i is reseeded with i, so it replays exactly as after construction.
+    void Reset(const uint8_t* mask);
+
+    size_t GetCount() const { return m_Count; }
+    unsigned int GetThreadCount() const { return m_Pool.GetThreadCount(); }
+
+    // One pointer per instance to its VIDEO_HEIGHT packed rows
+    const uint64_t* const* GetFramebuffers() const { return m_Framebuffers.get(); }
+    const uint8_t* GetFaulted() const { return m_Faulted.get(); }
+
+private:
+    size_t m_Count;
+    int m_CyclesPerFrame;
+    size_t m_Grain;
+    RomImage m_Rom;
+    std::unique_ptr<Chip8[]> m_Instances;
+    std::unique_ptr<const uint64_t*[]> m_Framebuffers;
+    std::unique_ptr<uint8_t[]> m_Faulted;
+    ThreadPool m_Pool;
+
+    // Arguments of the Step() in flight, read by the worker tasks
+    const uint16_t* m_Keys = nullptr;
+    unsigned int m_Frames = 0;
+    std::atomic<size_t> m_FaultCount{0};
+
+    static void RunChunk(void* context, size_t begin, size_t end);
+};
+
+} // namespace Chip8Emulator
+
+#endif // ENVIRONMENT_H
@@ -0,0 +1,53 @@
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+#include <string>
+#include "debugger.hpp"
+
+namespace Chip8Emulator{
+
+// GDB remote serial protocol server for one Debugger, listening on a
+// Unix-domain socket (gdb: target remote /path/to/socket). Registers are
+// numbered V0-VF (0-15, 8 bits), I (16), PC (17), SP (18), DT (19) and ST (20)
+// and described to the client by qXfer target.xml; memory is the variant's
+// address space. Z0/Z1 set breakpoints and Z2/Z3/Z4 write, read and access
+// watchpoints. A continue runs until one is hit or the client sends ^C.
+class GdbStub {
+public:
+    // Binds and listens; throws runtime_error on failure
+    GdbStub(Debugger& debugger, const std::string& socketPath);
+    ~GdbStub();
+
+    GdbStub(const GdbStub&) = delete;
+    GdbStub& operator=(const GdbStub&) = delete;
+
+    // Accepts one client and serves it until it detaches (true), kills the
+    // session or disconnects (false)
+    bool Serve();
+
+private:
+    Debugger& m_Debugger;
+    std::string m_Path;
+    int m_Listener = -1;
+    int m_Client = -1;
+    bool m_NoAck = false;
+    std::string m_Input;
+
+    bool ReadPacket(std::string& packet);
+    void SendPacket(const std::string& payload);
+    bool SendRaw(const std::string& data);
+
+    // Reply to one packet; sets done when the session ends
+    std::string Handle(const std::string& packet, bool& done, bool& detached);
+    std::string Resume(bool step);
+    bool Interrupted();
+
+    std::string ReadRegisters() const;
+    bool WriteRegisters(const std::string& hex);
+    bool ReadRegister(unsigned int reg, std::string& hex) const;
+    bool WriteRegister(unsigned int reg, const std::string& hex);
+};
+
+} // namespace Chip8Emulator
+
+#endif // GDB_STUB_H
@@ -0,0 +1,92 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+constexpr uint32_t INPUT_LOG_MAGIC = 0x4E493843; // "C8IN"
+constexpr uint32_t INPUT_LOG_VERSION = 2;
+
+// On-disk layout, all little-endian:
+//   header: magic u32, version u32, seed u64, cycles per frame u32,
+//           variant u8 (0 = CHIP-8), quirk profile u8 (0 = modern),
+//           reserved u16, total cycles u64, ROM hash u64 (HashBytes)
+//   events: cycle u64, keypad mask u16 (bit n = key n)
+// An event applies before the cycle it is stamped with executes.
+constexpr size_t INPUT_LOG_HEADER_SIZE = 40;
+constexpr size_t INPUT_LOG_EVENT_SIZE = 10;
+
+struct InputEvent {
+    uint64_t cycle;
+    uint16_t keys;
+};
+
+// Appends keypad changes of a deterministic session to a log file
+class InputRecorder {
+public:
+    InputRecorder(const char* filename, uint64_t romHash, uint64_t seed, uint32_t cyclesPerFrame,
+                  Variant variant = Variant::Chip8, QuirkProfile quirks = QuirkProfile::Modern);
+    ~InputRecorder();
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    // Writes an event only if keys differ from the last recorded mask
+    void Record(uint64_t cycle, uint16_t keys);
+
+    // Stores the session length in the header and closes the file
+    void Close(uint64_t totalCycles);
+
+private:
+    std::FILE* m_File;
+    uint16_t m_LastKeys = 0;
+    uint64_t m_RomHash;
+    uint64_t m_Seed;
+    uint32_t m_CyclesPerFrame;
+    Variant m_Variant;
+    QuirkProfile m_Quirks;
+
+    void WriteHeader(uint64_t totalCycles);
+};
+
+// Read-only, memory-mapped view of a recorded log
+class InputLog {
+public:
+    explicit InputLog(const char* filename);
+    ~InputLog();
+
+    InputLog(const InputLog&) = delete;
+    InputLog& operator=(const InputLog&) = delete;
+
+    uint64_t GetRomHash() const { return m_RomHash; } // Of the ROM the session was recorded with
+    uint64_t GetSeed() const { return m_Seed; }
+    uint32_t GetCyclesPerFrame() const { return m_CyclesPerFrame; }
+    Variant GetVariant() const { return m_Variant; }
+    QuirkProfile GetQuirkProfile() const { return m_Quirks; }
+    uint64_t GetTotalCycles() const { return m_TotalCycles; }
+    size_t GetEventCount() const { return m_EventCount; }
+    InputEvent GetEvent(size_t index) const;
+
+private:
+    const uint8_t* m_Bytes = nullptr;
+    size_t m_Size = 0;
+    uint64_t m_RomHash = 0;
+    uint64_t m_Seed = 0;
+    uint32_t m_CyclesPerFrame = 0;
+    Variant m_Variant = Variant::Chip8;
+    QuirkProfile m_Quirks = QuirkProfile::Modern;
+    uint64_t m_TotalCycles = 0;
+    size_t m_EventCount = 0;
+};
+
+// Converts between the 16-byte keypad array and a mask
+uint16_t PackKeys(const uint8_t* keypad);
+void UnpackKeys(uint16_t keys, uint8_t* keypad);
+
+} // namespace Chip8Emulator
+
+#endif // INPUT_LOG_H
@@ -0,0 +1,83 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "chip8.hpp"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CHIP8_JIT_SUPPORTED 1
+#else
+#define CHIP8_JIT_SUPPORTED 0
+#endif
+
+namespace Chip8Emulator{
+
+constexpr size_t JIT_CODE_BUFFER_SIZE = 1 << 20;
+
+// A straight-line block translated to native code. The code runs at most
+// budget instructions and returns how many it executed.
+struct CompiledBlock {
+    uint32_t (*code)(Chip8* chip8, uint32_t budget);
+    uint16_t start;
+    uint16_t end;
+    uint16_t count;
+    bool valid;
+};
+
+// Translates blocks into x86-64 code. Registers, I, PC and the timers are
+// accessed at fixed offsets from the Chip8 instance (held in rbx); anything
+// touching the stack, display, keypad, RNG or memory calls back into the
+// interpreter handler. Blocks overlapping a memory write are invalidated;
+// a block that invalidates itself returns after the store.
+class JitCompiler {
+private:
+    uint8_t* m_Code = nullptr;
+    size_t m_CodeSize = 0;
+    std::vector<uint8_t> m_Emit;
+
+    std::array<uint16_t, MEMORY_SIZE> m_BlockIndex{};
+    // Compiled code points into both: at its own block's valid flag, tested
+    // after every store, and at fallback instructions. m_Blocks is reserved
+    // for one block per address, so neither ever moves an element.
+    std::vector<CompiledBlock> m_Blocks;
+    std::deque<Instruction> m_Instructions;
+    CodeMap m_CodeBytes;
+
+    int32_t m_RegisterOffset = 0;
+    int32_t m_IndexOffset = 0;
+    int32_t m_ProgramCounterOffset = 0;
+    int32_t m_DelayTimerOffset = 0;
+    int32_t m_SoundTimerOffset = 0;
+
+    const CompiledBlock* Lookup(const Chip8& chip8, uint16_t pc);
+    bool Compile(const Chip8& chip8, uint16_t pc, CompiledBlock& block);
+    void InvalidateRange(unsigned int address, unsigned int last);
+    void EmitInstruction(const Instruction& ins, uint16_t address, const Quirks& quirks);
+    void EmitFallback(const Instruction& ins);
+
+    void Emit(std::initializer_list<uint8_t> bytes);
+    void Emit32(uint32_t value);
+    void Emit64(uint64_t value);
+    void EmitRbx(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t offset);
+    void EmitStoreProgramCounter(uint16_t value);
+    void EmitReturn(uint16_t executed);
+
+public:
+    explicit JitCompiler(const Chip8& chip8);
+    ~JitCompiler();
+
+    JitCompiler(const JitCompiler& other) = delete;
+    JitCompiler& operator=(const JitCompiler& other) = delete;
+
+    void Execute(Chip8& chip8, uint32_t cycles);
+    void Invalidate(uint16_t address, uint16_t length);
+    void Flush();
+};
+
+} // namespace Chip8Emulator
+
+#endif // JIT_H
@@ -0,0 +1,83 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Lowest level compiled in (CMake cache variable CHIP8_LOG_LEVEL); calls below
+// it are discarded at compile time, arguments included
+#ifndef CHIP8_LOG_LEVEL
+#define CHIP8_LOG_LEVEL 2
+#endif
+
+#if defined(__GNUC__)
+#define CHIP8_PRINTF_FORMAT(formatIndex, firstArg) __attribute__((format(printf, formatIndex, firstArg)))
+#else
+#define CHIP8_PRINTF_FORMAT(formatIndex, firstArg)
+#endif
+
+#define CHIP8_LOG(level, ...)                                                       \
+    do {                                                                            \
+        if constexpr (static_cast<int>(level) >= CHIP8_LOG_LEVEL) {                 \
+            ::Chip8Emulator::Logger::Get().Write(level, __VA_ARGS__);               \
+        }                                                                           \
+    } while (0)
+
+#define CHIP8_LOG_TRACE(...) CHIP8_LOG(::Chip8Emulator::LogLevel::Trace, __VA_ARGS__)
+#define CHIP8_LOG_DEBUG(...) CHIP8_LOG(::Chip8Emulator::LogLevel::Debug, __VA_ARGS__)
+#define CHIP8_LOG_INFO(...) CHIP8_LOG(::Chip8Emulator::LogLevel::Info, __VA_ARGS__)
+#define CHIP8_LOG_WARN(...) CHIP8_LOG(::Chip8Emulator::LogLevel::Warn, __VA_ARGS__)
+#define CHIP8_LOG_ERROR(...) CHIP8_LOG(::Chip8Emulator::LogLevel::Error, __VA_ARGS__)
+
+namespace Chip8Emulator{
+
+enum class LogLevel : int {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off,
+};
+
+constexpr size_t LOG_RING_SIZE = 1024;      // Messages in flight
+constexpr size_t LOG_MESSAGE_SIZE = 120;    // Longer messages are truncated
+
+// Process-wide sink for the CHIP8_LOG_* macros. Callers format into a slot of
+// a bounded lock-free ring and return; a background thread drains the ring to
+// stderr. When the ring is full the message is dropped and counted rather
+// than blocking the caller.
+class Logger {
+public:
+    static Logger& Get();
+
+    void Write(LogLevel level, const char* format, ...) CHIP8_PRINTF_FORMAT(3, 4);
+
+    // Blocks until every message written so far is on stderr
+    void Flush();
+
+    uint64_t GetDropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot;
+
+    Logger();
+    ~Logger();
+
+    std::unique_ptr<Slot[]> m_Slots;
+    alignas(64) std::atomic<size_t> m_WritePos{0};
+    alignas(64) std::atomic<size_t> m_ReadPos{0};
+    std::atomic<uint64_t> m_Dropped{0};
+    std::atomic<bool> m_Stop{false};
+    std::thread m_Drain;
+
+    // Writes out everything published so far; drain thread only
+    void Drain();
+};
+
+} // namespace Chip8Emulator
+
+#endif // LOG_H
@@ -0,0 +1,77 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "chip8.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Chip8Emulator{
+
+constexpr size_t PROFILER_HOT_LOOPS = 16;
+
+// Execution profile of one Chip8, filled in by the interpreter when the core
+// is built with CHIP8_PROFILE. Everything is fixed-size, so recording never
+// allocates. Per-address counters cover 4 KB; XO-CHIP addresses above it fold
+// onto that range.
+class Profiler {
+public:
+    Profiler();
+
+    // Cheap timestamp: the TSC where available, otherwise steady_clock nanoseconds
+    static uint64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void Record(uint16_t address, OpcodeId id, uint64_t ticks) {
+        auto index = static_cast<size_t>(id);
+        m_OpcodeCounts[index]++;
+        m_OpcodeTicks[index] += ticks;
+        m_PcHits[address & (MEMORY_SIZE - 1)]++;
+        m_PcTicks[address & (MEMORY_SIZE - 1)] += ticks;
+    }
+
+    // A jump from address back to target closes a loop over [target, address]
+    void RecordBackwardBranch(uint16_t address, uint16_t target) {
+        m_BranchTarget[address & (MEMORY_SIZE - 1)] = target & (MEMORY_SIZE - 1);
+        m_BranchCount[address & (MEMORY_SIZE - 1)]++;
+    }
+
+    void WriteJson(std::ostream& out) const;
+
+    // One "chip8;<family>;<handler> <ticks>" line per executed handler
+    void WriteFolded(std::ostream& out) const;
+
+    // Writes <prefix>.json and <prefix>.folded
+    void Write(const std::string& prefix) const;
+
+private:
+    static constexpr size_t OPCODE_COUNT = static_cast<size_t>(OpcodeId::Count);
+
+    std::array<uint64_t, OPCODE_COUNT> m_OpcodeCounts{};
+    std::array<uint64_t, OPCODE_COUNT> m_OpcodeTicks{};
+    std::array<uint64_t, MEMORY_SIZE> m_PcHits{};
+    std::array<uint64_t, MEMORY_SIZE> m_PcTicks{};
+    std::array<uint16_t, MEMORY_SIZE> m_BranchTarget{};
+    std::array<uint64_t, MEMORY_SIZE> m_BranchCount{};
+
+    uint64_t m_StartTicks;
+    std::chrono::steady_clock::time_point m_StartTime;
+};
+
+const char* OpcodeName(OpcodeId id);
+
+} // namespace Chip8Emulator
+
+#endif // PROFILER_H
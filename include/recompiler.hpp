@@ -0,0 +1,19 @@
+#ifndef RECOMPILER_H
+#define RECOMPILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+// Translates a CHIP-8 ROM to C++: one function per basic block found by
+// FindBasicBlocks, registered as an AotProgram under name. Register, timer
+// and index instructions are inlined; everything else calls the profile's
+// interpreter handler. Throws runtime_error for ROMs that do not fit in memory.
+std::string Recompile(const uint8_t* rom, size_t size, QuirkProfile profile, const std::string& name);
+
+} // namespace Chip8Emulator
+
+#endif // RECOMPILER_H
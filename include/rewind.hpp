@@ -0,0 +1,54 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "save_state.hpp"
+
+namespace Chip8Emulator{
+
+constexpr size_t REWIND_DEFAULT_FRAMES = 60 * 60;   // One minute at 60 Hz
+constexpr size_t REWIND_KEYFRAME_INTERVAL = 60;
+
+// History of machine states, newest last. Every REWIND_KEYFRAME_INTERVAL-th
+// state is a keyframe, stored run-length encoded on its own; the states between are stored as the
+// run-length encoded XOR against the previous state. Nearly all bytes of a
+// one-frame delta are zero, so a frame typically costs tens of bytes, and
+// since XOR is its own inverse, stepping back is one delta per frame.
+class RewindBuffer {
+public:
+    explicit RewindBuffer(size_t capacity = REWIND_DEFAULT_FRAMES,
+                          size_t keyframeInterval = REWIND_KEYFRAME_INTERVAL);
+
+    void Push(const MachineState& state);
+
+    // Removes the newest state and writes it to state; false when empty
+    bool Pop(MachineState& state);
+
+    void Clear();
+    size_t GetFrameCount() const { return m_FrameCount; }
+    size_t GetMemoryUsage() const;
+
+private:
+    // A keyframe and the deltas chained from it; evicted as a unit
+    struct Group {
+        std::vector<uint8_t> keyframe;
+        std::vector<std::vector<uint8_t>> deltas;
+    };
+
+    size_t m_Capacity;
+    size_t m_KeyframeInterval;
+    size_t m_FrameCount = 0;
+    std::deque<Group> m_Groups;
+    std::vector<std::vector<uint8_t>> m_SpareDeltas;
+    MachineState m_Newest;
+
+    static void Encode(const MachineState* from, const MachineState& to, std::vector<uint8_t>& out);
+    static void Apply(const std::vector<uint8_t>& delta, MachineState& state);
+};
+
+} // namespace Chip8Emulator
+
+#endif // REWIND_H
@@ -0,0 +1,45 @@
+#ifndef ROM_H
+#define ROM_H
+
+#include <cstddef>
+#include <cstdint>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+// Largest ROM any variant can load: the XO-CHIP address space above START_ADDR
+constexpr size_t MAX_ROM_SIZE = MAX_MEMORY_SIZE - START_ADDR;
+
+// 64-bit FNV-1a, as used to identify ROMs
+uint64_t HashBytes(const uint8_t* data, size_t size);
+
+// Read-only, memory-mapped ROM file. Opening checks that it is a non-empty
+// regular file of at most MAX_ROM_SIZE bytes; whether it fits the selected
+// variant is checked when it is loaded.
+class RomImage {
+public:
+    explicit RomImage(const char* filename);
+    ~RomImage();
+
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    const uint8_t* GetData() const { return m_Bytes; }
+    size_t GetSize() const { return m_Size; }
+    int64_t GetModifiedTime() const { return m_ModifiedTime; } // Nanoseconds since the epoch
+
+    uint64_t GetHash() const { return HashBytes(m_Bytes, m_Size); }
+
+private:
+    const uint8_t* m_Bytes = nullptr;
+    size_t m_Size = 0;
+    int64_t m_ModifiedTime = 0;
+};
+
+// Size and mtime (as RomImage reports it) of a file without opening it;
+// false if it cannot be stat'ed
+bool GetFileStamp(const char* filename, uint64_t& size, int64_t& modifiedTime);
+
+} // namespace Chip8Emulator
+
+#endif // ROM_H
@@ -0,0 +1,68 @@
+#ifndef ROM_CATALOG_H
+#define ROM_CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+// What a frontend needs to start a ROM without looking inside it
+struct RomInfo {
+    uint64_t hash;          // RomImage::GetHash
+    uint64_t size;
+    int64_t modifiedTime;   // Of the file when it was hashed
+    Variant variant;
+    QuirkProfile quirks;
+    uint32_t clockHz;
+    std::string title;
+};
+
+// Instruction rate a variant's programs are usually written for
+uint32_t SuggestedClock(Variant variant);
+
+// Smallest variant whose instructions cover everything reachable from
+// START_ADDR, following jumps, calls and both sides of every skip
+Variant IdentifyVariant(const uint8_t* rom, size_t size);
+
+// Persistent map of ROM files to their settings, stored as one tab-separated
+// line per file:
+//   hash (hex), size, mtime (ns), variant, quirks, clock Hz, path, title
+// Variant and quirks use the --variant/--quirks names. A file is only read
+// again when its size or mtime changes, and if its hash is unchanged (or
+// matches another entry) the existing settings are kept, so hand edits to
+// the catalog survive rescans.
+class RomCatalog {
+public:
+    // A missing file is an empty catalog
+    void Load(const char* filename);
+    void Save(const char* filename) const;
+
+    // Brings the entry for the ROM at path up to date and returns it. Throws
+    // like RomImage if the file cannot be read.
+    const RomInfo& Update(const std::string& path);
+
+    // Drops entries whose files no longer exist; returns how many
+    size_t Prune();
+
+    const RomInfo* Find(uint64_t hash) const;
+    const std::unordered_map<std::string, RomInfo>& GetEntries() const { return m_Entries; }
+
+    // Files read by Update() since the catalog was loaded
+    size_t GetScannedCount() const { return m_Scanned; }
+
+private:
+    std::unordered_map<std::string, RomInfo> m_Entries; // By canonical path
+    size_t m_Scanned = 0;
+};
+
+// Loads the catalog in catalogFilename (creating it if missing), brings the
+// entry for romFilename up to date, saves the catalog if that read the ROM
+// and returns the entry
+RomInfo LookUpRom(const char* catalogFilename, const char* romFilename);
+
+} // namespace Chip8Emulator
+
+#endif // ROM_CATALOG_H
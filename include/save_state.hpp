@@ -0,0 +1,49 @@
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "chip8.hpp"
+
+namespace Chip8Emulator{
+
+constexpr uint32_t SAVE_STATE_MAGIC = 0x54533843; // "C8ST"
+constexpr uint32_t SAVE_STATE_VERSION = 4;
+
+// Everything in a save state except memory and the display
+struct MachineStateHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t randomState;
+    uint8_t registers[REGISTER_COUNT];
+    uint16_t stack[STACK_LEVELS];
+    uint16_t indexRegister;
+    uint16_t programCounter;
+    uint8_t stackPointer;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint8_t quirkProfile;
+    uint8_t variant;
+    uint8_t hiRes;
+    uint8_t planeMask;
+    uint8_t pitch;
+    uint8_t flags[REGISTER_COUNT];
+    uint8_t audioPattern[AUDIO_PATTERN_SIZE];
+};
+
+static_assert(std::is_trivially_copyable_v<MachineStateHeader>);
+
+// Complete machine state: a MachineStateHeader, then the variant's memory
+// (4 KB, or 64 KB on XO-CHIP), then its display (one low-resolution plane on
+// CHIP-8, one hi-res plane on SUPER-CHIP, four on XO-CHIP), so a CHIP-8
+// state is under 5 KB. Saving again into the same state reuses its buffer.
+// The keypad is host input and is not part of it; the execution mode and its
+// caches are rebuilt by LoadState.
+struct MachineState {
+    std::vector<uint8_t> bytes;
+};
+
+} // namespace Chip8Emulator
+
+#endif // SAVE_STATE_H
@@ -1,5 +1,7 @@
 #include "raylib.h"
-#include <iostream>
+#include "audio.hpp"
+#include "display.hpp"
+#include <bit>
 #include <memory>
 #include <vector>
 
@@ -7,24 +9,37 @@ class Screen {
 private:
     int width;
     int height;
-    int textureWidth;
+    int textureWidth;   // Largest display size; smaller displays use the top-left corner
     int textureHeight;
-    std::unique_ptr<Color[]> buffer;
+    int displayWidth;
+    int displayHeight;
+    std::unique_ptr<uint32_t[]> buffer; // R8G8B8A8 pixels, displayWidth per row
     Texture2D smallTexture;
     RenderTexture2D renderTexture;
-    Sound beep;
+    bool textureDirty = true; // smallTexture changed since renderTexture was last drawn
+    AudioStream audioStream{};
+    bool audioStarted = false;
+
+    // raylib audio callbacks take no user pointer; there is one stream per process
+    static inline Chip8Emulator::ToneGenerator* tone = nullptr;
+
+    // Small buffers keep the tone start within a few milliseconds of the timer
+    static constexpr int AUDIO_BUFFER_FRAMES = 512;
+
+    static constexpr uint32_t PIXEL_ON = Chip8Emulator::DISPLAY_PIXEL_ON;
+    static constexpr uint32_t PIXEL_OFF = Chip8Emulator::DISPLAY_PIXEL_OFF;
 
     void InitialiseImageTexture() {
         for (int i = 0; i < textureWidth * textureHeight; i++) {
-            buffer[i] = Color{ 255, 255, 255, 255 };
+            buffer[i] = PIXEL_ON;
         }
 
         Image img = {
             .data = buffer.get(),
             .width = textureWidth,
             .height = textureHeight,
-            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
-            .mipmaps = 1
+            .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8
         };
 
         smallTexture = LoadTextureFromImage(img);
@@ -37,18 +52,11 @@ public:
           height(height),
           textureWidth(textureWidth),
           textureHeight(textureHeight),
-          buffer(std::make_unique<Color[]>(textureWidth * textureHeight))
+          displayWidth(textureWidth),
+          displayHeight(textureHeight),
+          buffer(std::make_unique<uint32_t[]>(textureWidth * textureHeight))
     {
         InitWindow(width, height, title);
-        InitAudioDevice();
-
-        std::string workingDir = GetWorkingDirectory();
-        std::string beepPath = workingDir + "/sounds/beep.wav"; // Adjust the path as necessary
-
-        beep = LoadSound(beepPath.c_str());
-        if (beep.frameCount == 0) {
-            std::cerr << "Failed to load beep sound from path: " << beepPath << std::endl;
-        }
         SetTargetFPS(delay);
         InitialiseImageTexture();
     }
@@ -60,49 +68,99 @@ public:
     Screen& operator=(Screen&& other) noexcept = default;
 
     ~Screen() {
+        StopAudio();
         CloseWindow();
         UnloadTexture(smallTexture);
         UnloadRenderTexture(renderTexture);
-        UnloadSound(beep);
     }
 
-    void Update2DTexture(const uint32_t* m_Display) {
-        for (int i = 0; i < textureWidth * textureHeight; i++) {
-            buffer[i] = (m_Display[i] == 0x00000000) ? Color{ 0, 0, 0, 255 } : Color{ 255, 255, 255, 255 };
+    // Streams the buzzer from generator (not owned) until StopAudio
+    void StartAudio(Chip8Emulator::ToneGenerator& generator) {
+        InitAudioDevice();
+        SetAudioStreamBufferSizeDefault(AUDIO_BUFFER_FRAMES);
+        audioStream = LoadAudioStream(Chip8Emulator::AUDIO_SAMPLE_RATE, 32, 1);
+        tone = &generator;
+        SetAudioStreamCallback(audioStream, [](void* samples, unsigned int frames) {
+            tone->Generate(static_cast<float*>(samples), frames);
+        });
+        PlayAudioStream(audioStream);
+        audioStarted = true;
+    }
+
+    void StopAudio() {
+        if (!audioStarted) {
+            return;
+        }
+        StopAudioStream(audioStream);
+        UnloadAudioStream(audioStream);
+        CloseAudioDevice();
+        tone = nullptr;
+        audioStarted = false;
+    }
+
+    // Takes the packed display planes (width / 64 words per row) and the rows
+    // changed since the last call (bit n = row n). Only the span of dirty rows
+    // is expanded to RGBA and uploaded; an unchanged frame costs nothing. A
+    // resolution change redraws everything.
+    void Update2DTexture(const uint64_t* const* planes, unsigned int planeCount, int width, int height,
+                         uint64_t dirtyRows) {
+        if (width != displayWidth || height != displayHeight) {
+            displayWidth = width;
+            displayHeight = height;
+            dirtyRows = ~0ull;
+        }
+        if (dirtyRows == 0) {
+            return;
         }
 
-        UpdateTexture(smallTexture, buffer.get());
+        int first = std::countr_zero(dirtyRows);
+        int last = 64 - std::countl_zero(dirtyRows);
+        if (last > displayHeight) {
+            last = displayHeight;
+        }
+
+        if (planeCount == 1) {
+            Chip8Emulator::ExpandDisplayRows(planes[0], first, last, displayWidth, buffer.get(), PIXEL_ON, PIXEL_OFF);
+        } else {
+            Chip8Emulator::ExpandBitplaneRows(planes, planeCount, first, last, displayWidth, buffer.get(),
+                                              Chip8Emulator::DISPLAY_PALETTE);
+        }
+
+        Rectangle rows = { 0, static_cast<float>(first), static_cast<float>(displayWidth), static_cast<float>(last - first) };
+        UpdateTextureRec(smallTexture, rows, buffer.get() + first * displayWidth);
+        textureDirty = true;
+    }
+
+    // Re-renders the scaled frame only when the texture changed; otherwise the
+    // previous render texture is presented as is
+    void DrawScaledTexture() {
+        if (textureDirty) {
+            RenderScaledTexture();
+            textureDirty = false;
+        }
+        DrawTexture(renderTexture.texture, 0, 0, WHITE);
     }
 
-   void DrawScaledTexture() const {
+    void RenderScaledTexture() const {
         BeginTextureMode(renderTexture);
         ClearBackground(BLANK);
 
-        float scaleX = static_cast<float>(width) / textureWidth;
-        float scaleY = static_cast<float>(height) / textureHeight;
+        float scaleX = static_cast<float>(width) / displayWidth;
+        float scaleY = static_cast<float>(height) / displayHeight;
         float scale = (scaleX < scaleY) ? scaleX : scaleY; 
 
-        float scaledWidth = textureWidth * scale;
-        float scaledHeight = textureHeight * scale;
+        float scaledWidth = displayWidth * scale;
+        float scaledHeight = displayHeight * scale;
 
         float offsetX = (width - scaledWidth) / 2.0f; 
         float offsetY = (height - scaledHeight) / 2.0f;
 
         DrawTexturePro(smallTexture,
-                       { 0, 0, static_cast<float>(smallTexture.width), -static_cast<float>(smallTexture.height) },
+                       { 0, 0, static_cast<float>(displayWidth), -static_cast<float>(displayHeight) },
                        { offsetX, offsetY, scaledWidth, scaledHeight },
                        { 0, 0 }, 0.0f, WHITE);
 
         EndTextureMode();
-        DrawTexture(renderTexture.texture, 0, 0, WHITE);
-    }
-
-    void PlayBeep() const {
-        if (beep.frameCount > 0){
-            PlaySound(beep);
-        } else {
-            std::cout << "BEEP!" << std::endl;
-        }
     }
 
     bool ProcessInput(uint8_t* keys) const {
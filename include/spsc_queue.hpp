@@ -0,0 +1,47 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace Chip8Emulator{
+
+// Bounded lock-free ring for one producer thread and one consumer thread.
+// Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // False when full; the item is dropped
+    bool Push(const T& item) {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_Head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_Items[tail & (Capacity - 1)] = item;
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // False when empty
+    bool Pop(T& item) {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_Tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_Items[head & (Capacity - 1)];
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> m_Head{0};
+    alignas(64) std::atomic<size_t> m_Tail{0};
+    std::array<T, Capacity> m_Items{};
+};
+
+} // namespace Chip8Emulator
+
+#endif // SPSC_QUEUE_H
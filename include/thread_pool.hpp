@@ -0,0 +1,78 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Chip8Emulator{
+
+// Fixed set of worker threads, each owning a deque of index ranges. A worker
+// pops from the back of its own deque and steals from the front of the others
+// once it runs dry. Deques keep their storage between calls, so a steady-state
+// ParallelFor does not allocate.
+class ThreadPool {
+public:
+    using TaskFunc = void (*)(void* context, size_t begin, size_t end);
+
+    // threads == 0 uses every hardware thread; pinned workers are bound to one core each
+    explicit ThreadPool(unsigned int threads = 0, bool pin = true);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_Workers.size()); }
+
+    // Calls func over [0, count) in chunks of at most grain and blocks until
+    // all chunks are done. func must not throw.
+    void ParallelFor(size_t count, size_t grain, TaskFunc func, void* context);
+
+    template <typename Func>
+    void ParallelFor(size_t count, size_t grain, Func& func) {
+        ParallelFor(count, grain, [](void* context, size_t begin, size_t end) {
+            (*static_cast<Func*>(context))(begin, end);
+        }, &func);
+    }
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::vector<Range> ranges;
+        size_t head = 0;
+        size_t tail = 0;
+
+        bool PopBack(Range& range);
+        bool PopFront(Range& range);
+    };
+
+    std::vector<std::thread> m_Workers;
+    std::unique_ptr<WorkQueue[]> m_Queues;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkReady;
+    std::condition_variable m_WorkDone;
+    uint64_t m_Generation = 0;
+    bool m_Stop = false;
+
+    TaskFunc m_Func = nullptr;
+    void* m_Context = nullptr;
+    std::atomic<size_t> m_Remaining{0};
+
+    void WorkerLoop(unsigned int id);
+    bool NextRange(unsigned int id, Range& range);
+};
+
+} // namespace Chip8Emulator
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include "spsc_queue.hpp"
+
+namespace Chip8Emulator{
+
+constexpr uint32_t TRACE_MAGIC = 0x52543843; // "C8TR"
+constexpr uint32_t TRACE_VERSION = 1;
+constexpr size_t TRACE_RING_SIZE = 1 << 16;
+
+// One executed instruction, written in host byte order after an 8-byte header
+// (magic u32, version u32). State is as it was before the instruction ran.
+struct TraceRecord {
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t index;
+    uint8_t vf;
+    uint8_t sp;
+};
+
+static_assert(sizeof(TraceRecord) == 8);
+
+// Per-instruction binary trace of one Chip8, filled in by the interpreter when
+// the core is built with CHIP8_TRACE. Records go through a lock-free ring to a
+// writer thread; the interpreter waits only if the writer falls a full ring
+// behind, so no record is lost.
+class Tracer {
+public:
+    explicit Tracer(const char* filename);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    void Record(const TraceRecord& record) {
+        while (!m_Ring.Push(record)) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::FILE* m_File;
+    SpscQueue<TraceRecord, TRACE_RING_SIZE> m_Ring;
+    std::atomic<bool> m_Stop{false};
+    std::thread m_Writer;
+
+    void Drain(TraceRecord* buffer, size_t capacity);
+};
+
+} // namespace Chip8Emulator
+
+#endif // TRACE_H
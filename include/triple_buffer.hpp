@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace Chip8Emulator{
+
+// Lock-free handoff of the newest value from one producer thread to one
+// consumer thread. The producer fills Back() and publishes it; the consumer
+// picks up the newest published slot, skipping any it was too slow to see.
+// Neither side ever waits for the other.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer side
+    T& Back() { return m_Slots[m_Back]; }
+
+    void Publish() {
+        m_Back = m_Middle.exchange(m_Back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side: swaps in the newest slot; false if nothing was published since
+    bool Update() {
+        if ((m_Middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& Front() const { return m_Slots[m_Front]; }
+
+private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> m_Slots{};
+    alignas(64) uint8_t m_Back = 0;
+    alignas(64) std::atomic<uint8_t> m_Middle{1};
+    alignas(64) uint8_t m_Front = 2;
+};
+
+} // namespace Chip8Emulator
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,39 @@
+#ifndef XORSHIFT_H
+#define XORSHIFT_H
+
+#include <cstdint>
+
+namespace Chip8Emulator{
+
+// xorshift64* generator for Cxkk: one word of state, no allocation and
+// trivially copyable, so a machine's random stream is forked with the rest
+// of its state by a plain copy
+class Xorshift {
+public:
+    explicit Xorshift(uint64_t seed = 0) { Seed(seed); }
+
+    // Seeds pass through splitmix64 first, so 0 and consecutive seeds are fine
+    void Seed(uint64_t seed) {
+        uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        m_State = (z ^ (z >> 31)) | 1;
+    }
+
+    uint8_t NextByte() {
+        m_State ^= m_State >> 12;
+        m_State ^= m_State << 25;
+        m_State ^= m_State >> 27;
+        return static_cast<uint8_t>((m_State * 0x2545F4914F6CDD1Dull) >> 56);
+    }
+
+    uint64_t GetState() const { return m_State; }
+    void SetState(uint64_t state) { m_State = state != 0 ? state : 1; }
+
+private:
+    uint64_t m_State;
+};
+
+} // namespace Chip8Emulator
+
+#endif // XORSHIFT_H
@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "disassembler.hpp"
+#include "recompiler.hpp"
+#include "rom.hpp"
+#include <getopt.h>
+
+// Prints every basic block the recompiler would translate
+void ListBlocks(const Chip8Emulator::RomImage& rom) {
+    using namespace Chip8Emulator;
+
+    for (const auto& block : FindBasicBlocks(rom.GetData(), rom.GetSize())) {
+        char line[64];
+        snprintf(line, sizeof(line), "Block 0x%04X-0x%04X", block.start, block.end);
+        std::cout << line << "\n";
+        for (uint32_t pc = block.start; pc < block.end; pc += 2) {
+            uint16_t opcode = (rom.GetData()[pc - START_ADDR] << 8) | rom.GetData()[pc - START_ADDR + 1];
+            snprintf(line, sizeof(line), "  0x%04X  %04X  ", pc, opcode);
+            std::cout << line << Disassemble(opcode) << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Chip8Emulator::QuirkProfile quirks = Chip8Emulator::QuirkProfile::Modern;
+    std::string name;
+    const char* outputFilename = nullptr;
+    bool list = false;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"quirks", required_argument, 0, 'q'},
+        {"name", required_argument, 0, 'n'},
+        {"output", required_argument, 0, 'o'},
+        {"list", no_argument, 0, 'l'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    bool validOptions = true;
+    while ((opt = getopt_long(argc, argv, "q:n:o:l", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'q':
+                validOptions &= Chip8Emulator::ParseQuirkProfile(optarg, quirks);
+                break;
+            case 'n':
+                name = optarg;
+                break;
+            case 'o':
+                outputFilename = optarg;
+                break;
+            case 'l':
+                list = true;
+                break;
+            default:
+                validOptions = false;
+                break;
+        }
+    }
+
+    if (!validOptions || optind != argc - 1) {
+        std::cerr << "Usage: " << argv[0] << " [options] <ROM file>\n"
+                  << "Translates a CHIP-8 ROM to C++ for linking into the emulator (--backend aot)\n"
+                  << "Options:\n"
+                  << "  --quirks <profile>  Quirk profile: modern, cosmac, schip or xochip (default: modern)\n"
+                  << "  --name <name>       Program name (default: the ROM's file name)\n"
+                  << "  -o, --output <file> Write the C++ here instead of to stdout\n"
+                  << "  --list              Print the recovered basic blocks instead\n";
+        return 1;
+    }
+
+    const char* romFilename = argv[optind];
+    if (name.empty()) {
+        name = std::filesystem::path(romFilename).stem().string();
+    }
+
+    try {
+        Chip8Emulator::RomImage rom(romFilename);
+        if (list) {
+            ListBlocks(rom);
+            return 0;
+        }
+
+        std::string source = Chip8Emulator::Recompile(rom.GetData(), rom.GetSize(), quirks, name);
+        if (outputFilename == nullptr) {
+            std::cout << source;
+            return 0;
+        }
+
+        std::ofstream output(outputFilename, std::ios::trunc);
+        if (!output.is_open() || !(output << source).flush()) {
+            std::cerr << "Failed to write " << outputFilename << "\n";
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << romFilename << ": " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
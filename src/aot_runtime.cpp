@@ -0,0 +1,93 @@
+#include "aot_runtime.hpp"
+#include "rom.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Chip8Emulator{
+
+namespace {
+
+// Bounds the chain of tail calls when they are not optimized away
+constexpr uint32_t MAX_CHAIN_BUDGET = 4096;
+
+std::vector<const AotProgram*>& Programs() {
+    static std::vector<const AotProgram*> programs;
+    return programs;
+}
+
+} // namespace
+
+void RegisterAotProgram(const AotProgram& program) {
+    Programs().push_back(&program);
+}
+
+const AotProgram* FindAotProgram(const uint8_t* rom, size_t size, QuirkProfile profile) {
+    uint64_t hash = HashBytes(rom, size);
+    for (const AotProgram* program : Programs()) {
+        if (program->romHash == hash && program->romSize == size && program->quirks == profile &&
+            std::memcmp(program->rom, rom, size) == 0) {
+            return program;
+        }
+    }
+    return nullptr;
+}
+
+AotRunner::AotRunner(const AotProgram& program)
+: m_Program(program),
+  m_Valid(program.blockCount, 0)
+{
+    for (size_t i = 0; i < program.blockCount; i++) {
+        for (unsigned int address = program.blocks[i].start; address < program.blocks[i].end; address++) {
+            m_Code.set(address);
+        }
+        for (unsigned int address = program.blocks[i].start; address < program.blocks[i].end; address += 2) {
+            m_BlockIndex[address] = static_cast<uint16_t>(i + 1);
+        }
+    }
+}
+
+void AotRunner::Execute(Chip8& chip8, uint32_t cycles) {
+    while (cycles > 0) {
+        uint16_t pc = chip8.m_ProgramCounter;
+        uint16_t index = pc < MEMORY_SIZE ? m_BlockIndex[pc] : 0;
+
+        if (index == 0 || !m_Valid[index - 1]) {
+            chip8.Cycle();
+            cycles--;
+        } else {
+            cycles -= m_Program.blocks[index - 1].code(chip8, m_Valid.data(), std::min(cycles, MAX_CHAIN_BUDGET), 0, pc);
+        }
+    }
+}
+
+void AotRunner::Invalidate(uint16_t address, uint16_t length) {
+    ForEachWrittenRange(address, length, [this](unsigned int first, unsigned int last) { InvalidateRange(first, last); });
+}
+
+void AotRunner::InvalidateRange(unsigned int address, unsigned int last) {
+    // Most writes are to data, away from any compiled code
+    bool code = false;
+    for (unsigned int i = address; i <= last; i++) {
+        code |= m_Code[i];
+    }
+    if (!code) {
+        return;
+    }
+
+    for (size_t i = 0; i < m_Program.blockCount; i++) {
+        const AotBlock& block = m_Program.blocks[i];
+        if (block.start <= last && block.end > address) {
+            m_Valid[i] = 0;
+        }
+    }
+}
+
+void AotRunner::Flush(const Chip8& chip8) {
+    for (size_t i = 0; i < m_Program.blockCount; i++) {
+        const AotBlock& block = m_Program.blocks[i];
+        const uint8_t* compiled = m_Program.rom + (block.start - START_ADDR);
+        m_Valid[i] = std::equal(compiled, compiled + (block.end - block.start), chip8.m_Data + block.start);
+    }
+}
+
+} // namespace Chip8Emulator
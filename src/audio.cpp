@@ -0,0 +1,65 @@
+#include "audio.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Chip8Emulator{
+
+void ToneGenerator::SetTone(const Tone& tone) {
+    if (std::memcmp(&tone, &m_Published, sizeof(Tone)) == 0) {
+        return;
+    }
+
+    m_Published = tone;
+    m_Tones.Back() = tone;
+    m_Tones.Publish();
+}
+
+void ToneGenerator::Generate(float* samples, size_t frames) {
+    if (m_Tones.Update()) {
+        m_Tone = m_Tones.Front();
+        if (m_Tone.usePattern) {
+            double bitRate = PATTERN_BASE_RATE * std::exp2((m_Tone.pitch - 64) / 48.0);
+            m_Step = bitRate / AUDIO_SAMPLE_RATE;
+        } else {
+            m_Step = BEEP_FREQUENCY / AUDIO_SAMPLE_RATE;
+        }
+    }
+
+    // Phase counts square-wave periods, or pattern bits, modulo one loop
+    const double length = m_Tone.usePattern ? AUDIO_PATTERN_SIZE * 8 : 1.0;
+    for (size_t i = 0; i < frames; i++) {
+        if (!m_Playing.load(std::memory_order_relaxed)) {
+            samples[i] = 0.0f;
+            continue;
+        }
+
+        bool high;
+        if (m_Tone.usePattern) {
+            unsigned int bit = static_cast<unsigned int>(m_Phase);
+            high = (m_Tone.pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+        } else {
+            high = m_Phase < 0.5;
+        }
+        samples[i] = high ? AUDIO_VOLUME : -AUDIO_VOLUME;
+
+        m_Phase += m_Step;
+        if (m_Phase >= length) {
+            m_Phase = std::fmod(m_Phase, length);
+        }
+    }
+}
+
+Tone CurrentTone(const Chip8& chip8) {
+    Tone tone{};
+    const uint8_t* pattern = chip8.GetAudioPattern();
+    std::memcpy(tone.pattern, pattern, AUDIO_PATTERN_SIZE);
+    tone.pitch = chip8.GetPitch();
+
+    // An XO-CHIP program that never loads a pattern still gets the plain beep
+    tone.usePattern = chip8.GetVariant() == Variant::XoChip &&
+        std::any_of(pattern, pattern + AUDIO_PATTERN_SIZE, [](uint8_t bits) { return bits != 0; });
+    return tone;
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,491 @@
+#include "batch.hpp"
+#include "font.hpp"
+#include "rom.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace Chip8Emulator{
+
+namespace {
+
+// Byte-lane vector primitives. AVX2 handles 32 lanes per operation, SSE2 16,
+// and the portable fallback 16 in a loop the compiler can vectorize itself.
+#if defined(__AVX2__)
+
+using Vec = __m256i;
+constexpr size_t VEC_BYTES = 32;
+
+inline Vec Load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline void Store(uint8_t* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+inline Vec Splat(uint8_t value) { return _mm256_set1_epi8(static_cast<char>(value)); }
+inline Vec Add(Vec a, Vec b) { return _mm256_add_epi8(a, b); }
+inline Vec Sub(Vec a, Vec b) { return _mm256_sub_epi8(a, b); }
+inline Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+inline Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline Vec Xor(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+inline Vec AndNot(Vec a, Vec b) { return _mm256_andnot_si256(a, b); }
+inline Vec CmpEq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+inline Vec MaxU(Vec a, Vec b) { return _mm256_max_epu8(a, b); }
+inline Vec SubSaturate(Vec a, Vec b) { return _mm256_subs_epu8(a, b); }
+inline Vec ShiftRight16(Vec a, int n) { return _mm256_srli_epi16(a, n); }
+inline Vec Blend(Vec a, Vec b, Vec mask) { return _mm256_blendv_epi8(a, b, mask); }
+
+#elif defined(__SSE2__)
+
+using Vec = __m128i;
+constexpr size_t VEC_BYTES = 16;
+
+inline Vec Load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void Store(uint8_t* p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+inline Vec Splat(uint8_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+inline Vec Add(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+inline Vec Sub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+inline Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+inline Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline Vec Xor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+inline Vec AndNot(Vec a, Vec b) { return _mm_andnot_si128(a, b); }
+inline Vec CmpEq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+inline Vec MaxU(Vec a, Vec b) { return _mm_max_epu8(a, b); }
+inline Vec SubSaturate(Vec a, Vec b) { return _mm_subs_epu8(a, b); }
+inline Vec ShiftRight16(Vec a, int n) { return _mm_srli_epi16(a, n); }
+inline Vec Blend(Vec a, Vec b, Vec mask) { return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a)); }
+
+#else
+
+constexpr size_t VEC_BYTES = 16;
+
+struct Vec {
+    uint8_t b[VEC_BYTES];
+};
+
+template <typename Func>
+inline Vec Map(Vec a, Vec b, Func func) {
+    Vec r;
+    for (size_t i = 0; i < VEC_BYTES; i++) {
+        r.b[i] = static_cast<uint8_t>(func(a.b[i], b.b[i]));
+    }
+    return r;
+}
+
+inline Vec Load(const uint8_t* p) { Vec v; std::memcpy(v.b, p, VEC_BYTES); return v; }
+inline void Store(uint8_t* p, Vec v) { std::memcpy(p, v.b, VEC_BYTES); }
+inline Vec Splat(uint8_t value) { Vec v; std::memset(v.b, value, VEC_BYTES); return v; }
+inline Vec Add(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x + y; }); }
+inline Vec Sub(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x - y; }); }
+inline Vec And(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x & y; }); }
+inline Vec Or(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x | y; }); }
+inline Vec Xor(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x ^ y; }); }
+inline Vec AndNot(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return ~x & y; }); }
+inline Vec CmpEq(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x == y ? 0xFF : 0x00; }); }
+inline Vec MaxU(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return std::max(x, y); }); }
+inline Vec SubSaturate(Vec a, Vec b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x > y ? x - y : 0; }); }
+inline Vec Blend(Vec a, Vec b, Vec mask) { return Or(And(mask, b), AndNot(mask, a)); }
+
+// Only used by the byte shifts below, which mask off bits crossing byte boundaries
+inline Vec ShiftRight16(Vec a, int n) { return Map(a, a, [n](uint8_t x, uint8_t) { return x >> n; }); }
+
+#endif
+
+// a > b, unsigned, as a 0xFF/0x00 mask
+inline Vec GreaterU(Vec a, Vec b) { return AndNot(CmpEq(a, b), CmpEq(MaxU(a, b), a)); }
+inline Vec ShiftRight1(Vec a) { return And(ShiftRight16(a, 1), Splat(0x7F)); }
+inline Vec ShiftRight7(Vec a) { return And(ShiftRight16(a, 7), Splat(0x01)); }
+inline Vec ShiftLeft1(Vec a) { return Add(a, a); }
+
+size_t PadLanes(size_t lanes) {
+    return (lanes + BATCH_LANE_ALIGNMENT - 1) / BATCH_LANE_ALIGNMENT * BATCH_LANE_ALIGNMENT;
+}
+
+} // namespace
+
+Chip8Batch::Chip8Batch(size_t lanes)
+: m_Lanes(lanes),
+  m_Stride(PadLanes(lanes)),
+  m_Data(std::make_unique<uint8_t[]>(MEMORY_SIZE * m_Stride)),
+  m_Register(std::make_unique<uint8_t[]>(REGISTER_COUNT * m_Stride)),
+  m_Stack(std::make_unique<uint16_t[]>(STACK_LEVELS * m_Stride)),
+  m_Keypad(std::make_unique<uint8_t[]>(KEY_COUNT * m_Stride)),
+  m_IndexRegister(std::make_unique<uint16_t[]>(m_Stride)),
+  m_ProgramCounter(std::make_unique<uint16_t[]>(m_Stride)),
+  m_StackPointer(std::make_unique<uint8_t[]>(m_Stride)),
+  m_DelayTimer(std::make_unique<uint8_t[]>(m_Stride)),
+  m_SoundTimer(std::make_unique<uint8_t[]>(m_Stride)),
+  m_Active(std::make_unique<uint8_t[]>(m_Stride)),
+  m_Pending(std::make_unique<uint8_t[]>(m_Stride)),
+  m_Display(std::make_unique<uint64_t[]>(m_Lanes * VIDEO_HEIGHT)),
+  m_RandGen(lanes)
+{
+    if (lanes == 0) {
+        throw std::invalid_argument("Chip8Batch needs at least one lane");
+    }
+
+    std::fill_n(m_ProgramCounter.get(), m_Stride, START_ADDR);
+
+    for (uint8_t i = 0; i < FONTSET_SIZE; ++i) {
+        std::memset(Row(m_Data.get(), FONTSET_START_ADDR + i), fontset[i], m_Stride);
+    }
+    for (uint8_t i = 0; i < BIG_FONTSET_SIZE; ++i) {
+        std::memset(Row(m_Data.get(), BIG_FONTSET_START_ADDR + i), bigFontset[i], m_Stride);
+    }
+
+    auto seed = std::chrono::system_clock::now().time_since_epoch().count();
+    for (size_t lane = 0; lane < m_Lanes; lane++) {
+        m_RandGen[lane].Seed(seed + lane);
+    }
+}
+
+void Chip8Batch::LoadROM(const char* filename) {
+    RomImage rom(filename);
+    if (rom.GetSize() > MEMORY_SIZE - START_ADDR) {
+        throw std::runtime_error("ROM does not fit in memory.");
+    }
+
+    const uint8_t* bytes = rom.GetData();
+    for (size_t i = 0; i < rom.GetSize(); i++) {
+        std::memset(Row(m_Data.get(), START_ADDR + i), bytes[i], m_Stride);
+    }
+}
+
+void Chip8Batch::SetKeys(size_t lane, uint16_t keys) {
+    for (unsigned int key = 0; key < KEY_COUNT; key++) {
+        Row(m_Keypad.get(), key)[lane] = (keys >> key) & 1;
+    }
+}
+
+void Chip8Batch::Seed(size_t lane, uint64_t seed) {
+    m_RandGen[lane].Seed(seed);
+}
+
+void Chip8Batch::SaveState(size_t lane, MachineState& state) const {
+    MachineStateHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = SAVE_STATE_MAGIC;
+    header.version = SAVE_STATE_VERSION;
+    header.randomState = m_RandGen[lane].GetState();
+    for (unsigned int x = 0; x < REGISTER_COUNT; x++) {
+        header.registers[x] = Register(x)[lane];
+    }
+    for (unsigned int level = 0; level < STACK_LEVELS; level++) {
+        header.stack[level] = m_Stack[level * m_Stride + lane];
+    }
+    header.indexRegister = m_IndexRegister[lane];
+    header.programCounter = m_ProgramCounter[lane];
+    header.stackPointer = m_StackPointer[lane];
+    header.delayTimer = m_DelayTimer[lane];
+    header.soundTimer = m_SoundTimer[lane];
+    header.quirkProfile = static_cast<uint8_t>(QuirkProfile::Modern);
+    header.variant = static_cast<uint8_t>(Variant::Chip8);
+    header.planeMask = 1;
+    header.pitch = 64;
+
+    const size_t display = VIDEO_HEIGHT * sizeof(uint64_t);
+    state.bytes.resize(sizeof(header) + MEMORY_SIZE + display);
+    uint8_t* out = state.bytes.data();
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (unsigned int address = 0; address < MEMORY_SIZE; address++) {
+        out[address] = Row(m_Data.get(), address)[lane];
+    }
+    std::memcpy(out + MEMORY_SIZE, getDisplay(lane), display);
+}
+
+void Chip8Batch::Run(uint32_t cycles) {
+    for (uint32_t i = 0; i < cycles; i++) {
+        Step();
+    }
+}
+
+void Chip8Batch::DecrementTimers() {
+    const Vec one = Splat(1);
+    const size_t stride = m_Stride;
+
+    for (size_t i = 0; i < stride; i += VEC_BYTES) {
+        Store(m_DelayTimer.get() + i, SubSaturate(Load(m_DelayTimer.get() + i), one));
+        Store(m_SoundTimer.get() + i, SubSaturate(Load(m_SoundTimer.get() + i), one));
+    }
+}
+
+// Executes one instruction on every lane. Lanes are grouped by (PC, opcode):
+// the first pending lane picks the group, every lane matching it runs under
+// the active mask, and the remaining lanes form further groups.
+void Chip8Batch::Step() {
+    uint8_t* active = m_Active.get();
+    uint8_t* pending = m_Pending.get();
+    uint16_t* pc = m_ProgramCounter.get();
+    const size_t stride = m_Stride;
+
+    std::memset(pending, 0xFF, m_Lanes);
+    std::memset(pending + m_Lanes, 0x00, m_Stride - m_Lanes);
+
+    size_t leader = 0;
+    while (true) {
+        while (leader < m_Lanes && !pending[leader]) {
+            leader++;
+        }
+        if (leader == m_Lanes) {
+            break;
+        }
+
+        const uint16_t groupPc = pc[leader];
+        const uint16_t address = groupPc & (MEMORY_SIZE - 1);
+        const uint8_t* high = Row(m_Data.get(), address);
+        const uint8_t* low = Row(m_Data.get(), (address + 1) & (MEMORY_SIZE - 1));
+        const uint8_t highByte = high[leader];
+        const uint8_t lowByte = low[leader];
+
+        for (size_t lane = 0; lane < stride; lane++) {
+            uint8_t match = (pc[lane] == groupPc) & (high[lane] == highByte) & (low[lane] == lowByte);
+            uint8_t mask = pending[lane] & static_cast<uint8_t>(-match);
+            active[lane] = mask;
+            pending[lane] &= ~mask;
+            pc[lane] += mask & 2;
+        }
+
+        uint16_t opcode = (highByte << 8u) | lowByte;
+        Execute(Chip8::Decode(opcode), DecodeOpcodeId(opcode));
+    }
+}
+
+void Chip8Batch::Execute(const Instruction& ins, OpcodeId id) {
+    const uint8_t* active = m_Active.get();
+    uint8_t* vx = Register(ins.x);
+    uint8_t* vy = Register(ins.y);
+    uint8_t* vf = Register(0xF);
+    uint16_t* pc = m_ProgramCounter.get();
+    uint16_t* index = m_IndexRegister.get();
+    uint8_t* sp = m_StackPointer.get();
+    const size_t stride = m_Stride;
+    const Vec one = Splat(1);
+
+    // Each kernel re-loads its operands after writing VF so that x or y == F
+    // behaves exactly as in the sequential Chip8 handlers.
+    switch (id) {
+        case OpcodeId::OP_6xkk:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, Blend(Load(vx + i), Splat(ins.kk), Load(active + i)));
+            }
+            return;
+        case OpcodeId::OP_7xkk:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, Add(Load(vx + i), And(Splat(ins.kk), Load(active + i))));
+            }
+            return;
+        case OpcodeId::OP_8xy0:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, Blend(Load(vx + i), Load(vy + i), Load(active + i)));
+            }
+            return;
+        case OpcodeId::OP_8xy1:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, Or(Load(vx + i), And(Load(vy + i), Load(active + i))));
+            }
+            return;
+        case OpcodeId::OP_8xy2:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, And(Load(vx + i), Or(Load(vy + i), AndNot(Load(active + i), Splat(0xFF)))));
+            }
+            return;
+        case OpcodeId::OP_8xy3:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, Xor(Load(vx + i), And(Load(vy + i), Load(active + i))));
+            }
+            return;
+        case OpcodeId::OP_8xy4:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Vec mask = Load(active + i);
+                Vec a = Load(vx + i);
+                Vec sum = Add(a, Load(vy + i));
+                Vec carry = And(GreaterU(a, sum), one);
+                Store(vx + i, Blend(a, sum, mask));
+                Store(vf + i, Blend(Load(vf + i), carry, mask));
+            }
+            return;
+        case OpcodeId::OP_8xy5:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Vec mask = Load(active + i);
+                Vec borrow = And(GreaterU(Load(vx + i), Load(vy + i)), one);
+                Store(vf + i, Blend(Load(vf + i), borrow, mask));
+                Vec a = Load(vx + i);
+                Store(vx + i, Blend(a, Sub(a, Load(vy + i)), mask));
+            }
+            return;
+        case OpcodeId::OP_8xy6:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Vec mask = Load(active + i);
+                Store(vf + i, Blend(Load(vf + i), And(Load(vx + i), one), mask));
+                Vec a = Load(vx + i);
+                Store(vx + i, Blend(a, ShiftRight1(a), mask));
+            }
+            return;
+        case OpcodeId::OP_8xy7:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Vec mask = Load(active + i);
+                Vec borrow = And(GreaterU(Load(vy + i), Load(vx + i)), one);
+                Store(vf + i, Blend(Load(vf + i), borrow, mask));
+                Vec a = Load(vx + i);
+                Store(vx + i, Blend(a, Sub(Load(vy + i), a), mask));
+            }
+            return;
+        case OpcodeId::OP_8xyE:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Vec mask = Load(active + i);
+                Store(vf + i, Blend(Load(vf + i), ShiftRight7(Load(vx + i)), mask));
+                Vec a = Load(vx + i);
+                Store(vx + i, Blend(a, ShiftLeft1(a), mask));
+            }
+            return;
+        case OpcodeId::OP_Fx07:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(vx + i, Blend(Load(vx + i), Load(m_DelayTimer.get() + i), Load(active + i)));
+            }
+            return;
+        case OpcodeId::OP_Fx15:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(m_DelayTimer.get() + i, Blend(Load(m_DelayTimer.get() + i), Load(vx + i), Load(active + i)));
+            }
+            return;
+        case OpcodeId::OP_Fx18:
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Store(m_SoundTimer.get() + i, Blend(Load(m_SoundTimer.get() + i), Load(vx + i), Load(active + i)));
+            }
+            return;
+        case OpcodeId::OP_3xkk:
+        case OpcodeId::OP_4xkk:
+        case OpcodeId::OP_5xy0:
+        case OpcodeId::OP_9xy0: {
+            // Build the skip mask with vector compares, then advance the 16-bit PCs
+            for (size_t i = 0; i < stride; i += VEC_BYTES) {
+                Vec other = (id == OpcodeId::OP_3xkk || id == OpcodeId::OP_4xkk) ? Splat(ins.kk) : Load(vy + i);
+                Vec equal = CmpEq(Load(vx + i), other);
+                Vec taken = (id == OpcodeId::OP_3xkk || id == OpcodeId::OP_5xy0) ? equal : AndNot(equal, Splat(0xFF));
+                alignas(32) uint8_t lanes[VEC_BYTES];
+                Store(lanes, And(taken, Load(active + i)));
+                for (size_t lane = 0; lane < VEC_BYTES; lane++) {
+                    pc[i + lane] += lanes[lane] & 2;
+                }
+            }
+            return;
+        }
+        case OpcodeId::OP_1nnn:
+            for (size_t lane = 0; lane < stride; lane++) {
+                uint16_t mask = static_cast<uint16_t>(-(active[lane] & 1));
+                pc[lane] = (pc[lane] & ~mask) | (ins.nnn & mask);
+            }
+            return;
+        case OpcodeId::OP_Annn:
+            for (size_t lane = 0; lane < stride; lane++) {
+                uint16_t mask = static_cast<uint16_t>(-(active[lane] & 1));
+                index[lane] = (index[lane] & ~mask) | (ins.nnn & mask);
+            }
+            return;
+        case OpcodeId::OP_Fx1E:
+            for (size_t lane = 0; lane < stride; lane++) {
+                index[lane] += vx[lane] & active[lane];
+            }
+            return;
+        default:
+            break;
+    }
+
+    // Everything else touches per-lane memory, stack, display, keypad or RNG
+    for (size_t lane = 0; lane < m_Lanes; lane++) {
+        if (!active[lane]) {
+            continue;
+        }
+
+        uint64_t* display = m_Display.get() + lane * VIDEO_HEIGHT;
+        auto memory = [&](unsigned int address) -> uint8_t& {
+            return Row(m_Data.get(), address & (MEMORY_SIZE - 1))[lane];
+        };
+
+        switch (id) {
+            case OpcodeId::OP_00E0:
+                std::fill_n(display, VIDEO_HEIGHT, 0);
+                break;
+            case OpcodeId::OP_00EE:
+                sp[lane] = (sp[lane] - 1) & (STACK_LEVELS - 1);
+                pc[lane] = m_Stack[sp[lane] * m_Stride + lane];
+                break;
+            case OpcodeId::OP_2nnn:
+                m_Stack[sp[lane] * m_Stride + lane] = pc[lane];
+                sp[lane] = (sp[lane] + 1) & (STACK_LEVELS - 1);
+                pc[lane] = ins.nnn;
+                break;
+            case OpcodeId::OP_Bnnn:
+                pc[lane] = ins.nnn + Register(0)[lane];
+                break;
+            case OpcodeId::OP_Cxkk:
+                vx[lane] = m_RandGen[lane].NextByte() & ins.kk;
+                break;
+            case OpcodeId::OP_Dxyn: {
+                unsigned int xPos = vx[lane] % VIDEO_WIDTH;
+                unsigned int yPos = vy[lane] % VIDEO_HEIGHT;
+                unsigned int height = std::min<unsigned int>(ins.n, VIDEO_HEIGHT - yPos);
+
+                uint64_t collision = 0;
+                for (unsigned int row = 0; row < height; ++row) {
+                    uint64_t spriteRow = (uint64_t{memory(index[lane] + row)} << 56) >> xPos;
+                    collision |= display[yPos + row] & spriteRow;
+                    display[yPos + row] ^= spriteRow;
+                }
+                vf[lane] = collision != 0;
+                break;
+            }
+            case OpcodeId::OP_Ex9E:
+                if (Row(m_Keypad.get(), vx[lane] & 0xF)[lane]) {
+                    pc[lane] += 2;
+                }
+                break;
+            case OpcodeId::OP_ExA1:
+                if (!Row(m_Keypad.get(), vx[lane] & 0xF)[lane]) {
+                    pc[lane] += 2;
+                }
+                break;
+            case OpcodeId::OP_Fx0A: {
+                bool keyPress = false;
+                for (unsigned int key = 0; key < KEY_COUNT; key++) {
+                    if (Row(m_Keypad.get(), key)[lane]) {
+                        vx[lane] = key;
+                        keyPress = true;
+                        break;
+                    }
+                }
+                if (!keyPress) {
+                    pc[lane] -= 2;
+                }
+                break;
+            }
+            case OpcodeId::OP_Fx29:
+                index[lane] = FONTSET_START_ADDR + (vx[lane] & 0xF) * 5;
+                break;
+            case OpcodeId::OP_Fx33:
+                memory(index[lane]) = vx[lane] / 100;
+                memory(index[lane] + 1) = (vx[lane] / 10) % 10;
+                memory(index[lane] + 2) = vx[lane] % 10;
+                break;
+            case OpcodeId::OP_Fx55:
+                for (unsigned int i = 0; i <= ins.x; i++) {
+                    memory(index[lane] + i) = Register(i)[lane];
+                }
+                break;
+            case OpcodeId::OP_Fx65:
+                for (unsigned int i = 0; i <= ins.x; i++) {
+                    Register(i)[lane] = memory(index[lane] + i);
+                }
+                break;
+            default: {
+                char message[32];
+                snprintf(message, sizeof(message), "Unknown opcode 0x%04X", ins.opcode);
+                throw std::runtime_error(message);
+            }
+        }
+    }
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,437 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+#include "display.hpp"
+#include "jit.hpp"
+#include <getopt.h>
+
+// Heap allocations made so far by the process. Once warmed up, running a ROM
+// or forking a machine must make none; a benchmark that does fails.
+uint64_t g_Allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    g_Allocations++;
+    if (void* p = std::malloc(size != 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+using Clock = std::chrono::steady_clock;
+
+// Standard deviations of measurement noise --compare tolerates on top of --threshold
+constexpr double NOISE_SIGMAS = 3.0;
+using Nanoseconds = std::chrono::duration<double, std::nano>;
+
+struct Workload {
+    const char* name;
+    std::vector<uint16_t> program;
+};
+
+struct Statistics {
+    double median;
+    double mean;
+    double stddev;
+    double min;
+};
+
+struct Result {
+    std::string name;
+    const char* unit;
+    Statistics nsPerOp;
+    int repetitions;
+};
+
+// Synthetic ROMs, each an endless loop hammering one part of the core
+const std::vector<Workload> WORKLOADS = {
+    { "alu", {
+        0x6001, 0x6102, 0x6203, 0x6304,
+        0x8014, 0x8125, 0x8236, 0x8317, 0x830E, 0x8231, 0x8012, 0x8123,
+        0x8344, 0x8025, 0x7005, 0x7103, 0x1208,
+    } },
+    { "draw", {
+        0x6000, 0x6100, 0xA050,
+        0xD015, 0x7008, 0x7103, 0xD015, 0x7008, 0x7103,
+        0xD01F, 0x7009, 0x7105, 0xD01F, 0x7009, 0x7105, 0x1206,
+    } },
+    { "memory", {
+        0xA400, 0x6A42,
+        0xFF55, 0xFF65, 0xFA33, 0x7A01, 0xF765, 0xF355, 0x1204,
+    } },
+    { "branch", {
+        0x6000, 0x6100,
+        0x7001, 0x3000, 0x7101, 0x4110, 0x6100, 0x5010,
+        0x7201, 0x9010, 0x7301, 0x3380, 0x7401, 0x1204,
+    } },
+};
+
+const Chip8Emulator::ExecutionMode MODES[] = {
+    Chip8Emulator::ExecutionMode::Interpreter,
+    Chip8Emulator::ExecutionMode::BlockCache,
+#if CHIP8_JIT_SUPPORTED
+    Chip8Emulator::ExecutionMode::Jit,
+#endif
+};
+
+const char* ModeName(Chip8Emulator::ExecutionMode mode);
+Statistics Summarize(std::vector<double> samples);
+Result BenchmarkCore(const Workload& workload, Chip8Emulator::ExecutionMode mode, uint64_t cycles, int cyclesPerFrame, int warmup, int repetitions);
+Result BenchmarkPresentation(uint64_t frames, int warmup, int repetitions);
+Result BenchmarkFork(uint64_t forks, int cyclesPerFrame, int warmup, int repetitions);
+void CheckAllocations(const std::string& name, uint64_t allocations);
+void WriteJson(std::ostream& out, const std::vector<Result>& results);
+std::map<std::string, Statistics> ReadBaseline(const char* filename);
+
+int main(int argc, char* argv[])
+{
+    // Arguments - Default Values
+    uint64_t cycles = 2000000;
+    int cyclesPerFrame = 10;
+    int warmup = 2;
+    int repetitions = 10;
+    double threshold = 10.0;
+    std::string filter;
+    const char* jsonFilename = nullptr;
+    const char* baselineFilename = nullptr;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"cycles", required_argument, 0, 'c'},
+        {"cycles-per-frame", required_argument, 0, 'p'},
+        {"warmup", required_argument, 0, 'w'},
+        {"repetitions", required_argument, 0, 'n'},
+        {"filter", required_argument, 0, 'f'},
+        {"json", required_argument, 0, 'j'},
+        {"compare", required_argument, 0, 'b'},
+        {"threshold", required_argument, 0, 't'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    while ((opt = getopt_long(argc, argv, "c:p:w:n:f:j:b:t:", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'c':
+                cycles = std::stoull(optarg);
+                break;
+            case 'p':
+                cyclesPerFrame = std::stoi(optarg);
+                break;
+            case 'w':
+                warmup = std::stoi(optarg);
+                break;
+            case 'n':
+                repetitions = std::stoi(optarg);
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'j':
+                jsonFilename = optarg;
+                break;
+            case 'b':
+                baselineFilename = optarg;
+                break;
+            case 't':
+                threshold = std::stod(optarg);
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0] << " [options]\n"
+                          << "Options:\n"
+                          << "  --cycles <n>             CPU cycles per repetition (default: 2000000)\n"
+                          << "  --cycles-per-frame <n>   CPU cycles between timer ticks (default: 10)\n"
+                          << "  --warmup <n>             Untimed repetitions (default: 2)\n"
+                          << "  --repetitions <n>        Timed repetitions (default: 10)\n"
+                          << "  --filter <text>          Only run benchmarks whose name contains text\n"
+                          << "  --json <file>            Write results as JSON (default: stdout)\n"
+                          << "  --compare <file>         Fail if slower than this JSON baseline\n"
+                          << "  --threshold <percent>    Allowed slowdown for --compare beyond measured noise (default: 10)\n";
+                return 1;
+        }
+    }
+
+    if (cycles == 0 || cyclesPerFrame <= 0 || repetitions <= 0 || warmup < 0) {
+        std::cerr << "--cycles, --cycles-per-frame and --repetitions must be positive\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    try {
+        for (const auto& workload : WORKLOADS) {
+            for (auto mode : MODES) {
+                std::string name = std::string(workload.name) + "/" + ModeName(mode);
+                if (name.find(filter) != std::string::npos) {
+                    results.push_back(BenchmarkCore(workload, mode, cycles, cyclesPerFrame, warmup, repetitions));
+                }
+            }
+        }
+
+        if (std::string("present/expand").find(filter) != std::string::npos) {
+            results.push_back(BenchmarkPresentation(cycles / cyclesPerFrame, warmup, repetitions));
+        }
+
+        if (std::string("fork/copy").find(filter) != std::string::npos) {
+            results.push_back(BenchmarkFork(std::max<uint64_t>(cycles / 1000, 1), cyclesPerFrame, warmup, repetitions));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << "\n";
+        return 1;
+    }
+
+    for (const auto& result : results) {
+        std::cerr << result.name << ": " << result.nsPerOp.median << " ns/" << result.unit
+                  << " (+/- " << result.nsPerOp.stddev << ")\n";
+    }
+
+    if (jsonFilename != nullptr) {
+        std::ofstream file(jsonFilename);
+        WriteJson(file, results);
+    } else {
+        WriteJson(std::cout, results);
+    }
+
+    if (baselineFilename == nullptr) {
+        return 0;
+    }
+
+    // A benchmark regresses when its median is slower than the baseline's by
+    // more than threshold percent plus the run-to-run noise: NOISE_SIGMAS
+    // standard deviations of the difference, from both runs' spreads across
+    // repetitions. Comparing a build against its own baseline then passes.
+    std::map<std::string, Statistics> baseline;
+    try {
+        baseline = ReadBaseline(baselineFilename);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to read baseline: " << e.what() << "\n";
+        return 1;
+    }
+
+    int regressions = 0;
+    for (const auto& result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end()) {
+            continue;
+        }
+
+        const Statistics& before = it->second;
+        double change = (result.nsPerOp.median / before.median - 1.0) * 100.0;
+        double noise = NOISE_SIGMAS * std::hypot(result.nsPerOp.stddev, before.stddev) / before.median * 100.0;
+        if (change > threshold + noise) {
+            std::cerr << "REGRESSION " << result.name << ": " << before.median << " -> "
+                      << result.nsPerOp.median << " ns/" << result.unit << " (+" << change << "%, allowed +"
+                      << threshold + noise << "%)\n";
+            regressions++;
+        }
+    }
+
+    return regressions == 0 ? 0 : 1;
+}
+
+const char* ModeName(Chip8Emulator::ExecutionMode mode)
+{
+    switch (mode) {
+        case Chip8Emulator::ExecutionMode::BlockCache: return "block";
+        case Chip8Emulator::ExecutionMode::Jit: return "jit";
+        default: return "interpreter";
+    }
+}
+
+Statistics Summarize(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    double mean = sum / samples.size();
+
+    double variance = 0.0;
+    for (double sample : samples) {
+        variance += (sample - mean) * (sample - mean);
+    }
+
+    size_t middle = samples.size() / 2;
+    double median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+
+    return { median, mean, std::sqrt(variance / samples.size()), samples.front() };
+}
+
+// ns per emulated instruction, running the ROM the way the frontends do:
+// cyclesPerFrame cycles, then a timer tick
+Result BenchmarkCore(const Workload& workload, Chip8Emulator::ExecutionMode mode, uint64_t cycles, int cyclesPerFrame, int warmup, int repetitions)
+{
+    std::vector<uint8_t> rom;
+    for (uint16_t opcode : workload.program) {
+        rom.push_back(opcode >> 8u);
+        rom.push_back(opcode & 0xFFu);
+    }
+
+    Chip8Emulator::Chip8 chip8(0);
+    chip8.SetExecutionMode(mode);
+    chip8.LoadROM(rom.data(), rom.size());
+
+    uint64_t frames = cycles / cyclesPerFrame;
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    uint64_t allocations = 0;
+
+    for (int repetition = 0; repetition < warmup + repetitions; repetition++) {
+        uint64_t allocated = g_Allocations;
+        auto start = Clock::now();
+        for (uint64_t frame = 0; frame < frames; frame++) {
+            chip8.Run(cyclesPerFrame);
+            chip8.DecrementTimers();
+        }
+        double elapsed = std::chrono::duration_cast<Nanoseconds>(Clock::now() - start).count();
+
+        if (repetition >= warmup) {
+            samples.push_back(elapsed / (frames * cyclesPerFrame));
+            allocations += g_Allocations - allocated;
+        }
+    }
+
+    std::string name = std::string(workload.name) + "/" + ModeName(mode);
+    CheckAllocations(name, allocations);
+    return { name, "instruction", Summarize(samples), repetitions };
+}
+
+// ns per fork of a running machine into an existing instance, as tree
+// searches do before exploring each branch
+Result BenchmarkFork(uint64_t forks, int cyclesPerFrame, int warmup, int repetitions)
+{
+    std::vector<uint8_t> rom;
+    for (uint16_t opcode : WORKLOADS[0].program) {
+        rom.push_back(opcode >> 8u);
+        rom.push_back(opcode & 0xFFu);
+    }
+
+    Chip8Emulator::Chip8 root(0);
+    root.LoadROM(rom.data(), rom.size());
+    Chip8Emulator::Chip8 fork(root);
+
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    uint64_t allocations = 0;
+
+    for (int repetition = 0; repetition < warmup + repetitions; repetition++) {
+        uint64_t allocated = g_Allocations;
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < forks; i++) {
+            fork = root;
+            fork.Run(1);
+        }
+        double elapsed = std::chrono::duration_cast<Nanoseconds>(Clock::now() - start).count();
+
+        if (repetition >= warmup) {
+            samples.push_back(elapsed / forks);
+            allocations += g_Allocations - allocated;
+        }
+        root.Run(cyclesPerFrame);
+    }
+
+    CheckAllocations("fork/copy", allocations);
+    return { "fork/copy", "fork", Summarize(samples), repetitions };
+}
+
+void CheckAllocations(const std::string& name, uint64_t allocations)
+{
+    if (allocations != 0) {
+        throw std::runtime_error(name + " allocated " + std::to_string(allocations) + " times after warmup");
+    }
+}
+
+// ns per frame for a full packed-row to RGBA conversion; Screen::Update2DTexture
+// only pays this for the dirty rows
+Result BenchmarkPresentation(uint64_t frames, int warmup, int repetitions)
+{
+    uint64_t rows[Chip8Emulator::VIDEO_HEIGHT];
+    for (unsigned int y = 0; y < Chip8Emulator::VIDEO_HEIGHT; y++) {
+        rows[y] = 0x9E3779B97F4A7C15ULL * (y + 1);
+    }
+
+    std::vector<uint32_t> pixels(Chip8Emulator::VIDEO_WIDTH * Chip8Emulator::VIDEO_HEIGHT);
+    std::vector<double> samples;
+    volatile uint8_t sink = 0;
+
+    for (int repetition = 0; repetition < warmup + repetitions; repetition++) {
+        auto start = Clock::now();
+        for (uint64_t frame = 0; frame < frames; frame++) {
+            rows[frame % Chip8Emulator::VIDEO_HEIGHT] ^= frame;
+            Chip8Emulator::ExpandDisplayRows(rows, 0, Chip8Emulator::VIDEO_HEIGHT, Chip8Emulator::VIDEO_WIDTH,
+                                             pixels.data(), 0xFFFFFFFF, 0xFF000000);
+            sink = sink + static_cast<uint8_t>(pixels[frame % pixels.size()]);
+        }
+        double elapsed = std::chrono::duration_cast<Nanoseconds>(Clock::now() - start).count();
+
+        if (repetition >= warmup) {
+            samples.push_back(elapsed / frames);
+        }
+    }
+
+    return { "present/expand", "frame", Summarize(samples), repetitions };
+}
+
+void WriteJson(std::ostream& out, const std::vector<Result>& results)
+{
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\""
+            << ", \"unit\": \"" << result.unit << "\""
+            << ", \"ns_per_op\": " << result.nsPerOp.median
+            << ", \"ops_per_second\": " << static_cast<uint64_t>(1e9 / result.nsPerOp.median)
+            << ", \"mean_ns\": " << result.nsPerOp.mean
+            << ", \"stddev_ns\": " << result.nsPerOp.stddev
+            << ", \"min_ns\": " << result.nsPerOp.min
+            << ", \"repetitions\": " << result.repetitions << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+// Reads name -> ns_per_op and stddev_ns from a file written by WriteJson;
+// baselines without stddev_ns count as noise-free
+std::map<std::string, Statistics> ReadBaseline(const char* filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("cannot open file");
+    }
+
+    std::map<std::string, Statistics> baseline;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t name = line.find("\"name\": \"");
+        size_t value = line.find("\"ns_per_op\": ");
+        if (name == std::string::npos || value == std::string::npos) {
+            continue;
+        }
+
+        Statistics statistics{};
+        statistics.median = std::stod(line.substr(value + 13));
+        size_t stddev = line.find("\"stddev_ns\": ");
+        if (stddev != std::string::npos) {
+            statistics.stddev = std::stod(line.substr(stddev + 13));
+        }
+
+        name += 9;
+        baseline[line.substr(name, line.find('"', name) - name)] = statistics;
+    }
+
+    return baseline;
+}
@@ -0,0 +1,150 @@
+#include "block_cache.hpp"
+#include <algorithm>
+
+namespace Chip8Emulator{
+
+bool EndsBlock(OpcodeId id) {
+    switch (id) {
+        case OpcodeId::Unknown:
+        case OpcodeId::OP_00EE:
+        case OpcodeId::OP_1nnn:
+        case OpcodeId::OP_2nnn:
+        case OpcodeId::OP_3xkk:
+        case OpcodeId::OP_4xkk:
+        case OpcodeId::OP_5xy0:
+        case OpcodeId::OP_9xy0:
+        case OpcodeId::OP_Bnnn:
+        case OpcodeId::OP_Ex9E:
+        case OpcodeId::OP_ExA1:
+        case OpcodeId::OP_Fx0A:
+        case OpcodeId::OP_Fx33:
+        case OpcodeId::OP_Fx55:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool WritesMemory(OpcodeId id) {
+    return id == OpcodeId::OP_Fx33 || id == OpcodeId::OP_Fx55;
+}
+
+void BlockCache::Build(const Chip8& chip8, uint16_t pc, DecodedBlock& block) {
+    block.start = pc;
+    block.count = 0;
+    block.valid = true;
+    block.stores = 0;
+
+    uint16_t address = pc;
+    while (block.count < MAX_BLOCK_LENGTH && address + 1u < MEMORY_SIZE) {
+        uint16_t opcode = (chip8.m_Data[address] << 8u) | chip8.m_Data[address + 1];
+        OpcodeId id = DecodeOpcodeId(opcode);
+        if (WritesMemory(id)) {
+            block.stores |= 1u << block.count;
+        }
+        block.instructions[block.count++] = Chip8::Decode(opcode, Variant::Chip8, chip8.m_QuirkProfile);
+        m_CodeBytes.Set(address);
+        m_CodeBytes.Set(address + 1);
+        address += 2;
+
+        if (EndsBlock(id) && !WritesMemory(id)) {
+            break;
+        }
+    }
+
+    block.end = address;
+}
+
+const DecodedBlock* BlockCache::Lookup(const Chip8& chip8, uint16_t pc) {
+    if (pc + 1u >= MEMORY_SIZE) {
+        return nullptr;
+    }
+
+    uint16_t index = m_BlockIndex[pc];
+    if (index == 0) {
+        m_Blocks.emplace_back();
+        index = static_cast<uint16_t>(m_Blocks.size());
+        m_BlockIndex[pc] = index;
+    }
+
+    DecodedBlock& block = m_Blocks[index - 1];
+    if (!block.valid) {
+        Build(chip8, pc, block);
+    }
+
+    return &block;
+}
+
+// Runs count instructions of a block containing stores, stopping after a
+// store that invalidated the block itself; returns the number run
+uint32_t BlockCache::ExecuteWithStores(Chip8& chip8, const DecodedBlock& block, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        block.instructions[i].handler(chip8, block.instructions[i]);
+
+        // The rest of the block may be stale
+        if ((block.stores >> i & 1) && !block.valid) {
+            chip8.m_ProgramCounter = block.start + 2 * (i + 1);
+            return i + 1;
+        }
+    }
+    return count;
+}
+
+void BlockCache::Execute(Chip8& chip8, uint32_t cycles) {
+    while (cycles > 0) {
+        const DecodedBlock* block = Lookup(chip8, chip8.m_ProgramCounter);
+        if (block == nullptr) {
+            chip8.Cycle();
+            cycles--;
+            continue;
+        }
+
+        // Only the final instruction reads or changes the program counter, so it
+        // can be advanced past the executed part of the block up front.
+        uint32_t count = std::min<uint32_t>(block->count, cycles);
+        const Instruction* instructions = block->instructions;
+        chip8.m_ProgramCounter = block->start + 2 * count;
+
+        if (block->stores == 0) {
+            for (uint32_t i = 0; i < count; i++) {
+                instructions[i].handler(chip8, instructions[i]);
+            }
+        } else {
+            count = ExecuteWithStores(chip8, *block, count);
+        }
+
+        cycles -= count;
+    }
+}
+
+void BlockCache::Invalidate(uint16_t address, uint16_t length) {
+    ForEachWrittenRange(address, length, [this](unsigned int first, unsigned int last) { InvalidateRange(first, last); });
+}
+
+void BlockCache::InvalidateRange(unsigned int address, unsigned int last) {
+    if (!m_CodeBytes.Touches(address, last)) {
+        return;
+    }
+
+    // A block covering the write must start at most MAX_BLOCK_LENGTH instructions before it
+    unsigned int first = address >= 2 * MAX_BLOCK_LENGTH ? address - 2 * MAX_BLOCK_LENGTH + 1 : 0;
+    for (unsigned int pc = first; pc <= last; pc++) {
+        uint16_t index = m_BlockIndex[pc];
+        if (index == 0) {
+            continue;
+        }
+
+        DecodedBlock& block = m_Blocks[index - 1];
+        if (block.valid && block.start <= last && block.end > address) {
+            block.valid = false;
+        }
+    }
+}
+
+void BlockCache::Flush() {
+    m_BlockIndex.fill(0);
+    m_Blocks.clear();
+    m_CodeBytes.Reset();
+}
+
+} // namespace Chip8Emulator
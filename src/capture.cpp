@@ -0,0 +1,432 @@
+#include "capture.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include "display.hpp"
+
+namespace Chip8Emulator{
+
+namespace {
+
+constexpr unsigned int GIF_COLOURS = 16;
+constexpr unsigned int GIF_MIN_CODE_SIZE = 4; // log2(GIF_COLOURS)
+constexpr unsigned int GIF_MAX_CODES = 4096;
+
+// Browsers play delays under 2/100 s at 1/10 s, so faster changes are merged
+constexpr uint64_t GIF_MIN_DELAY = 2;
+
+// Frame delays are in hundredths of a second; ticks are 1/60 s
+uint64_t Centiseconds(uint64_t tick) {
+    return tick * 100 / TIMER_FREQUENCY;
+}
+
+void Put16(std::ostream& out, unsigned int value) {
+    out.put(static_cast<char>(value & 0xFF));
+    out.put(static_cast<char>(value >> 8));
+}
+
+// LSB-first variable-width codes, packed into the 255-byte sub-blocks GIF uses
+class GifBitWriter {
+private:
+    std::ostream& m_Out;
+    uint32_t m_Bits = 0;
+    unsigned int m_Count = 0;
+    char m_Block[255];
+    unsigned int m_Length = 0;
+
+    void PutByte(uint8_t byte) {
+        m_Block[m_Length++] = static_cast<char>(byte);
+        if (m_Length == sizeof(m_Block)) {
+            FlushBlock();
+        }
+    }
+
+    void FlushBlock() {
+        if (m_Length > 0) {
+            m_Out.put(static_cast<char>(m_Length));
+            m_Out.write(m_Block, m_Length);
+            m_Length = 0;
+        }
+    }
+
+public:
+    explicit GifBitWriter(std::ostream& out) : m_Out(out) {}
+
+    void Write(unsigned int code, unsigned int size) {
+        m_Bits |= code << m_Count;
+        m_Count += size;
+        while (m_Count >= 8) {
+            PutByte(static_cast<uint8_t>(m_Bits));
+            m_Bits >>= 8;
+            m_Count -= 8;
+        }
+    }
+
+    void Finish() {
+        if (m_Count > 0) {
+            PutByte(static_cast<uint8_t>(m_Bits));
+        }
+        FlushBlock();
+        m_Out.put(0); // Block terminator
+    }
+};
+
+} // namespace
+
+bool ParseCaptureFormat(const std::string& name, CaptureFormat& format) {
+    if (name == "raw") {
+        format = CaptureFormat::Raw;
+    } else if (name == "ppm") {
+        format = CaptureFormat::Ppm;
+    } else if (name == "gif") {
+        format = CaptureFormat::Gif;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Runs on the capture thread only
+class FrameEncoder {
+public:
+    FrameEncoder(const std::string& path, CaptureFormat format, Variant variant, unsigned int scale)
+    : m_Path(path),
+      m_Format(format),
+      m_Width((variant == Variant::Chip8 ? VIDEO_WIDTH : HIRES_WIDTH) * scale),
+      m_Height((variant == Variant::Chip8 ? VIDEO_HEIGHT : HIRES_HEIGHT) * scale),
+      m_Canvas(m_Width * m_Height),
+      m_Shown(m_Width * m_Height),
+      m_Pending(m_Width * m_Height)
+    {
+        if (m_Format == CaptureFormat::Ppm) {
+            return;
+        }
+
+        m_File.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_File.is_open()) {
+            throw std::runtime_error("Failed to open capture file " + path + ".");
+        }
+        if (m_Format == CaptureFormat::Gif) {
+            WriteGifHeader();
+        }
+    }
+
+    void Encode(const Frame& frame, uint64_t tick) {
+        switch (m_Format) {
+            case CaptureFormat::Raw:
+                WriteRaw(frame);
+                break;
+            case CaptureFormat::Ppm:
+                Render(frame);
+                WritePpm();
+                break;
+            case CaptureFormat::Gif:
+                Render(frame);
+                AddGifFrame(tick);
+                break;
+        }
+        m_Frames++;
+    }
+
+    // endTick is the tick after the last captured one
+    void Finish(uint64_t endTick) {
+        if (m_Format == CaptureFormat::Gif) {
+            if (m_HasPending) {
+                WriteGifFrame(std::max(Centiseconds(endTick) - Centiseconds(m_PendingTick), GIF_MIN_DELAY));
+            }
+            m_File.put(0x3B); // Trailer
+        }
+        if (m_File.is_open() && !m_File.flush()) {
+            throw std::runtime_error("Failed to write capture file " + m_Path + ".");
+        }
+    }
+
+private:
+    std::string m_Path;
+    CaptureFormat m_Format;
+    unsigned int m_Width;
+    unsigned int m_Height;
+    std::ofstream m_File;
+    uint64_t m_Frames = 0;
+
+    std::vector<uint8_t> m_Canvas;  // Palette index per pixel of the newest frame
+    std::vector<uint8_t> m_Shown;   // What the GIF shows after the frames written so far
+    std::vector<uint8_t> m_Pending; // The frame waiting for its delay to be known
+    bool m_HasPending = false;
+    bool m_Started = false;         // The first GIF frame covers the whole canvas
+    uint64_t m_PendingTick = 0;
+
+    std::vector<uint8_t> m_Rect;
+    std::vector<uint16_t> m_Codes = std::vector<uint16_t>(GIF_MAX_CODES * GIF_COLOURS);
+
+    void WriteRaw(const Frame& frame) {
+        const unsigned int words = frame.height * frame.width / 64;
+        for (unsigned int plane = 0; plane < frame.planeCount; plane++) {
+            for (unsigned int i = 0; i < words; i++) {
+                for (int shift = 56; shift >= 0; shift -= 8) {
+                    m_File.put(static_cast<char>(frame.planes[plane][i] >> shift));
+                }
+            }
+        }
+        if (!m_File) {
+            throw std::runtime_error("Failed to write capture file " + m_Path + ".");
+        }
+    }
+
+    // Palette indices of frame, scaled to fill the canvas
+    void Render(const Frame& frame) {
+        const unsigned int rowWords = frame.width / 64;
+        for (unsigned int y = 0; y < m_Height; y++) {
+            const unsigned int sourceY = y * frame.height / m_Height;
+            uint8_t* out = m_Canvas.data() + y * m_Width;
+            for (unsigned int x = 0; x < m_Width; x++) {
+                const unsigned int sourceX = x * frame.width / m_Width;
+                const unsigned int word = sourceY * rowWords + sourceX / 64;
+                unsigned int index = 0;
+                for (unsigned int plane = 0; plane < frame.planeCount; plane++) {
+                    // Through a pointer: GCC's sanitizer build misreads the 2-D subscript as out of bounds
+                    const uint64_t* words = frame.planes[plane];
+                    index |= static_cast<unsigned int>((words[word] >> (63 - sourceX % 64)) & 1) << plane;
+                }
+                out[x] = static_cast<uint8_t>(index);
+            }
+        }
+    }
+
+    void WritePpm() {
+        char name[32];
+        std::snprintf(name, sizeof(name), "-%06llu.ppm", static_cast<unsigned long long>(m_Frames));
+        std::ofstream file(m_Path + name, std::ios::binary | std::ios::trunc);
+
+        file << "P6\n" << m_Width << " " << m_Height << "\n255\n";
+        std::vector<char> rgb(m_Canvas.size() * 3);
+        for (size_t i = 0; i < m_Canvas.size(); i++) {
+            uint32_t colour = DISPLAY_PALETTE[m_Canvas[i]];
+            rgb[3 * i] = static_cast<char>(colour);
+            rgb[3 * i + 1] = static_cast<char>(colour >> 8);
+            rgb[3 * i + 2] = static_cast<char>(colour >> 16);
+        }
+        file.write(rgb.data(), rgb.size());
+
+        if (!file.flush()) {
+            throw std::runtime_error("Failed to write capture file " + m_Path + name + ".");
+        }
+    }
+
+    void WriteGifHeader() {
+        m_File.write("GIF89a", 6);
+        Put16(m_File, m_Width);
+        Put16(m_File, m_Height);
+        m_File.put(static_cast<char>(0xF0 | (GIF_MIN_CODE_SIZE - 1))); // Global colour table of GIF_COLOURS
+        m_File.put(0);                                                 // Background colour
+        m_File.put(0);                                                 // Square pixels
+        for (unsigned int i = 0; i < GIF_COLOURS; i++) {
+            uint32_t colour = DISPLAY_PALETTE[i];
+            m_File.put(static_cast<char>(colour));
+            m_File.put(static_cast<char>(colour >> 8));
+            m_File.put(static_cast<char>(colour >> 16));
+        }
+
+        // Loop forever
+        m_File.write("\x21\xFF\x0BNETSCAPE2.0\x03\x01", 16);
+        Put16(m_File, 0);
+        m_File.put(0);
+    }
+
+    // A frame is only written once the next different one arrives, since its
+    // delay is not known before then
+    void AddGifFrame(uint64_t tick) {
+        if (m_HasPending && m_Canvas == m_Pending) {
+            return;
+        }
+        if (m_HasPending && Centiseconds(tick) - Centiseconds(m_PendingTick) >= GIF_MIN_DELAY) {
+            WriteGifFrame(Centiseconds(tick) - Centiseconds(m_PendingTick));
+        }
+        if (!m_HasPending) {
+            m_PendingTick = tick;
+            m_HasPending = true;
+        }
+        m_Pending.swap(m_Canvas);
+    }
+
+    // Writes the pending frame as the rectangle in which it differs from m_Shown
+    void WriteGifFrame(uint64_t delay) {
+        unsigned int left = 0, top = 0, right = m_Width, bottom = m_Height;
+        if (m_Started) {
+            left = m_Width, top = m_Height, right = 0, bottom = 0;
+            for (unsigned int y = 0; y < m_Height; y++) {
+                for (unsigned int x = 0; x < m_Width; x++) {
+                    if (m_Pending[y * m_Width + x] != m_Shown[y * m_Width + x]) {
+                        left = std::min(left, x);
+                        right = std::max(right, x + 1);
+                        top = std::min(top, y);
+                        bottom = std::max(bottom, y + 1);
+                    }
+                }
+            }
+            // Changed and changed back: one unchanged pixel still carries the delay
+            if (right == 0) {
+                left = top = 0;
+                right = bottom = 1;
+            }
+        }
+
+        // Graphic control extension: no disposal, no transparency
+        m_File.write("\x21\xF9\x04\x04", 4);
+        Put16(m_File, static_cast<unsigned int>(std::min<uint64_t>(delay, 0xFFFF)));
+        m_File.put(0);
+        m_File.put(0);
+
+        // Image descriptor, without a local colour table
+        m_File.put(0x2C);
+        Put16(m_File, left);
+        Put16(m_File, top);
+        Put16(m_File, right - left);
+        Put16(m_File, bottom - top);
+        m_File.put(0);
+
+        m_Rect.clear();
+        for (unsigned int y = top; y < bottom; y++) {
+            m_Rect.insert(m_Rect.end(), m_Pending.begin() + y * m_Width + left, m_Pending.begin() + y * m_Width + right);
+        }
+        WriteLzw(m_Rect);
+
+        if (!m_File) {
+            throw std::runtime_error("Failed to write capture file " + m_Path + ".");
+        }
+
+        m_Shown = m_Pending;
+        m_Started = true;
+        m_HasPending = false;
+    }
+
+    // m_Codes[code * GIF_COLOURS + index] is the code for string code + index, or 0
+    void WriteLzw(const std::vector<uint8_t>& pixels) {
+        const unsigned int clear = 1u << GIF_MIN_CODE_SIZE;
+        unsigned int codeSize = GIF_MIN_CODE_SIZE + 1;
+        unsigned int maxCode = clear + 1;
+        std::fill(m_Codes.begin(), m_Codes.end(), 0);
+
+        m_File.put(static_cast<char>(GIF_MIN_CODE_SIZE));
+        GifBitWriter bits(m_File);
+        bits.Write(clear, codeSize);
+
+        unsigned int current = pixels[0];
+        for (size_t i = 1; i < pixels.size(); i++) {
+            uint16_t& next = m_Codes[current * GIF_COLOURS + pixels[i]];
+            if (next != 0) {
+                current = next;
+                continue;
+            }
+
+            bits.Write(current, codeSize);
+            next = static_cast<uint16_t>(++maxCode);
+            if (maxCode >= (1u << codeSize)) {
+                codeSize++;
+            }
+            if (maxCode == GIF_MAX_CODES - 1) {
+                bits.Write(clear, codeSize);
+                std::fill(m_Codes.begin(), m_Codes.end(), 0);
+                codeSize = GIF_MIN_CODE_SIZE + 1;
+                maxCode = clear + 1;
+            }
+            current = pixels[i];
+        }
+
+        // The decoder adds one more string on reading the last code and may
+        // widen its codes for it
+        bits.Write(current, codeSize);
+        if (maxCode + 1 >= (1u << codeSize) && codeSize < 12) {
+            codeSize++;
+        }
+        bits.Write(clear, codeSize);
+        bits.Write(clear + 1, GIF_MIN_CODE_SIZE + 1);
+        bits.Finish();
+    }
+};
+
+FrameCapture::FrameCapture(const std::string& path, CaptureFormat format, Variant variant, unsigned int scale,
+                           uint32_t ringFrames)
+: m_Encoder(std::make_unique<FrameEncoder>(path, format, variant, std::max(scale, 1u))),
+  m_Slots(std::max(ringFrames, 1u))
+{
+    m_Thread = std::thread(&FrameCapture::Main, this);
+}
+
+FrameCapture::~FrameCapture() {
+    m_Stopping.store(true, std::memory_order_release);
+    m_Signal.fetch_add(1, std::memory_order_release);
+    m_Signal.notify_one();
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+}
+
+bool FrameCapture::Capture(const Chip8& chip8, bool wait) {
+    const uint64_t tick = m_Tick++;
+    const uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+    uint64_t head = m_Head.load(std::memory_order_acquire);
+    while (tail - head == m_Slots.size()) {
+        if (!wait || m_Failed.load(std::memory_order_acquire)) {
+            m_Dropped++;
+            return false;
+        }
+        m_Head.wait(head, std::memory_order_acquire);
+        head = m_Head.load(std::memory_order_acquire);
+    }
+
+    Slot& slot = m_Slots[tail % m_Slots.size()];
+    CopyDisplay(chip8, slot.frame);
+    slot.tick = tick;
+    m_Tail.store(tail + 1, std::memory_order_release);
+
+    m_Signal.fetch_add(1, std::memory_order_release);
+    m_Signal.notify_one();
+    return true;
+}
+
+void FrameCapture::Stop() {
+    m_Stopping.store(true, std::memory_order_release);
+    m_Signal.fetch_add(1, std::memory_order_release);
+    m_Signal.notify_one();
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+
+    if (m_Error) {
+        std::rethrow_exception(std::exchange(m_Error, nullptr));
+    }
+}
+
+void FrameCapture::Main() {
+    uint64_t head = m_Head.load(std::memory_order_relaxed);
+    try {
+        while (true) {
+            const uint32_t signal = m_Signal.load(std::memory_order_acquire);
+            if (head == m_Tail.load(std::memory_order_acquire)) {
+                if (m_Stopping.load(std::memory_order_acquire)) {
+                    break;
+                }
+                m_Signal.wait(signal, std::memory_order_acquire);
+                continue;
+            }
+
+            const Slot& slot = m_Slots[head % m_Slots.size()];
+            m_Encoder->Encode(slot.frame, slot.tick);
+            m_Head.store(++head, std::memory_order_release);
+            m_Head.notify_one();
+        }
+        m_Encoder->Finish(m_Tick);
+    } catch (...) {
+        m_Error = std::current_exception();
+        // Frees a producer waiting on a full ring; later frames are dropped
+        m_Failed.store(true, std::memory_order_release);
+        m_Head.store(head + 1, std::memory_order_release);
+        m_Head.notify_one();
+    }
+}
+
+} // namespace Chip8Emulator
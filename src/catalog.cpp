@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rom_catalog.hpp"
+#include <getopt.h>
+
+namespace fs = std::filesystem;
+
+// Extensions picked up when scanning a directory; named files are always added
+const char* const ROM_EXTENSIONS[] = { ".ch8", ".c8", ".sc8", ".xo8" };
+
+bool IsRomFile(const fs::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return std::find(std::begin(ROM_EXTENSIONS), std::end(ROM_EXTENSIONS), extension) != std::end(ROM_EXTENSIONS);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* catalogFilename = "chip8-catalog.tsv";
+    bool list = false;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"catalog", required_argument, 0, 'c'},
+        {"list", no_argument, 0, 'l'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    while ((opt = getopt_long(argc, argv, "c:l", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'c':
+                catalogFilename = optarg;
+                break;
+            case 'l':
+                list = true;
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0] << " [options] <ROM file or directory>...\n"
+                          << "Options:\n"
+                          << "  --catalog <file>  Catalog to update (default: chip8-catalog.tsv)\n"
+                          << "  --list            Print every entry after updating\n";
+                return 1;
+        }
+    }
+
+    Chip8Emulator::RomCatalog catalog;
+    try {
+        catalog.Load(catalogFilename);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to load catalog: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> roms;
+    for (int i = optind; i < argc; i++) {
+        std::error_code error;
+        if (!fs::is_directory(argv[i], error)) {
+            roms.push_back(argv[i]);
+            continue;
+        }
+
+        for (const auto& entry : fs::recursive_directory_iterator(argv[i], error)) {
+            if (entry.is_regular_file() && IsRomFile(entry.path())) {
+                roms.push_back(entry.path().string());
+            }
+        }
+    }
+
+    size_t failed = 0;
+    for (const auto& rom : roms) {
+        try {
+            catalog.Update(rom);
+        } catch (const std::exception& e) {
+            std::cerr << rom << ": " << e.what() << "\n";
+            failed++;
+        }
+    }
+    size_t pruned = catalog.Prune();
+
+    try {
+        catalog.Save(catalogFilename);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to save catalog: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (list) {
+        std::vector<std::string> paths;
+        for (const auto& entry : catalog.GetEntries()) {
+            paths.push_back(entry.first);
+        }
+        std::sort(paths.begin(), paths.end());
+
+        for (const auto& path : paths) {
+            const auto& info = catalog.GetEntries().at(path);
+            std::cout << Chip8Emulator::VariantName(info.variant) << "\t"
+                      << Chip8Emulator::QuirkProfileName(info.quirks) << "\t"
+                      << info.clockHz << "\t" << info.title << "\t" << path << "\n";
+        }
+    }
+
+    std::cout << "roms: " << catalog.GetEntries().size() << ", scanned: " << catalog.GetScannedCount()
+              << ", unchanged: " << roms.size() - failed - catalog.GetScannedCount()
+              << ", pruned: " << pruned << ", failed: " << failed << "\n";
+    return failed == 0 ? 0 : 1;
+}
@@ -1,207 +1,614 @@
 #include "chip8.hpp"
+#include "aot_runtime.hpp"
+#include "block_cache.hpp"
+#include "debugger.hpp"
+#include "display.hpp"
 #include "font.hpp"
-#include <iostream>
-#include <fstream>
+#include "jit.hpp"
+#include "log.hpp"
+#include "profiler.hpp"
+#include "rom.hpp"
+#include "save_state.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
 
 namespace Chip8Emulator{
 
 void Chip8::LoadROM(const char* filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    RomImage rom(filename);
+    LoadROM(rom.GetData(), rom.GetSize());
 
-    if (file.is_open()) {
-        std::streampos size = file.tellg();
-        char* buffer = new char[size];
+    CHIP8_LOG_INFO("Loaded ROM size: %zu bytes", rom.GetSize());
+}
+
+void Chip8::LoadROM(const uint8_t* data, size_t size) {
+    if (size > m_AddressMask + 1u - START_ADDR) {
+        throw std::runtime_error("ROM does not fit in memory.");
+    }
 
-        file.seekg(0, std::ios::beg);
-        file.read(buffer, size);
-        file.close();
+    std::copy_n(data, size, m_Data + START_ADDR);
 
-        for (long i = 0; i < size; i++) {
-            m_Data[START_ADDR + i] = buffer[i];
+    if (m_BlockCache) {
+        m_BlockCache->Flush();
+    }
+    if (m_Jit) {
+        m_Jit->Flush();
+    }
+
+    // Picks the recompiled program built from this ROM, if one is linked in
+    if (m_Mode == ExecutionMode::Aot) {
+        const AotProgram* program = m_Variant == Variant::Chip8 ? FindAotProgram(data, size, m_QuirkProfile) : nullptr;
+        if (program == nullptr) {
+            CHIP8_LOG_WARN("No recompiled program for this ROM; interpreting");
+            m_Aot.reset();
+        } else if (!m_Aot || &m_Aot->GetProgram() != program) {
+            m_Aot = std::make_unique<AotRunner>(*program);
+        }
+        if (m_Aot) {
+            m_Aot->Flush(*this);
         }
+    }
+}
 
-        std::cout << "Loaded ROM size: " << size << " bytes" << std::endl;
-        delete[] buffer;
+bool ParseVariant(const std::string& name, Variant& variant) {
+    if (name == "chip8") {
+        variant = Variant::Chip8;
+    } else if (name == "schip") {
+        variant = Variant::SuperChip;
+    } else if (name == "xochip") {
+        variant = Variant::XoChip;
     } else {
-        throw  std::runtime_error("Failed to open ROM file.");
+        return false;
     }
+
+    return true;
+}
+
+bool ParseQuirkProfile(const std::string& name, QuirkProfile& profile) {
+    if (name == "modern") {
+        profile = QuirkProfile::Modern;
+    } else if (name == "cosmac") {
+        profile = QuirkProfile::Cosmac;
+    } else if (name == "schip") {
+        profile = QuirkProfile::SuperChip;
+    } else if (name == "xochip") {
+        profile = QuirkProfile::XoChip;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+const char* VariantName(Variant variant) {
+    static const char* const NAMES[] = { "chip8", "schip", "xochip" };
+    return NAMES[static_cast<size_t>(variant)];
+}
+
+const char* QuirkProfileName(QuirkProfile profile) {
+    static const char* const NAMES[] = { "modern", "cosmac", "schip", "xochip" };
+    static_assert(std::size(NAMES) == static_cast<size_t>(QuirkProfile::Count));
+    return NAMES[static_cast<size_t>(profile)];
+}
+
+void Chip8::SetQuirkProfile(QuirkProfile profile) {
+    static constexpr void (Chip8::*INTERPRETERS[])(uint32_t) = {
+        &Chip8::Interpret<QuirkProfile::Modern>,
+        &Chip8::Interpret<QuirkProfile::Cosmac>,
+        &Chip8::Interpret<QuirkProfile::SuperChip>,
+        &Chip8::Interpret<QuirkProfile::XoChip>,
+    };
+
+    m_QuirkProfile = profile;
+    m_Interpret = INTERPRETERS[static_cast<size_t>(profile)];
+
+    // Cached blocks hold the previous profile's handlers
+    if (m_BlockCache) {
+        m_BlockCache->Flush();
+    }
+    if (m_Jit) {
+        m_Jit->Flush();
+    }
+}
+
+void Chip8::SetVariant(Variant variant) {
+    m_Variant = variant;
+    SetQuirkProfile(DefaultQuirkProfile(variant));
+    m_AddressMask = variant == Variant::XoChip ? MAX_MEMORY_SIZE - 1 : MEMORY_SIZE - 1;
+    SelectStorage();
+    Reset();
+}
+
+size_t Chip8::GetDisplayStorageWords() const {
+    return m_Variant == Variant::Chip8 ? VIDEO_HEIGHT : GetPlaneCount() * DISPLAY_WORDS;
+}
+
+void Chip8::SelectStorage() {
+    if (m_Variant == Variant::XoChip) {
+        if (!m_ExtendedMemory) {
+            m_ExtendedMemory = std::make_unique<uint8_t[]>(MAX_MEMORY_SIZE);
+        }
+        m_Data = m_ExtendedMemory.get();
+    } else {
+        m_ExtendedMemory.reset();
+        m_Data = m_Memory;
+    }
+
+    if (m_Variant == Variant::Chip8) {
+        m_ExtendedDisplay.reset();
+        m_ExtendedDisplayWords = 0;
+        m_Display = m_LowResPlane;
+    } else {
+        const size_t words = GetDisplayStorageWords();
+        if (m_ExtendedDisplayWords != words) {
+            m_ExtendedDisplay = std::make_unique<uint64_t[]>(words);
+            m_ExtendedDisplayWords = words;
+        }
+        m_Display = m_ExtendedDisplay.get();
+    }
+}
+
+// Power-on state: memory holds only the fonts, and the RNG, variant and execution mode are kept
+void Chip8::Reset() {
+    std::fill_n(m_Data, m_AddressMask + 1u, 0);
+    std::fill(std::begin(m_Register), std::end(m_Register), 0);
+    std::fill(std::begin(m_Stack), std::end(m_Stack), 0);
+    std::fill(std::begin(m_Keypad), std::end(m_Keypad), 0);
+    std::fill_n(m_Display, GetDisplayStorageWords(), 0);
+    std::fill(std::begin(m_Flags), std::end(m_Flags), 0);
+    std::fill(std::begin(m_AudioPattern), std::end(m_AudioPattern), 0);
+    m_DirtyRows = ~0ull;
+    m_HiRes = false;
+    m_PlaneMask = 1;
+    m_Pitch = 64;
+    m_IndexRegister = 0;
+    m_ProgramCounter = START_ADDR;
+    m_StackPointer = 0;
+    m_DelayTimer = 0;
+    m_SoundTimer = 0;
+    m_CycleCount = 0;
+    m_IdleCycles = 0;
+
+    std::copy_n(fontset, FONTSET_SIZE, m_Data + FONTSET_START_ADDR);
+    std::copy_n(bigFontset, BIG_FONTSET_SIZE, m_Data + BIG_FONTSET_START_ADDR);
+
+    FlushBackends();
+}
+
+void Chip8::SaveState(MachineState& state) const {
+    MachineStateHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = SAVE_STATE_MAGIC;
+    header.version = SAVE_STATE_VERSION;
+    header.randomState = m_RandGen.GetState();
+    std::memcpy(header.registers, m_Register, sizeof(m_Register));
+    std::memcpy(header.stack, m_Stack, sizeof(m_Stack));
+    header.indexRegister = m_IndexRegister;
+    header.programCounter = m_ProgramCounter;
+    header.stackPointer = m_StackPointer;
+    header.delayTimer = m_DelayTimer;
+    header.soundTimer = m_SoundTimer;
+    header.quirkProfile = static_cast<uint8_t>(m_QuirkProfile);
+    header.variant = static_cast<uint8_t>(m_Variant);
+    header.hiRes = m_HiRes;
+    header.planeMask = m_PlaneMask;
+    header.pitch = m_Pitch;
+    std::memcpy(header.flags, m_Flags, sizeof(m_Flags));
+    std::memcpy(header.audioPattern, m_AudioPattern, sizeof(m_AudioPattern));
+
+    const size_t memory = m_AddressMask + 1u;
+    const size_t display = GetDisplayStorageWords() * sizeof(uint64_t);
+    state.bytes.resize(sizeof(header) + memory + display);
+    std::memcpy(state.bytes.data(), &header, sizeof(header));
+    std::memcpy(state.bytes.data() + sizeof(header), m_Data, memory);
+    std::memcpy(state.bytes.data() + sizeof(header) + memory, m_Display, display);
+}
+
+void Chip8::LoadState(const MachineState& state) {
+    MachineStateHeader header;
+    if (state.bytes.size() < sizeof(header)) {
+        throw std::runtime_error("Unsupported save state version.");
+    }
+    std::memcpy(&header, state.bytes.data(), sizeof(header));
+    if (header.magic != SAVE_STATE_MAGIC || header.version != SAVE_STATE_VERSION ||
+        header.variant > static_cast<uint8_t>(Variant::XoChip) ||
+        header.quirkProfile >= static_cast<uint8_t>(QuirkProfile::Count)) {
+        throw std::runtime_error("Unsupported save state version.");
+    }
+
+    // The header decides how much memory and display follow it
+    const Variant variant = static_cast<Variant>(header.variant);
+    const size_t memory = variant == Variant::XoChip ? MAX_MEMORY_SIZE : MEMORY_SIZE;
+    const unsigned int planes = variant == Variant::XoChip ? MAX_PLANES : 1;
+    const size_t display = (variant == Variant::Chip8 ? VIDEO_HEIGHT : planes * DISPLAY_WORDS) * sizeof(uint64_t);
+    if (state.bytes.size() != sizeof(header) + memory + display ||
+        (variant == Variant::Chip8 && header.hiRes) || (header.planeMask >> planes) != 0) {
+        throw std::runtime_error("Corrupt save state.");
+    }
+
+    m_Variant = variant;
+    m_AddressMask = static_cast<uint16_t>(memory - 1);
+    SelectStorage();
+    std::memcpy(m_Data, state.bytes.data() + sizeof(header), memory);
+    std::memcpy(m_Display, state.bytes.data() + sizeof(header) + memory, display);
+    m_DirtyRows = ~0ull;
+
+    std::memcpy(m_Register, header.registers, sizeof(m_Register));
+    std::memcpy(m_Stack, header.stack, sizeof(m_Stack));
+    m_IndexRegister = header.indexRegister;
+    m_ProgramCounter = header.programCounter;
+    m_StackPointer = header.stackPointer & (STACK_LEVELS - 1);
+    m_DelayTimer = header.delayTimer;
+    m_SoundTimer = header.soundTimer;
+    SetQuirkProfile(static_cast<QuirkProfile>(header.quirkProfile));
+    m_HiRes = header.hiRes;
+    m_PlaneMask = header.planeMask;
+    m_Pitch = header.pitch;
+    std::memcpy(m_Flags, header.flags, sizeof(m_Flags));
+    std::memcpy(m_AudioPattern, header.audioPattern, sizeof(m_AudioPattern));
+    m_RandGen.SetState(header.randomState);
+
+    // Code may differ from what the caches were built from
+    FlushBackends();
 }
 
 Chip8::Chip8()
-: m_ProgramCounter(START_ADDR),
-  m_RandGen(std::chrono::system_clock::now().time_since_epoch().count()),
-  m_RandomByte(std::uniform_int_distribution<uint8_t>(0, 255U))
+: Chip8(std::chrono::system_clock::now().time_since_epoch().count())
 {
-    InitializeOpcodeTable();
+}
 
+// Two instances built with the same seed and fed the same input run identically
+Chip8::Chip8(uint64_t seed)
+{
+    m_ProgramCounter = START_ADDR;
+    m_RandGen.Seed(seed);
     for (uint8_t i = 0; i < FONTSET_SIZE; ++i) {
         m_Data[FONTSET_START_ADDR + i] = fontset[i];
     }
+    std::copy_n(bigFontset, BIG_FONTSET_SIZE, m_Data + BIG_FONTSET_START_ADDR);
+
+#if CHIP8_PROFILE
+    m_Profiler = std::make_unique<Profiler>();
+#endif
 }
 
-void Chip8::OP_00E0(){
-    memset(m_Display, 0, sizeof(m_Display));
+void Chip8::SetTracer([[maybe_unused]] Tracer* tracer) {
+#if CHIP8_TRACE
+    m_Tracer = tracer;
+#endif
 }
 
-void Chip8::OP_00EE(){
-    m_ProgramCounter = m_Stack[--m_StackPointer];
+const Profiler* Chip8::GetProfiler() const {
+#if CHIP8_PROFILE
+    return m_Profiler.get();
+#else
+    return nullptr;
+#endif
 }
 
-void Chip8::OP_1nnn(){
-    m_ProgramCounter = m_Opcode & 0x0FFF;
+Chip8::Chip8(const Chip8& other)
+: Chip8State(other),
+  m_Interpret(other.m_Interpret)
+{
+    CopyStorage(other);
+    CopyBackends(other);
+#if CHIP8_PROFILE
+    m_Profiler = std::make_unique<Profiler>();
+#endif
 }
 
-void Chip8::OP_2nnn(){
-    m_Stack[m_StackPointer++] = m_ProgramCounter;
-    m_ProgramCounter = m_Opcode & 0x0FFF;
+Chip8& Chip8::operator=(const Chip8& other) {
+    if (this != &other) {
+        static_cast<Chip8State&>(*this) = other;
+        m_Interpret = other.m_Interpret;
+        CopyStorage(other);
+        CopyBackends(other);
+    }
+    return *this;
 }
 
-void Chip8::OP_3xkk(){
-    if (m_Register[(m_Opcode & 0x0F00) >> 8] == (m_Opcode & 0x00FF)) {
-        m_ProgramCounter += 2;
+Chip8::~Chip8() = default;
+
+void Chip8::CopyStorage(const Chip8& other) {
+    SelectStorage();
+    if (m_Data != m_Memory) {
+        std::copy_n(other.m_Data, m_AddressMask + 1u, m_Data);
+    }
+    if (m_Display != m_LowResPlane) {
+        std::copy_n(other.m_Display, GetDisplayStorageWords(), m_Display);
     }
 }
 
-void Chip8::OP_4xkk(){
-    if (m_Register[(m_Opcode & 0x0F00) >> 8] != (m_Opcode & 0x00FF)) {
-        m_ProgramCounter += 2;
+void Chip8::CopyBackends(const Chip8& other) {
+    // Keeps caches of the same mode, which only need flushing
+    SetExecutionMode(other.m_Mode);
+    if (!other.m_Aot) {
+        m_Aot.reset();
+    } else if (!m_Aot || &m_Aot->GetProgram() != &other.m_Aot->GetProgram()) {
+        m_Aot = std::make_unique<AotRunner>(other.m_Aot->GetProgram());
+    }
+    FlushBackends();
+}
+
+void Chip8::FlushBackends() {
+    if (m_BlockCache) {
+        m_BlockCache->Flush();
+    }
+    if (m_Jit) {
+        m_Jit->Flush();
+    }
+    if (m_Aot) {
+        m_Aot->Flush(*this);
+    }
+}
+
+bool ParseExecutionMode(const std::string& name, ExecutionMode& mode) {
+    if (name == "interpreter") {
+        mode = ExecutionMode::Interpreter;
+    } else if (name == "block") {
+        mode = ExecutionMode::BlockCache;
+    } else if (name == "jit") {
+        mode = ExecutionMode::Jit;
+    } else if (name == "aot") {
+        mode = ExecutionMode::Aot;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void Chip8::SetExecutionMode(ExecutionMode mode) {
+    if (mode == ExecutionMode::Jit && !m_Jit) {
+        m_Jit = std::make_unique<JitCompiler>(*this);
+    }
+    if (mode == ExecutionMode::BlockCache && !m_BlockCache) {
+        m_BlockCache = std::make_unique<BlockCache>();
+    }
+
+    // Caches are rebuilt from memory if the mode is selected again
+    if (mode != ExecutionMode::Jit) {
+        m_Jit.reset();
+    }
+    if (mode != ExecutionMode::BlockCache) {
+        m_BlockCache.reset();
+    }
+    // A recompiled program is picked when the ROM is loaded
+    if (mode != ExecutionMode::Aot) {
+        m_Aot.reset();
+    }
+
+    m_Mode = mode;
+}
+
+void Chip8::OnMemoryWrite(uint16_t address, uint16_t length) {
+    if (m_BlockCache) {
+        m_BlockCache->Invalidate(address, length);
+    }
+    if (m_Jit) {
+        m_Jit->Invalidate(address, length);
+    }
+    if (m_Aot) {
+        m_Aot->Invalidate(address, length);
     }
 }
 
-void Chip8::OP_5xy0(){
-    if (m_Register[(m_Opcode & 0x0F00) >> 8] == m_Register[(m_Opcode & 0x00F0) >> 4]) {
+void Chip8::OP_Unknown(const Instruction& ins){
+    char message[32];
+    snprintf(message, sizeof(message), "Unknown opcode 0x%04X", ins.opcode);
+    throw std::runtime_error(message);
+}
+
+void Chip8::SkipNext(){
+    // F000 is the only two-word instruction
+    if (m_Variant == Variant::XoChip && m_Data[m_ProgramCounter & m_AddressMask] == 0xF0 &&
+        m_Data[(m_ProgramCounter + 1) & m_AddressMask] == 0x00) {
         m_ProgramCounter += 2;
     }
+    m_ProgramCounter += 2;
 }
 
-void Chip8::OP_6xkk(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] = m_Opcode & 0x00FF;
+void Chip8::OP_00E0(const Instruction&){
+    // Words past the current resolution are always zero
+    const size_t words = GetDisplayHeight() * GetDisplayRowWords();
+    for (unsigned int plane = 0; plane < GetPlaneCount(); plane++) {
+        if (m_PlaneMask & (1u << plane)) {
+            memset(Plane(plane), 0, words * sizeof(uint64_t));
+        }
+    }
+    m_DirtyRows = ~0ull;
 }
 
-void Chip8::OP_7xkk(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] += m_Opcode & 0x00FF;
+// The stack pointer wraps, as in the batch engine, so unbalanced calls and
+// returns stay inside the stack
+void Chip8::OP_00EE(const Instruction&){
+    m_StackPointer = (m_StackPointer - 1) & (STACK_LEVELS - 1);
+    m_ProgramCounter = m_Stack[m_StackPointer];
 }
 
-void Chip8::OP_8xy0(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] = m_Register[(m_Opcode & 0x00F0) >> 4];
+void Chip8::OP_1nnn(const Instruction& ins){
+    m_ProgramCounter = ins.nnn;
 }
 
-void Chip8::OP_8xy1(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] |= m_Register[(m_Opcode & 0x00F0) >> 4];
+void Chip8::OP_2nnn(const Instruction& ins){
+    m_Stack[m_StackPointer] = m_ProgramCounter;
+    m_StackPointer = (m_StackPointer + 1) & (STACK_LEVELS - 1);
+    m_ProgramCounter = ins.nnn;
 }
 
-void Chip8::OP_8xy2(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] &= m_Register[(m_Opcode & 0x00F0) >> 4];
+void Chip8::OP_3xkk(const Instruction& ins){
+    if (m_Register[ins.x] == ins.kk) {
+        SkipNext();
+    }
 }
 
-void Chip8::OP_8xy3(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] ^= m_Register[(m_Opcode & 0x00F0) >> 4];
+void Chip8::OP_4xkk(const Instruction& ins){
+    if (m_Register[ins.x] != ins.kk) {
+        SkipNext();
+    }
 }
 
-void Chip8::OP_8xy4(){
-    uint16_t sum = m_Register[(m_Opcode & 0x0F00) >> 8] + m_Register[(m_Opcode & 0x00F0) >> 4];
-    m_Register[(m_Opcode & 0x0F00) >> 8] = sum & 0xFF;
-    m_Register[0xF] = sum > 0xFF;
+void Chip8::OP_5xy0(const Instruction& ins){
+    if (m_Register[ins.x] == m_Register[ins.y]) {
+        SkipNext();
+    }
 }
 
-void Chip8::OP_8xy5(){
-    m_Register[0xF] = m_Register[(m_Opcode & 0x0F00) >> 8] > m_Register[(m_Opcode & 0x00F0) >> 4];
-    m_Register[(m_Opcode & 0x0F00) >> 8] -= m_Register[(m_Opcode & 0x00F0) >> 4];
+void Chip8::OP_6xkk(const Instruction& ins){
+    m_Register[ins.x] = ins.kk;
 }
 
-void Chip8::OP_8xy6(){
-    m_Register[0xF] = m_Register[(m_Opcode & 0x0F00) >> 8] & 0x1;
-    m_Register[(m_Opcode & 0x0F00) >> 8] >>= 1;
+void Chip8::OP_7xkk(const Instruction& ins){
+    m_Register[ins.x] += ins.kk;
 }
 
-void Chip8::OP_8xy7(){
-    m_Register[0xF] = m_Register[(m_Opcode & 0x00F0) >> 4] > m_Register[(m_Opcode & 0x0F00) >> 8];
-    m_Register[(m_Opcode & 0x0F00) >> 8] = m_Register[(m_Opcode & 0x00F0) >> 4] - m_Register[(m_Opcode & 0x0F00) >> 8];
+void Chip8::OP_8xy0(const Instruction& ins){
+    m_Register[ins.x] = m_Register[ins.y];
 }
 
-void Chip8::OP_8xyE(){
-    m_Register[0xF] = m_Register[(m_Opcode & 0x0F00) >> 8] >> 7;
-    m_Register[(m_Opcode & 0x0F00) >> 8] <<= 1;
+template <QuirkProfile Profile>
+void Chip8::OP_8xy1(const Instruction& ins){
+    m_Register[ins.x] |= m_Register[ins.y];
+    if constexpr (GetQuirks(Profile).logicResetsVf) {
+        m_Register[0xF] = 0;
+    }
 }
 
-void Chip8::OP_9xy0(){
-    if (m_Register[(m_Opcode & 0x0F00) >> 8] != m_Register[(m_Opcode & 0x00F0) >> 4]) {
-        m_ProgramCounter += 2;
+template <QuirkProfile Profile>
+void Chip8::OP_8xy2(const Instruction& ins){
+    m_Register[ins.x] &= m_Register[ins.y];
+    if constexpr (GetQuirks(Profile).logicResetsVf) {
+        m_Register[0xF] = 0;
     }
 }
 
-void Chip8::OP_Annn(){
-    m_IndexRegister = m_Opcode & 0x0FFFu;
+template <QuirkProfile Profile>
+void Chip8::OP_8xy3(const Instruction& ins){
+    m_Register[ins.x] ^= m_Register[ins.y];
+    if constexpr (GetQuirks(Profile).logicResetsVf) {
+        m_Register[0xF] = 0;
+    }
 }
 
-void Chip8::OP_Bnnn(){
-    m_ProgramCounter = (m_Opcode & 0x0FFF) + m_Register[0];
+void Chip8::OP_8xy4(const Instruction& ins){
+    uint16_t sum = m_Register[ins.x] + m_Register[ins.y];
+    m_Register[ins.x] = sum & 0xFF;
+    m_Register[0xF] = sum > 0xFF;
 }
 
-void Chip8::OP_Cxkk(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] = m_RandomByte(m_RandGen) & (m_Opcode & 0x00FF);
+void Chip8::OP_8xy5(const Instruction& ins){
+    m_Register[0xF] = m_Register[ins.x] > m_Register[ins.y];
+    m_Register[ins.x] -= m_Register[ins.y];
 }
 
-void Chip8::OP_Dxyn(){
-    uint8_t Vx = (m_Opcode & 0x0F00u) >> 8u;
-	uint8_t Vy = (m_Opcode & 0x00F0u) >> 4u;
-	uint8_t height = m_Opcode & 0x000Fu;
+template <QuirkProfile Profile>
+void Chip8::OP_8xy6(const Instruction& ins){
+    if constexpr (GetQuirks(Profile).shiftUsesVy) {
+        uint8_t source = m_Register[ins.y];
+        m_Register[0xF] = source & 0x1;
+        m_Register[ins.x] = source >> 1;
+    } else {
+        m_Register[0xF] = m_Register[ins.x] & 0x1;
+        m_Register[ins.x] >>= 1;
+    }
+}
 
-	// Wrap if going beyond screen boundaries
-	uint8_t xPos = m_Register[Vx] % VIDEO_WIDTH;
-	uint8_t yPos = m_Register[Vy] % VIDEO_HEIGHT;
+void Chip8::OP_8xy7(const Instruction& ins){
+    m_Register[0xF] = m_Register[ins.y] > m_Register[ins.x];
+    m_Register[ins.x] = m_Register[ins.y] - m_Register[ins.x];
+}
 
-	m_Register[0xF] = 0;
+template <QuirkProfile Profile>
+void Chip8::OP_8xyE(const Instruction& ins){
+    if constexpr (GetQuirks(Profile).shiftUsesVy) {
+        uint8_t source = m_Register[ins.y];
+        m_Register[0xF] = source >> 7;
+        m_Register[ins.x] = source << 1;
+    } else {
+        m_Register[0xF] = m_Register[ins.x] >> 7;
+        m_Register[ins.x] <<= 1;
+    }
+}
 
-	for (unsigned int row = 0; row < height; ++row)
-	{
-		uint8_t spriteByte = m_Data[m_IndexRegister + row];
+void Chip8::OP_9xy0(const Instruction& ins){
+    if (m_Register[ins.x] != m_Register[ins.y]) {
+        SkipNext();
+    }
+}
 
-		for (unsigned int col = 0; col < 8; ++col)
-		{
-			uint8_t spritePixel = spriteByte & (0x80u >> col);
-			uint32_t* screenPixel = &m_Display[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
+void Chip8::OP_Annn(const Instruction& ins){
+    m_IndexRegister = ins.nnn;
+}
 
-			// Sprite pixel is on
-			if (spritePixel)
-			{
-				// Screen pixel also on - collision
-				if (*screenPixel == 0xFFFFFFFF)
-				{
-					m_Register[0xF] = 1;
-				}
+template <QuirkProfile Profile>
+void Chip8::OP_Bnnn(const Instruction& ins){
+    m_ProgramCounter = ins.nnn + m_Register[GetQuirks(Profile).jumpUsesVx ? ins.x : 0];
+}
 
-				// Effectively XOR with the sprite pixel
-				*screenPixel ^= 0xFFFFFFFF;
-			}
-		}
-	}
+void Chip8::OP_Cxkk(const Instruction& ins){
+    m_Register[ins.x] = m_RandGen.NextByte() & ins.kk;
 }
 
-void Chip8::OP_Ex9E(){
-    if (m_Keypad[m_Register[(m_Opcode & 0x0F00) >> 8]]) {
-        m_ProgramCounter += 2;
+template <QuirkProfile Profile>
+void Chip8::OP_Dxyn(const Instruction& ins){
+    // Hi-res, bitplane and 16x16 drawing take the general path
+    if (m_HiRes || m_PlaneMask != 1 || (ins.n == 0 && m_Variant != Variant::Chip8)) {
+        DrawSprite<Profile>(ins);
+        return;
     }
+
+    // The start position wraps around the screen; sprite pixels past the right or
+    // bottom edge are clipped, or with the wrap quirk drawn at the opposite edge.
+    constexpr bool wrap = GetQuirks(Profile).wrapSprites;
+    unsigned int xPos = m_Register[ins.x] % VIDEO_WIDTH;
+    unsigned int yPos = m_Register[ins.y] % VIDEO_HEIGHT;
+    unsigned int height = wrap ? ins.n : std::min<unsigned int>(ins.n, VIDEO_HEIGHT - yPos);
+
+    uint64_t collision = 0;
+    for (unsigned int row = 0; row < height; ++row) {
+        // Shifting the sprite byte right from the top of the word drops any bits past x = 63;
+        // rotating carries them round to x = 0
+        uint64_t sprite = uint64_t{m_Data[(m_IndexRegister + row) & m_AddressMask]} << 56;
+        uint64_t spriteRow = wrap ? std::rotr(sprite, xPos) : sprite >> xPos;
+        unsigned int y = wrap ? (yPos + row) % VIDEO_HEIGHT : yPos + row;
+
+        collision |= m_Display[y] & spriteRow;
+        m_Display[y] ^= spriteRow;
+        m_DirtyRows |= uint64_t{spriteRow != 0} << y;
+    }
+
+    m_Register[0xF] = collision != 0;
 }
 
-void Chip8::OP_ExA1(){
-    if (!m_Keypad[m_Register[(m_Opcode & 0x0F00) >> 8]]) {
-        m_ProgramCounter += 2;
+void Chip8::OP_Ex9E(const Instruction& ins){
+    if (m_Keypad[m_Register[ins.x] & 0xF]) {
+        SkipNext();
+    }
+}
+
+void Chip8::OP_ExA1(const Instruction& ins){
+    if (!m_Keypad[m_Register[ins.x] & 0xF]) {
+        SkipNext();
     }
 }
 
-void Chip8::OP_Fx07(){
-    m_Register[(m_Opcode & 0x0F00) >> 8] = m_DelayTimer;
+void Chip8::OP_Fx07(const Instruction& ins){
+    m_Register[ins.x] = m_DelayTimer;
 }
 
-void Chip8::OP_Fx0A() {
-    std::cout << "Waiting for key press..." << std::endl;
+void Chip8::OP_Fx0A(const Instruction& ins) {
+    CHIP8_LOG_TRACE("Waiting for key press...");
     bool keyPress = false;
 
     for (int i = 0; i < 16; i++) {
         if (m_Keypad[i] != 0) {
-            std::cout << "Key pressed: " << i << std::endl;
-            m_Register[(m_Opcode & 0x0F00u) >> 8u] = i;
+            CHIP8_LOG_DEBUG("Key pressed: %d", i);
+            m_Register[ins.x] = i;
             keyPress = true;
             break;
         }
@@ -212,129 +619,663 @@ void Chip8::OP_Fx0A() {
     }
 }
 
-void Chip8::OP_Fx15(){
-    m_DelayTimer = m_Register[(m_Opcode & 0x0F00) >> 8];
+void Chip8::OP_Fx15(const Instruction& ins){
+    m_DelayTimer = m_Register[ins.x];
 }
 
-void Chip8::OP_Fx18(){
-    m_SoundTimer = m_Register[(m_Opcode & 0x0F00) >> 8];
+void Chip8::OP_Fx18(const Instruction& ins){
+    m_SoundTimer = m_Register[ins.x];
 }
 
-void Chip8::OP_Fx1E()
+void Chip8::OP_Fx1E(const Instruction& ins)
 {
-    m_IndexRegister += m_Register[(m_Opcode & 0x0F00) >> 8];
-}
-
-void Chip8::OP_Fx29(){
-    m_IndexRegister = m_Register[(m_Opcode & 0x0F00) >> 8] * 0x5;
-}
-
-void Chip8::OP_Fx33(){
-    m_Data[m_IndexRegister] = m_Register[(m_Opcode & 0x0F00) >> 8] / 100;
-    m_Data[m_IndexRegister + 1] = (m_Register[(m_Opcode & 0x0F00) >> 8] / 10) % 10;
-    m_Data[m_IndexRegister + 2] = (m_Register[(m_Opcode & 0x0F00) >> 8] % 100) % 10;
-}
-
-void Chip8::OP_Fx55(){
-    for (int i = 0; i <= ((m_Opcode & 0x0F00) >> 8); i++) {
-        m_Data[m_IndexRegister + i] = m_Register[i];
-    }
-}
-
-void Chip8::OP_Fx65(){
-    for (int i = 0; i <= ((m_Opcode & 0x0F00) >> 8); i++) {
-        m_Register[i] = m_Data[m_IndexRegister + i];
-    }
-}
-
-void Chip8::Nibble0(){ ExecuteOpcode(m_OpcodeTable0, m_Opcode & 0x00FF);}
-void Chip8::Nibble8(){ ExecuteOpcode(m_OpcodeTable8, m_Opcode & 0x000F);}
-void Chip8::NibbleE(){ ExecuteOpcode(m_OpcodeTableE, m_Opcode & 0x00FF);}
-void Chip8::NibbleF(){ ExecuteOpcode(m_OpcodeTableF, m_Opcode & 0x00FF);}
-
-void Chip8::InitializeOpcodeTable() {
-        // Primary opcodes
-        m_OpcodeTable = {
-            {0x0, &Chip8::Nibble0},
-            {0x1, &Chip8::OP_1nnn},
-            {0x2, &Chip8::OP_2nnn},
-            {0x3, &Chip8::OP_3xkk},
-            {0x4, &Chip8::OP_4xkk},
-            {0x5, &Chip8::OP_5xy0},
-            {0x6, &Chip8::OP_6xkk},
-            {0x7, &Chip8::OP_7xkk},
-            {0x8, &Chip8::Nibble8},
-            {0x9, &Chip8::OP_9xy0},
-            {0xA, &Chip8::OP_Annn},
-            {0xB, &Chip8::OP_Bnnn},
-            {0xC, &Chip8::OP_Cxkk},
-            {0xD, &Chip8::OP_Dxyn},
-            {0xE, &Chip8::NibbleE},
-            {0xF, &Chip8::NibbleF}
-        };
-
-        // 0x0XXX opcodes
-        m_OpcodeTable0 = {
-            {0xE0, &Chip8::OP_00E0},
-            {0xEE, &Chip8::OP_00EE}
-        };
-
-        // 0x8XXX opcodes
-        m_OpcodeTable8 = {
-            {0x0, &Chip8::OP_8xy0},
-            {0x1, &Chip8::OP_8xy1},
-            {0x2, &Chip8::OP_8xy2},
-            {0x3, &Chip8::OP_8xy3},
-            {0x4, &Chip8::OP_8xy4},
-            {0x5, &Chip8::OP_8xy5},
-            {0x6, &Chip8::OP_8xy6},
-            {0x7, &Chip8::OP_8xy7},
-            {0xE, &Chip8::OP_8xyE}
-        };
-
-        // 0xEXXX opcodes
-        m_OpcodeTableE = {
-            {0x9E, &Chip8::OP_Ex9E},
-            {0xA1, &Chip8::OP_ExA1}
-        };
-
-        // 0xFXXX opcodes
-        m_OpcodeTableF = {
-            {0x07, &Chip8::OP_Fx07},
-            {0x0A, &Chip8::OP_Fx0A},
-            {0x15, &Chip8::OP_Fx15},
-            {0x18, &Chip8::OP_Fx18},
-            {0x1E, &Chip8::OP_Fx1E},
-            {0x29, &Chip8::OP_Fx29},
-            {0x33, &Chip8::OP_Fx33},
-            {0x55, &Chip8::OP_Fx55},
-            {0x65, &Chip8::OP_Fx65}
-        };
-    }
-
-void Chip8::ExecuteOpcode(const std::unordered_map<uint8_t, OpcodeFunc>& byteMap, uint8_t byteCode) {
-    auto it = byteMap.find(byteCode);
-    if (it != byteMap.end()) {
-        (this->*(it->second))();
-    } else {
-        throw std::runtime_error("Unknown opcode");
+    m_IndexRegister += m_Register[ins.x];
+}
+
+void Chip8::OP_Fx29(const Instruction& ins){
+    m_IndexRegister = FONTSET_START_ADDR + (m_Register[ins.x] & 0xF) * 5;
+}
+
+void Chip8::OP_Fx33(const Instruction& ins){
+    m_Data[m_IndexRegister & m_AddressMask] = m_Register[ins.x] / 100;
+    m_Data[(m_IndexRegister + 1) & m_AddressMask] = (m_Register[ins.x] / 10) % 10;
+    m_Data[(m_IndexRegister + 2) & m_AddressMask] = (m_Register[ins.x] % 100) % 10;
+    OnMemoryWrite(m_IndexRegister & m_AddressMask, 3);
+}
+
+template <QuirkProfile Profile>
+void Chip8::OP_Fx55(const Instruction& ins){
+    for (int i = 0; i <= ins.x; i++) {
+        m_Data[(m_IndexRegister + i) & m_AddressMask] = m_Register[i];
+    }
+    OnMemoryWrite(m_IndexRegister & m_AddressMask, ins.x + 1);
+    if constexpr (GetQuirks(Profile).memoryIncrementsI) {
+        m_IndexRegister += ins.x + 1;
+    }
+}
+
+template <QuirkProfile Profile>
+void Chip8::OP_Fx65(const Instruction& ins){
+    for (int i = 0; i <= ins.x; i++) {
+        m_Register[i] = m_Data[(m_IndexRegister + i) & m_AddressMask];
+    }
+    if constexpr (GetQuirks(Profile).memoryIncrementsI) {
+        m_IndexRegister += ins.x + 1;
+    }
+}
+
+template <QuirkProfile Profile>
+void Chip8::DrawSprite(const Instruction& ins){
+    constexpr bool wrap = GetQuirks(Profile).wrapSprites;
+    const unsigned int width = GetDisplayWidth();
+    const unsigned int height = GetDisplayHeight();
+    const unsigned int words = GetDisplayRowWords();
+    const bool large = ins.n == 0;
+    const unsigned int rows = large ? 16 : ins.n;
+
+    unsigned int xPos = m_Register[ins.x] % width;
+    unsigned int yPos = m_Register[ins.y] % height;
+    unsigned int visible = wrap ? rows : std::min(rows, height - yPos);
+    unsigned int word = xPos / 64;
+    unsigned int shift = xPos % 64;
+
+    // Each selected plane consumes its own sprite data, one plane after the other
+    uint16_t address = m_IndexRegister;
+    uint64_t collision = 0;
+    for (unsigned int plane = 0; plane < GetPlaneCount(); plane++) {
+        if (!(m_PlaneMask & (1u << plane))) {
+            continue;
+        }
+
+        for (unsigned int row = 0; row < visible; ++row) {
+            uint64_t bits = large
+                ? (uint64_t{m_Data[(address + 2 * row) & m_AddressMask]} << 8) | m_Data[(address + 2 * row + 1) & m_AddressMask]
+                : uint64_t{m_Data[(address + row) & m_AddressMask]} << 8;
+
+            // The 16 sprite pixels start at bit 63 and may straddle two words of a hi-res row
+            uint64_t sprite = bits << 48;
+            unsigned int y = (yPos + row) % height;
+            uint64_t* line = Plane(plane) + y * words;
+            uint64_t first = sprite >> shift;
+            collision |= line[word] & first;
+            line[word] ^= first;
+            if (shift != 0 && word + 1 < words) {
+                uint64_t second = sprite << (64 - shift);
+                collision |= line[word + 1] & second;
+                line[word + 1] ^= second;
+            }
+            // Pixels past the right edge come back in at x = 0
+            if (wrap && xPos + 16 > width) {
+                uint64_t wrapped = sprite << (width - xPos);
+                collision |= line[0] & wrapped;
+                line[0] ^= wrapped;
+            }
+            m_DirtyRows |= uint64_t{sprite != 0} << y;
+        }
+
+        address += large ? 32 : rows;
+    }
+
+    m_Register[0xF] = collision != 0;
+}
+
+void Chip8::SetResolution(bool hiRes){
+    m_HiRes = hiRes;
+    std::fill_n(m_Display, GetDisplayStorageWords(), 0);
+    m_DirtyRows = ~0ull;
+}
+
+// Whole rows move, so a vertical scroll is one memmove per plane
+void Chip8::ScrollVertical(int rows){
+    const unsigned int words = GetDisplayRowWords();
+    const unsigned int height = GetDisplayHeight();
+    const size_t total = height * words;
+    const size_t moved = std::min<unsigned int>(std::abs(rows), height) * words;
+
+    for (unsigned int plane = 0; plane < GetPlaneCount(); plane++) {
+        if (!(m_PlaneMask & (1u << plane))) {
+            continue;
+        }
+
+        uint64_t* display = Plane(plane);
+        if (rows > 0) {
+            memmove(display + moved, display, (total - moved) * sizeof(uint64_t));
+            memset(display, 0, moved * sizeof(uint64_t));
+        } else {
+            memmove(display, display + moved, (total - moved) * sizeof(uint64_t));
+            memset(display + total - moved, 0, moved * sizeof(uint64_t));
+        }
+    }
+    m_DirtyRows = ~0ull;
+}
+
+// Positive pixels scroll right; a hi-res row shifts as one 128-bit value
+void Chip8::ScrollHorizontal(int pixels){
+    const unsigned int height = GetDisplayHeight();
+    const unsigned int shift = std::abs(pixels);
+
+    for (unsigned int plane = 0; plane < GetPlaneCount(); plane++) {
+        if (!(m_PlaneMask & (1u << plane))) {
+            continue;
+        }
+
+        uint64_t* display = Plane(plane);
+        if (!m_HiRes) {
+            for (unsigned int y = 0; y < height; y++) {
+                display[y] = pixels > 0 ? display[y] >> shift : display[y] << shift;
+            }
+            continue;
+        }
+
+        for (unsigned int y = 0; y < height; y++) {
+            uint64_t& left = display[2 * y];
+            uint64_t& right = display[2 * y + 1];
+            if (pixels > 0) {
+                right = (right >> shift) | (left << (64 - shift));
+                left >>= shift;
+            } else {
+                left = (left << shift) | (right >> (64 - shift));
+                right <<= shift;
+            }
+        }
+    }
+    m_DirtyRows = ~0ull;
+}
+
+void Chip8::OP_00Cn(const Instruction& ins){
+    ScrollVertical(ins.n);
+}
+
+void Chip8::OP_00Dn(const Instruction& ins){
+    ScrollVertical(-ins.n);
+}
+
+void Chip8::OP_00FB(const Instruction&){
+    ScrollHorizontal(4);
+}
+
+void Chip8::OP_00FC(const Instruction&){
+    ScrollHorizontal(-4);
+}
+
+// Exit: the machine stays on this instruction, which Run() skips as idle
+void Chip8::OP_00FD(const Instruction&){
+    m_ProgramCounter -= 2;
+}
+
+void Chip8::OP_00FE(const Instruction&){
+    SetResolution(false);
+}
+
+void Chip8::OP_00FF(const Instruction&){
+    SetResolution(true);
+}
+
+void Chip8::OP_Fx30(const Instruction& ins){
+    m_IndexRegister = BIG_FONTSET_START_ADDR + (m_Register[ins.x] & 0xF) * 10;
+}
+
+void Chip8::OP_Fx75(const Instruction& ins){
+    std::copy_n(m_Register, ins.x + 1, m_Flags);
+}
+
+void Chip8::OP_Fx85(const Instruction& ins){
+    std::copy_n(m_Flags, ins.x + 1, m_Register);
+}
+
+// 5xy2 and 5xy3 walk Vx..Vy in either direction and leave I unchanged
+void Chip8::OP_5xy2(const Instruction& ins){
+    int step = ins.x <= ins.y ? 1 : -1;
+    unsigned int count = std::abs(ins.y - ins.x) + 1;
+    for (unsigned int i = 0; i < count; i++) {
+        m_Data[(m_IndexRegister + i) & m_AddressMask] = m_Register[ins.x + step * static_cast<int>(i)];
+    }
+    OnMemoryWrite(m_IndexRegister & m_AddressMask, count);
+}
+
+void Chip8::OP_5xy3(const Instruction& ins){
+    int step = ins.x <= ins.y ? 1 : -1;
+    unsigned int count = std::abs(ins.y - ins.x) + 1;
+    for (unsigned int i = 0; i < count; i++) {
+        m_Register[ins.x + step * static_cast<int>(i)] = m_Data[(m_IndexRegister + i) & m_AddressMask];
+    }
+}
+
+// F000 nnnn: the address is the following word
+void Chip8::OP_F000(const Instruction&){
+    m_IndexRegister = (m_Data[m_ProgramCounter & m_AddressMask] << 8) | m_Data[(m_ProgramCounter + 1) & m_AddressMask];
+    m_ProgramCounter += 2;
+}
+
+void Chip8::OP_Fn01(const Instruction& ins){
+    m_PlaneMask = ins.x;
+}
+
+void Chip8::OP_F002(const Instruction&){
+    for (unsigned int i = 0; i < AUDIO_PATTERN_SIZE; i++) {
+        m_AudioPattern[i] = m_Data[(m_IndexRegister + i) & m_AddressMask];
+    }
+}
+
+void Chip8::OP_Fx3A(const Instruction& ins){
+    m_Pitch = m_Register[ins.x];
+}
+
+uint64_t Chip8::GetDisplayHash() const{
+    const unsigned int words = GetDisplayHeight() * GetDisplayRowWords();
+    uint64_t hash = HashDisplay(GetPlane(0), words);
+    for (unsigned int plane = 1; plane < GetPlaneCount(); plane++) {
+        hash = HashDisplay(GetPlane(plane), words, hash);
+    }
+    return hash;
+}
+
+namespace {
+
+// Run() looks for busy-waits at least this often
+constexpr uint32_t IDLE_CHECK_INTERVAL = 256;
+
+// Maps a packed (high nibble, low byte) index to the handler for that opcode family.
+// Built at compile time, one table per variant, so decoding is a single array load.
+constexpr std::array<OpcodeId, DECODE_TABLE_SIZE> BuildDecodeTable(Variant variant) {
+    std::array<OpcodeId, DECODE_TABLE_SIZE> table{};
+    const bool super = variant != Variant::Chip8;
+    const bool xo = variant == Variant::XoChip;
+
+    for (unsigned int index = 0; index < DECODE_TABLE_SIZE; index++) {
+        unsigned int nibble = index >> 8;
+        unsigned int lowByte = index & 0xFF;
+        OpcodeId id = OpcodeId::Unknown;
+
+        switch (nibble) {
+            case 0x0:
+                if (lowByte == 0xE0) id = OpcodeId::OP_00E0;
+                if (lowByte == 0xEE) id = OpcodeId::OP_00EE;
+                if (super) {
+                    if ((lowByte & 0xF0) == 0xC0) id = OpcodeId::OP_00Cn;
+                    if (lowByte == 0xFB) id = OpcodeId::OP_00FB;
+                    if (lowByte == 0xFC) id = OpcodeId::OP_00FC;
+                    if (lowByte == 0xFD) id = OpcodeId::OP_00FD;
+                    if (lowByte == 0xFE) id = OpcodeId::OP_00FE;
+                    if (lowByte == 0xFF) id = OpcodeId::OP_00FF;
+                }
+                if (xo && (lowByte & 0xF0) == 0xD0) id = OpcodeId::OP_00Dn;
+                break;
+            case 0x1: id = OpcodeId::OP_1nnn; break;
+            case 0x2: id = OpcodeId::OP_2nnn; break;
+            case 0x3: id = OpcodeId::OP_3xkk; break;
+            case 0x4: id = OpcodeId::OP_4xkk; break;
+            case 0x5:
+                id = OpcodeId::OP_5xy0;
+                if (xo && (lowByte & 0xF) == 0x2) id = OpcodeId::OP_5xy2;
+                if (xo && (lowByte & 0xF) == 0x3) id = OpcodeId::OP_5xy3;
+                break;
+            case 0x6: id = OpcodeId::OP_6xkk; break;
+            case 0x7: id = OpcodeId::OP_7xkk; break;
+            case 0x8:
+                switch (lowByte & 0xF) {
+                    case 0x0: id = OpcodeId::OP_8xy0; break;
+                    case 0x1: id = OpcodeId::OP_8xy1; break;
+                    case 0x2: id = OpcodeId::OP_8xy2; break;
+                    case 0x3: id = OpcodeId::OP_8xy3; break;
+                    case 0x4: id = OpcodeId::OP_8xy4; break;
+                    case 0x5: id = OpcodeId::OP_8xy5; break;
+                    case 0x6: id = OpcodeId::OP_8xy6; break;
+                    case 0x7: id = OpcodeId::OP_8xy7; break;
+                    case 0xE: id = OpcodeId::OP_8xyE; break;
+                }
+                break;
+            case 0x9: id = OpcodeId::OP_9xy0; break;
+            case 0xA: id = OpcodeId::OP_Annn; break;
+            case 0xB: id = OpcodeId::OP_Bnnn; break;
+            case 0xC: id = OpcodeId::OP_Cxkk; break;
+            case 0xD: id = OpcodeId::OP_Dxyn; break;
+            case 0xE:
+                if (lowByte == 0x9E) id = OpcodeId::OP_Ex9E;
+                if (lowByte == 0xA1) id = OpcodeId::OP_ExA1;
+                break;
+            case 0xF:
+                switch (lowByte) {
+                    case 0x07: id = OpcodeId::OP_Fx07; break;
+                    case 0x0A: id = OpcodeId::OP_Fx0A; break;
+                    case 0x15: id = OpcodeId::OP_Fx15; break;
+                    case 0x18: id = OpcodeId::OP_Fx18; break;
+                    case 0x1E: id = OpcodeId::OP_Fx1E; break;
+                    case 0x29: id = OpcodeId::OP_Fx29; break;
+                    case 0x33: id = OpcodeId::OP_Fx33; break;
+                    case 0x55: id = OpcodeId::OP_Fx55; break;
+                    case 0x65: id = OpcodeId::OP_Fx65; break;
+                }
+                if (super) {
+                    if (lowByte == 0x30) id = OpcodeId::OP_Fx30;
+                    if (lowByte == 0x75) id = OpcodeId::OP_Fx75;
+                    if (lowByte == 0x85) id = OpcodeId::OP_Fx85;
+                }
+                if (xo) {
+                    if (lowByte == 0x00) id = OpcodeId::OP_F000;
+                    if (lowByte == 0x01) id = OpcodeId::OP_Fn01;
+                    if (lowByte == 0x02) id = OpcodeId::OP_F002;
+                    if (lowByte == 0x3A) id = OpcodeId::OP_Fx3A;
+                }
+                break;
+        }
+
+        table[index] = id;
     }
+
+    return table;
+}
+
+// Indexed by Variant
+constexpr std::array<OpcodeId, DECODE_TABLE_SIZE> DECODE_TABLES[] = {
+    BuildDecodeTable(Variant::Chip8),
+    BuildDecodeTable(Variant::SuperChip),
+    BuildDecodeTable(Variant::XoChip),
+};
+
+} // namespace
+
+// Indexed by OpcodeId
+template <QuirkProfile Profile>
+constexpr Chip8::HandlerTable Chip8::MakeHandlerTable() {
+    return {
+        &Chip8::Invoke<&Chip8::OP_Unknown>,
+        &Chip8::Invoke<&Chip8::OP_00E0>,
+        &Chip8::Invoke<&Chip8::OP_00EE>,
+        &Chip8::Invoke<&Chip8::OP_1nnn>,
+        &Chip8::Invoke<&Chip8::OP_2nnn>,
+        &Chip8::Invoke<&Chip8::OP_3xkk>,
+        &Chip8::Invoke<&Chip8::OP_4xkk>,
+        &Chip8::Invoke<&Chip8::OP_5xy0>,
+        &Chip8::Invoke<&Chip8::OP_6xkk>,
+        &Chip8::Invoke<&Chip8::OP_7xkk>,
+        &Chip8::Invoke<&Chip8::OP_8xy0>,
+        &Chip8::Invoke<&Chip8::OP_8xy1<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_8xy2<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_8xy3<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_8xy4>,
+        &Chip8::Invoke<&Chip8::OP_8xy5>,
+        &Chip8::Invoke<&Chip8::OP_8xy6<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_8xy7>,
+        &Chip8::Invoke<&Chip8::OP_8xyE<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_9xy0>,
+        &Chip8::Invoke<&Chip8::OP_Annn>,
+        &Chip8::Invoke<&Chip8::OP_Bnnn<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_Cxkk>,
+        &Chip8::Invoke<&Chip8::OP_Dxyn<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_Ex9E>,
+        &Chip8::Invoke<&Chip8::OP_ExA1>,
+        &Chip8::Invoke<&Chip8::OP_Fx07>,
+        &Chip8::Invoke<&Chip8::OP_Fx0A>,
+        &Chip8::Invoke<&Chip8::OP_Fx15>,
+        &Chip8::Invoke<&Chip8::OP_Fx18>,
+        &Chip8::Invoke<&Chip8::OP_Fx1E>,
+        &Chip8::Invoke<&Chip8::OP_Fx29>,
+        &Chip8::Invoke<&Chip8::OP_Fx33>,
+        &Chip8::Invoke<&Chip8::OP_Fx55<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_Fx65<Profile>>,
+        &Chip8::Invoke<&Chip8::OP_00Cn>,
+        &Chip8::Invoke<&Chip8::OP_00FB>,
+        &Chip8::Invoke<&Chip8::OP_00FC>,
+        &Chip8::Invoke<&Chip8::OP_00FD>,
+        &Chip8::Invoke<&Chip8::OP_00FE>,
+        &Chip8::Invoke<&Chip8::OP_00FF>,
+        &Chip8::Invoke<&Chip8::OP_Fx30>,
+        &Chip8::Invoke<&Chip8::OP_Fx75>,
+        &Chip8::Invoke<&Chip8::OP_Fx85>,
+        &Chip8::Invoke<&Chip8::OP_00Dn>,
+        &Chip8::Invoke<&Chip8::OP_5xy2>,
+        &Chip8::Invoke<&Chip8::OP_5xy3>,
+        &Chip8::Invoke<&Chip8::OP_F000>,
+        &Chip8::Invoke<&Chip8::OP_Fn01>,
+        &Chip8::Invoke<&Chip8::OP_F002>,
+        &Chip8::Invoke<&Chip8::OP_Fx3A>
+    };
+}
+
+// Indexed by QuirkProfile
+const Chip8::HandlerTable Chip8::s_Handlers[static_cast<size_t>(QuirkProfile::Count)] = {
+    MakeHandlerTable<QuirkProfile::Modern>(),
+    MakeHandlerTable<QuirkProfile::Cosmac>(),
+    MakeHandlerTable<QuirkProfile::SuperChip>(),
+    MakeHandlerTable<QuirkProfile::XoChip>(),
+};
+
+OpcodeId DecodeOpcodeId(uint16_t opcode, Variant variant) {
+    return DECODE_TABLES[static_cast<size_t>(variant)][((opcode & 0xF000u) >> 4) | (opcode & 0x00FFu)];
+}
+
+Instruction Chip8::Decode(uint16_t opcode, Variant variant, QuirkProfile profile) {
+    return {
+        s_Handlers[static_cast<size_t>(profile)][static_cast<size_t>(DecodeOpcodeId(opcode, variant))],
+        opcode,
+        static_cast<uint16_t>(opcode & 0x0FFFu),
+        static_cast<uint8_t>((opcode & 0x0F00u) >> 8),
+        static_cast<uint8_t>((opcode & 0x00F0u) >> 4),
+        static_cast<uint8_t>(opcode & 0x00FFu),
+        static_cast<uint8_t>(opcode & 0x000Fu)
+    };
 }
 
 void Chip8::Cycle(){
-    m_Opcode = (m_Data[m_ProgramCounter] << 8u) | m_Data[m_ProgramCounter + 1];
+    (this->*m_Interpret)(1);
+}
+
+template <QuirkProfile Profile>
+void Chip8::Interpret(uint32_t cycles){
+    for (uint32_t i = 0; i < cycles; i++) {
+        Step<Profile>();
+    }
+}
+
+template <QuirkProfile Profile, typename Hooks>
+uint32_t Chip8::InterpretWithHooks(uint32_t cycles, Hooks& hooks){
+    for (uint32_t i = 0; i < cycles; i++) {
+        if (!hooks.BeforeStep(*this)) {
+            return i;
+        }
+        Step<Profile>();
+    }
+    return cycles;
+}
+
+template <typename Hooks>
+uint32_t Chip8::RunWithHooks(uint32_t cycles, Hooks& hooks){
+    // A switch rather than a member-pointer table: GCC's ASan build flags the
+    // table lookup as maybe-uninitialized
+    uint32_t executed = 0;
+    switch (m_QuirkProfile) {
+        case QuirkProfile::Modern: executed = InterpretWithHooks<QuirkProfile::Modern, Hooks>(cycles, hooks); break;
+        case QuirkProfile::Cosmac: executed = InterpretWithHooks<QuirkProfile::Cosmac, Hooks>(cycles, hooks); break;
+        case QuirkProfile::SuperChip: executed = InterpretWithHooks<QuirkProfile::SuperChip, Hooks>(cycles, hooks); break;
+        case QuirkProfile::XoChip: executed = InterpretWithHooks<QuirkProfile::XoChip, Hooks>(cycles, hooks); break;
+        case QuirkProfile::Count: break;
+    }
+    m_CycleCount += executed;
+    return executed;
+}
+
+template <QuirkProfile Profile>
+void Chip8::Step(){
+    uint16_t opcode = (m_Data[m_ProgramCounter & m_AddressMask] << 8u) | m_Data[(m_ProgramCounter + 1) & m_AddressMask];
+#if CHIP8_TRACE
+    if (m_Tracer) {
+        m_Tracer->Record({ m_ProgramCounter, opcode, m_IndexRegister, m_Register[0xF], m_StackPointer });
+    }
+#endif
+#if CHIP8_PROFILE
+    uint16_t address = m_ProgramCounter;
+    uint64_t start = Profiler::Now();
+#endif
     m_ProgramCounter += 2;
-    ExecuteOpcode(m_OpcodeTable, ((m_Opcode & 0xF000) >> 12));
+
+    Instruction ins = Decode(opcode, m_Variant, Profile);
+    ins.handler(*this, ins);
+
+#if CHIP8_PROFILE
+    OpcodeId id = DecodeOpcodeId(opcode, m_Variant);
+    m_Profiler->Record(address, id, Profiler::Now() - start);
+    if (m_ProgramCounter <= address && id != OpcodeId::OP_2nnn && id != OpcodeId::OP_00EE) {
+        m_Profiler->RecordBackwardBranch(address, m_ProgramCounter);
+    }
+#endif
+}
+
+template uint32_t Chip8::RunWithHooks<Debugger>(uint32_t cycles, Debugger& hooks);
+
+void Chip8::Run(uint32_t cycles){
+    m_CycleCount += cycles;
+
+    while (cycles > 0) {
+        // Instrumented builds execute idle loops too so that every instruction is observed
+        if (!CHIP8_INSTRUMENTED) {
+            uint32_t idle = IdleCycles(cycles);
+            m_IdleCycles += idle;
+            cycles -= idle;
+            if (cycles == 0) {
+                break;
+            }
+        }
+
+        uint32_t chunk = std::min(cycles, CyclesToIdleCheck());
+        Execute(chunk);
+        cycles -= chunk;
+    }
+}
+
+void Chip8::Execute(uint32_t cycles){
+    // Instrumented builds always interpret so that every instruction is observed.
+    // The caches, the JIT and recompiled programs only translate plain CHIP-8.
+    const bool translated = !CHIP8_INSTRUMENTED && m_Variant == Variant::Chip8;
+    if (m_Mode == ExecutionMode::BlockCache && translated) {
+        m_BlockCache->Execute(*this, cycles);
+        return;
+    }
+    if (m_Mode == ExecutionMode::Jit && translated) {
+        m_Jit->Execute(*this, cycles);
+        return;
+    }
+    if (m_Mode == ExecutionMode::Aot && translated && m_Aot && m_Aot->GetProgram().quirks == m_QuirkProfile) {
+        m_Aot->Execute(*this, cycles);
+        return;
+    }
+
+    (this->*m_Interpret)(cycles);
+}
+
+// Recognized busy-waits, each leaving the machine state exactly as it found it:
+//   Fx0A with no key down, which rewinds the PC onto itself
+//   00FD (SUPER-CHIP exit), which does the same
+//   1nnn jumping to itself
+//   L: Fx07, 3xkk/4xkk, 1L polling the delay timer, once Vx holds the timer
+//      value and the skip is not taken; whole three-instruction iterations
+//      can be skipped from anywhere in the loop
+uint32_t Chip8::IdleCycles(uint32_t cycles) const{
+    uint16_t pc = m_ProgramCounter;
+    if (pc > m_AddressMask - 1u) {
+        return 0;
+    }
+
+    // Only the first instruction is looked at unless it can be part of a pattern
+    uint16_t opcode = (m_Data[pc] << 8) | m_Data[pc + 1];
+    uint16_t head = pc;
+    switch (opcode >> 12) {
+        case 0x0:
+            return opcode == 0x00FD && m_Variant != Variant::Chip8 ? cycles : 0;
+        case 0x1:
+            if ((opcode & 0x0FFF) == pc) {
+                return cycles;
+            }
+            head = pc - 4;
+            if ((opcode & 0x0FFF) != head) {
+                return 0;
+            }
+            break;
+        case 0x3:
+        case 0x4:
+            head = pc - 2;
+            break;
+        case 0xF:
+            if ((opcode & 0xFF) == 0x0A &&
+                std::all_of(std::begin(m_Keypad), std::end(m_Keypad), [](uint8_t key) { return key == 0; })) {
+                return cycles;
+            }
+            if ((opcode & 0xFF) != 0x07) {
+                return 0;
+            }
+            break;
+        default:
+            return 0;
+    }
+
+    return IsTimerPollLoop(head) ? cycles - cycles % 3 : 0;
+}
+
+// A timer poll loop fails IdleCycles right after each tick, until Fx07 has
+// reloaded Vx. Inside one, run only until the PC is back at its head (at most
+// three instructions) so the loop is caught again in the same Run()
+uint32_t Chip8::CyclesToIdleCheck() const{
+    uint16_t pc = m_ProgramCounter;
+    if (pc > m_AddressMask - 1u) {
+        return IDLE_CHECK_INTERVAL;
+    }
+
+    // The opcode at the PC tells which loop position it would be at
+    switch (m_Data[pc] >> 4) {
+        case 0xF:
+            return IsTimerPollLoopShape(pc) ? 3 : IDLE_CHECK_INTERVAL;
+        case 0x3:
+        case 0x4:
+            return IsTimerPollLoopShape(pc - 2) ? 2 : IDLE_CHECK_INTERVAL;
+        case 0x1:
+            return IsTimerPollLoopShape(pc - 4) ? 1 : IDLE_CHECK_INTERVAL;
+        default:
+            return IDLE_CHECK_INTERVAL;
+    }
+}
+
+// L: Fx07, 3xkk/4xkk, 1L at head, whatever the registers hold
+bool Chip8::IsTimerPollLoopShape(uint16_t head) const{
+    if (head > m_AddressMask + 1u - 6) {
+        return false;
+    }
+
+    const uint8_t* code = m_Data + head;
+    uint8_t x = code[0] & 0x0F;
+    if ((code[0] & 0xF0) != 0xF0 || code[1] != 0x07) {
+        return false;
+    }
+    if (code[2] != (0x30 | x) && code[2] != (0x40 | x)) {
+        return false;
+    }
+    return code[4] == (0x10 | (head >> 8)) && code[5] == (head & 0xFF);
+}
+
+bool Chip8::IsTimerPollLoop(uint16_t head) const{
+    if (!IsTimerPollLoopShape(head)) {
+        return false;
+    }
+
+    const uint8_t* code = m_Data + head;
+    uint8_t x = code[0] & 0x0F;
+    if (m_Register[x] != m_DelayTimer) {
+        return false;
+    }
+
+    // The loop continues while the skip is not taken
+    uint8_t kk = code[3];
+    if (code[2] == (0x30 | x)) {
+        return m_DelayTimer != kk;
+    }
+    return m_DelayTimer == kk;
 }
 
-void Chip8::DecrementTimers(std::function<void()> beepCallback){
+void Chip8::DecrementTimers(){
     if (m_DelayTimer > 0) {
         m_DelayTimer--;
     }
 
     if (m_SoundTimer > 0) {
-        if (m_SoundTimer == 1) 
-            beepCallback();
         m_SoundTimer--;
     }
 }
@@ -0,0 +1,39 @@
+#include "chip8_c.h"
+#include "environment.hpp"
+#include <exception>
+
+struct chip8_env {
+    Chip8Emulator::Environment environment;
+};
+
+extern "C" {
+
+chip8_env* chip8_env_create(size_t count, const char* rom_path) {
+    try {
+        return new chip8_env{ Chip8Emulator::Environment(count, rom_path) };
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void chip8_env_destroy(chip8_env* env) {
+    delete env;
+}
+
+size_t chip8_env_count(const chip8_env* env) {
+    return env->environment.GetCount();
+}
+
+size_t chip8_env_step(chip8_env* env, const uint16_t* keys, unsigned int frames) {
+    return env->environment.Step(keys, frames);
+}
+
+const uint64_t* const* chip8_env_framebuffers(const chip8_env* env) {
+    return env->environment.GetFramebuffers();
+}
+
+void chip8_env_reset(chip8_env* env, const uint8_t* mask) {
+    env->environment.Reset(mask);
+}
+
+}
@@ -0,0 +1,260 @@
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "chip8.hpp"
+#include "debugger.hpp"
+#include "gdb_stub.hpp"
+#include "input_log.hpp"
+#include <getopt.h>
+
+constexpr int CYCLES_PER_FRAME = 10;
+constexpr uint64_t DEFAULT_CONTINUE_FRAMES = 60 * 60; // One emulated minute
+
+void PrintStop(Chip8Emulator::Debugger& debugger, const Chip8Emulator::StopInfo& stop) {
+    using Chip8Emulator::StopReason;
+
+    char line[64];
+    switch (stop.reason) {
+        case StopReason::Breakpoint:
+            std::cout << "Breakpoint\n";
+            break;
+        case StopReason::Watchpoint:
+            snprintf(line, sizeof(line), "Watchpoint: %s 0x%04X\n",
+                     stop.access == Chip8Emulator::WATCH_WRITE ? "write to" : "read of", stop.address);
+            std::cout << line;
+            break;
+        case StopReason::Limit:
+            std::cout << "Cycle limit reached\n";
+            break;
+        case StopReason::Step:
+            break;
+    }
+    std::cout << debugger.Disassembly(debugger.GetProgramCounter(), 1);
+}
+
+void PrintRegisters(const Chip8Emulator::Debugger& debugger) {
+    char line[64];
+    for (unsigned int reg = 0; reg < Chip8Emulator::REGISTER_COUNT; reg++) {
+        snprintf(line, sizeof(line), "V%X=%02X%s", reg, debugger.GetRegister(reg), reg % 8 == 7 ? "\n" : " ");
+        std::cout << line;
+    }
+    snprintf(line, sizeof(line), "I=%04X PC=%04X SP=%X DT=%02X ST=%02X\n", debugger.GetIndex(),
+             debugger.GetProgramCounter(), debugger.GetStackPointer(), debugger.GetDelayTimer(), debugger.GetSoundTimer());
+    std::cout << line;
+}
+
+void PrintMemory(const Chip8Emulator::Debugger& debugger, uint32_t address, uint32_t length) {
+    char text[16];
+    for (uint32_t i = 0; i < length; i++) {
+        if (i % 16 == 0) {
+            snprintf(text, sizeof(text), "%s0x%04X:", i == 0 ? "" : "\n", address + i);
+            std::cout << text;
+        }
+        snprintf(text, sizeof(text), " %02X", debugger.ReadMemory(static_cast<uint16_t>(address + i)));
+        std::cout << text;
+    }
+    std::cout << "\n";
+}
+
+// Reads commands from stdin until quit or end of input
+void RunConsole(Chip8Emulator::Debugger& debugger, uint32_t cyclesPerFrame) {
+    using namespace Chip8Emulator;
+
+    std::cout << debugger.Disassembly(debugger.GetProgramCounter(), 1);
+    std::string input;
+    while (std::cout << "(chip8) " << std::flush, std::getline(std::cin, input)) {
+        std::istringstream words(input);
+        std::string command;
+        words >> command;
+        if (command.empty()) {
+            continue;
+        }
+
+        std::string rest;
+        std::getline(words >> std::ws, rest);
+        std::istringstream numbers(rest);
+        numbers >> std::setbase(0);
+
+        try {
+            if (command == "break" || command == "b") {
+                RegisterCondition condition;
+                size_t at = rest.find("if");
+                bool conditional = at != std::string::npos;
+                if (conditional && !ParseRegisterCondition(rest.substr(at + 2), condition)) {
+                    std::cout << "Bad condition, e.g. V3 == 5 or I >= 0x300\n";
+                    continue;
+                }
+                uint32_t address;
+                if (at == 0) {
+                    debugger.AddBreakpoint(condition);
+                } else if (numbers >> address) {
+                    if (conditional) {
+                        debugger.AddBreakpoint(static_cast<uint16_t>(address), condition);
+                    } else {
+                        debugger.AddBreakpoint(static_cast<uint16_t>(address));
+                    }
+                } else {
+                    std::cout << "Usage: break <address> [if <condition>] | break if <condition>\n";
+                }
+            } else if (command == "delete" || command == "d") {
+                uint32_t address;
+                if (rest == "if") {
+                    debugger.RemoveConditionBreakpoints();
+                } else if (!(numbers >> address) || !debugger.RemoveBreakpoint(static_cast<uint16_t>(address))) {
+                    std::cout << "No breakpoint there\n";
+                }
+            } else if (command == "watch" || command == "rwatch" || command == "awatch" || command == "unwatch") {
+                uint32_t address, length = 1;
+                if (!(numbers >> address)) {
+                    std::cout << "Usage: " << command << " <address> [length]\n";
+                    continue;
+                }
+                numbers >> length;
+                if (command == "unwatch") {
+                    bool removed = false;
+                    for (uint8_t kind : { WATCH_READ, WATCH_WRITE, WATCH_ACCESS }) {
+                        removed |= debugger.RemoveWatchpoint(static_cast<uint16_t>(address), static_cast<uint16_t>(length), kind);
+                    }
+                    if (!removed) {
+                        std::cout << "No watchpoint there\n";
+                    }
+                } else {
+                    uint8_t kind = command == "watch" ? WATCH_WRITE : command == "rwatch" ? WATCH_READ : WATCH_ACCESS;
+                    debugger.AddWatchpoint(static_cast<uint16_t>(address), static_cast<uint16_t>(length), kind);
+                }
+            } else if (command == "step" || command == "s") {
+                uint32_t count = 1;
+                numbers >> count;
+                StopInfo stop{ StopReason::Step, 0, 0 };
+                for (uint32_t i = 0; i < count && stop.reason == StopReason::Step; i++) {
+                    stop = debugger.Step();
+                }
+                PrintStop(debugger, stop);
+            } else if (command == "next" || command == "n") {
+                PrintStop(debugger, debugger.StepOver(DEFAULT_CONTINUE_FRAMES * cyclesPerFrame));
+            } else if (command == "continue" || command == "c") {
+                uint64_t cycles = DEFAULT_CONTINUE_FRAMES * cyclesPerFrame;
+                numbers >> cycles;
+                PrintStop(debugger, debugger.Continue(cycles));
+            } else if (command == "regs" || command == "r") {
+                PrintRegisters(debugger);
+            } else if (command == "disasm" || command == "l") {
+                uint32_t address = debugger.GetProgramCounter(), count = 10;
+                numbers >> address >> count;
+                std::cout << debugger.Disassembly(static_cast<uint16_t>(address), count);
+            } else if (command == "x") {
+                uint32_t address, length = 16;
+                if (!(numbers >> address)) {
+                    std::cout << "Usage: x <address> [length]\n";
+                    continue;
+                }
+                numbers >> length;
+                PrintMemory(debugger, address, length);
+            } else if (command == "keys") {
+                uint32_t keys = 0;
+                numbers >> keys;
+                UnpackKeys(static_cast<uint16_t>(keys), debugger.GetMachine().getKeypad());
+            } else if (command == "quit" || command == "q") {
+                return;
+            } else {
+                std::cout << "Commands: break, delete, watch, rwatch, awatch, unwatch, step, next, continue,\n"
+                          << "          regs, disasm, x, keys, quit\n";
+            }
+        } catch (const std::runtime_error& e) {
+            std::cout << "Machine stopped: " << e.what() << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+    int cyclesPerFrame = CYCLES_PER_FRAME;
+    Chip8Emulator::Variant variant = Chip8Emulator::Variant::Chip8;
+    Chip8Emulator::QuirkProfile quirks{};
+    bool quirksSet = false;
+    const char* socketPath = nullptr;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"seed", required_argument, 0, 's'},
+        {"cycles-per-frame", required_argument, 0, 'p'},
+        {"variant", required_argument, 0, 'V'},
+        {"quirks", required_argument, 0, 'q'},
+        {"gdb", required_argument, 0, 'g'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    bool validOptions = true;
+    while ((opt = getopt_long(argc, argv, "s:p:V:q:g:", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 's':
+                seed = std::stoull(optarg);
+                break;
+            case 'p':
+                cyclesPerFrame = std::stoi(optarg);
+                break;
+            case 'V':
+                validOptions &= Chip8Emulator::ParseVariant(optarg, variant);
+                break;
+            case 'q':
+                validOptions &= Chip8Emulator::ParseQuirkProfile(optarg, quirks);
+                quirksSet = true;
+                break;
+            case 'g':
+                socketPath = optarg;
+                break;
+            default:
+                validOptions = false;
+                break;
+        }
+    }
+
+    if (!validOptions || optind != argc - 1 || cyclesPerFrame <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [options] <ROM file>\n"
+                  << "Debugs a ROM from a command prompt, or for a GDB client with --gdb\n"
+                  << "Options:\n"
+                  << "  --seed <n>              Seed the random number generator\n"
+                  << "  --cycles-per-frame <n>  CPU cycles per 60 Hz timer tick (default: 10)\n"
+                  << "  --variant <name>        chip8, schip or xochip (default: chip8)\n"
+                  << "  --quirks <name>         modern, cosmac, schip or xochip (default: the variant's)\n"
+                  << "  --gdb <socket>          Serve the GDB remote protocol on this Unix socket\n";
+        return 1;
+    }
+
+    Chip8Emulator::Chip8 chip8(seed);
+    try {
+        chip8.SetVariant(variant);
+        if (quirksSet) {
+            chip8.SetQuirkProfile(quirks);
+        }
+        chip8.LoadROM(argv[optind]);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to load ROM: " << e.what() << "\n";
+        return 1;
+    }
+
+    Chip8Emulator::Debugger debugger(chip8, static_cast<uint32_t>(cyclesPerFrame));
+    if (socketPath == nullptr) {
+        RunConsole(debugger, static_cast<uint32_t>(cyclesPerFrame));
+        return 0;
+    }
+
+    try {
+        Chip8Emulator::GdbStub stub(debugger, socketPath);
+        std::cout << "Waiting for GDB on " << socketPath << " (target remote " << socketPath << ")\n";
+        // A detached client leaves the machine as it is for the next one
+        while (stub.Serve()) {
+            std::cout << "Detached; waiting for GDB\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+#include "debugger.hpp"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include "disassembler.hpp"
+
+namespace Chip8Emulator{
+
+bool ParseRegisterCondition(const std::string& text, RegisterCondition& condition) {
+    std::string s;
+    for (char c : text) {
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+            s += c;
+        }
+    }
+
+    size_t pos = 0;
+    if (s.size() >= 2 && (s[0] == 'V' || s[0] == 'v') && std::isxdigit(static_cast<unsigned char>(s[1]))) {
+        condition.reg = static_cast<uint8_t>(std::stoul(s.substr(1, 1), nullptr, 16));
+        pos = 2;
+    } else if (!s.empty() && (s[0] == 'I' || s[0] == 'i')) {
+        condition.reg = REGISTER_I;
+        pos = 1;
+    } else {
+        return false;
+    }
+
+    static const struct {
+        const char* text;
+        Compare compare;
+    } OPERATORS[] = {
+        { "==", Compare::Equal }, { "!=", Compare::NotEqual }, { "<=", Compare::LessEqual },
+        { ">=", Compare::GreaterEqual }, { "<", Compare::Less }, { ">", Compare::Greater },
+    };
+    bool found = false;
+    for (const auto& op : OPERATORS) {
+        if (s.compare(pos, std::char_traits<char>::length(op.text), op.text) == 0) {
+            condition.compare = op.compare;
+            pos += std::char_traits<char>::length(op.text);
+            found = true;
+            break;
+        }
+    }
+    if (!found || pos == s.size()) {
+        return false;
+    }
+
+    char* end = nullptr;
+    unsigned long value = std::strtoul(s.c_str() + pos, &end, 0);
+    if (*end != '\0' || value > (condition.reg == REGISTER_I ? 0xFFFFul : 0xFFul)) {
+        return false;
+    }
+    condition.value = static_cast<uint16_t>(value);
+    return true;
+}
+
+std::string FormatRegisterCondition(const RegisterCondition& condition) {
+    static const char* const OPERATORS[] = { "==", "!=", "<", "<=", ">", ">=" };
+    char text[32];
+    if (condition.reg == REGISTER_I) {
+        snprintf(text, sizeof(text), "I %s 0x%03X", OPERATORS[static_cast<size_t>(condition.compare)], condition.value);
+    } else {
+        snprintf(text, sizeof(text), "V%X %s %u", condition.reg, OPERATORS[static_cast<size_t>(condition.compare)],
+                 condition.value);
+    }
+    return text;
+}
+
+Debugger::Debugger(Chip8& chip8, uint32_t cyclesPerFrame)
+: m_Chip8(chip8),
+  m_CyclesPerFrame(std::max<uint32_t>(cyclesPerFrame, 1)),
+  m_BreakAt(MAX_MEMORY_SIZE),
+  m_Watched(MAX_MEMORY_SIZE)
+{
+}
+
+void Debugger::AddBreakpoint(uint16_t address) {
+    m_Breakpoints.push_back({ address, false, false, {} });
+    m_BreakAt[address] = 1;
+}
+
+void Debugger::AddBreakpoint(uint16_t address, const RegisterCondition& condition) {
+    m_Breakpoints.push_back({ address, false, true, condition });
+    m_BreakAt[address] = 1;
+}
+
+void Debugger::AddBreakpoint(const RegisterCondition& condition) {
+    m_Breakpoints.push_back({ 0, true, true, condition });
+    m_HasAnywhere = true;
+}
+
+bool Debugger::RemoveBreakpoint(uint16_t address) {
+    auto removed = std::remove_if(m_Breakpoints.begin(), m_Breakpoints.end(),
+                                  [address](const Breakpoint& b) { return !b.anywhere && b.address == address; });
+    bool found = removed != m_Breakpoints.end();
+    m_Breakpoints.erase(removed, m_Breakpoints.end());
+    m_BreakAt[address] = 0;
+    return found;
+}
+
+void Debugger::RemoveConditionBreakpoints() {
+    std::erase_if(m_Breakpoints, [](const Breakpoint& b) { return b.anywhere; });
+    m_HasAnywhere = false;
+}
+
+void Debugger::AddWatchpoint(uint16_t address, uint16_t length, uint8_t kind) {
+    m_Watchpoints.push_back({ address, std::max<uint16_t>(length, 1), kind });
+    RebuildWatched();
+}
+
+bool Debugger::RemoveWatchpoint(uint16_t address, uint16_t length, uint8_t kind) {
+    length = std::max<uint16_t>(length, 1);
+    size_t erased = std::erase_if(m_Watchpoints, [&](const Watchpoint& w) {
+        return w.address == address && w.length == length && w.kind == kind;
+    });
+    RebuildWatched();
+    return erased > 0;
+}
+
+void Debugger::ClearAll() {
+    m_Breakpoints.clear();
+    std::fill(m_BreakAt.begin(), m_BreakAt.end(), 0);
+    m_HasAnywhere = false;
+    m_Watchpoints.clear();
+    RebuildWatched();
+}
+
+void Debugger::RebuildWatched() {
+    std::fill(m_Watched.begin(), m_Watched.end(), 0);
+    for (const auto& watch : m_Watchpoints) {
+        for (uint32_t i = 0; i < watch.length; i++) {
+            m_Watched[(watch.address + i) % MAX_MEMORY_SIZE] |= watch.kind;
+        }
+    }
+}
+
+StopInfo Debugger::Step() {
+    StopInfo stop = Run(1);
+    if (stop.reason == StopReason::Limit) {
+        stop.reason = StopReason::Step;
+    }
+    return stop;
+}
+
+StopInfo Debugger::StepOver(uint64_t maxCycles) {
+    uint16_t pc = m_Chip8.m_ProgramCounter;
+    uint16_t opcode = (ReadMemory(pc) << 8) | ReadMemory(pc + 1);
+    if ((opcode & 0xF000) != 0x2000) {
+        return Step();
+    }
+
+    // Returning pops the stack back to this depth with the PC just past the call
+    m_SteppingOver = true;
+    m_ReturnAddress = pc + 2;
+    m_ReturnDepth = m_Chip8.m_StackPointer;
+    StopInfo stop{};
+    try {
+        stop = Run(maxCycles);
+    } catch (...) {
+        m_SteppingOver = false;
+        throw;
+    }
+    m_SteppingOver = false;
+    return stop;
+}
+
+StopInfo Debugger::Continue(uint64_t maxCycles) {
+    return Run(maxCycles);
+}
+
+StopInfo Debugger::Run(uint64_t maxCycles) {
+    m_Resuming = true;
+    m_Stopped = false;
+    m_WatchHit = false;
+
+    while (maxCycles > 0 && !m_Stopped) {
+        uint32_t chunk = static_cast<uint32_t>(std::min<uint64_t>(maxCycles, m_CyclesPerFrame - m_FrameCycle));
+        uint32_t executed = m_Chip8.RunWithHooks(chunk, *this);
+        maxCycles -= executed;
+
+        m_FrameCycle += executed;
+        if (m_FrameCycle == m_CyclesPerFrame) {
+            m_Chip8.DecrementTimers();
+            m_FrameCycle = 0;
+        }
+
+        // A watchpoint hit by the last instruction of the chunk
+        if (m_WatchHit) {
+            m_Stopped = true;
+        }
+    }
+
+    m_Resuming = false;
+    m_WatchHit = false;
+    return m_Stopped ? m_Stop : StopInfo{ StopReason::Limit, 0, 0 };
+}
+
+bool Debugger::Holds(const RegisterCondition& condition) const {
+    uint16_t value = condition.reg == REGISTER_I ? m_Chip8.m_IndexRegister : m_Chip8.m_Register[condition.reg & 0xF];
+    switch (condition.compare) {
+        case Compare::Equal: return value == condition.value;
+        case Compare::NotEqual: return value != condition.value;
+        case Compare::Less: return value < condition.value;
+        case Compare::LessEqual: return value <= condition.value;
+        case Compare::Greater: return value > condition.value;
+        case Compare::GreaterEqual: return value >= condition.value;
+    }
+    return false;
+}
+
+Debugger::Access Debugger::FindAccess(const Chip8& chip8) {
+    const uint16_t mask = chip8.m_AddressMask;
+    const uint16_t pc = chip8.m_ProgramCounter;
+    const uint16_t opcode = (chip8.m_Data[pc & mask] << 8) | chip8.m_Data[(pc + 1) & mask];
+    const uint16_t index = chip8.m_IndexRegister;
+    const unsigned int x = (opcode >> 8) & 0xF;
+    const unsigned int y = (opcode >> 4) & 0xF;
+    const unsigned int n = opcode & 0xF;
+
+    switch (DecodeOpcodeId(opcode, chip8.m_Variant)) {
+        case OpcodeId::OP_Dxyn: {
+            // Each selected plane reads its own sprite, one after the other
+            bool large = n == 0 && chip8.m_Variant != Variant::Chip8;
+            unsigned int planes = std::popcount(static_cast<unsigned int>(chip8.m_PlaneMask) & 0xF);
+            return { index, static_cast<uint16_t>((large ? 32 : n) * planes), WATCH_READ };
+        }
+        case OpcodeId::OP_Fx33:
+            return { index, 3, WATCH_WRITE };
+        case OpcodeId::OP_Fx55:
+            return { index, static_cast<uint16_t>(x + 1), WATCH_WRITE };
+        case OpcodeId::OP_Fx65:
+            return { index, static_cast<uint16_t>(x + 1), WATCH_READ };
+        case OpcodeId::OP_5xy2:
+            return { index, static_cast<uint16_t>((x > y ? x - y : y - x) + 1), WATCH_WRITE };
+        case OpcodeId::OP_5xy3:
+            return { index, static_cast<uint16_t>((x > y ? x - y : y - x) + 1), WATCH_READ };
+        case OpcodeId::OP_F002:
+            return { index, AUDIO_PATTERN_SIZE, WATCH_READ };
+        default:
+            return { 0, 0, 0 };
+    }
+}
+
+bool Debugger::BeforeStep(const Chip8& chip8) {
+    // Watchpoints report once the access has happened
+    if (m_WatchHit) {
+        m_Stopped = true;
+        return false;
+    }
+
+    const uint16_t pc = chip8.m_ProgramCounter;
+    const bool resuming = std::exchange(m_Resuming, false);
+
+    if (m_SteppingOver && pc == m_ReturnAddress && chip8.m_StackPointer == m_ReturnDepth && !resuming) {
+        m_Stop = { StopReason::Step, 0, 0 };
+        m_Stopped = true;
+        return false;
+    }
+
+    if (!resuming && (m_BreakAt[pc & chip8.m_AddressMask] || m_HasAnywhere)) {
+        for (const auto& breakpoint : m_Breakpoints) {
+            bool here = breakpoint.anywhere || breakpoint.address == (pc & chip8.m_AddressMask);
+            if (here && (!breakpoint.conditional || Holds(breakpoint.condition))) {
+                m_Stop = { StopReason::Breakpoint, pc, 0 };
+                m_Stopped = true;
+                return false;
+            }
+        }
+    }
+
+    if (!m_Watchpoints.empty()) {
+        Access access = FindAccess(chip8);
+        for (uint32_t i = 0; i < access.length; i++) {
+            uint16_t address = (access.address + i) & chip8.m_AddressMask;
+            if (m_Watched[address] & access.kind) {
+                m_Stop = { StopReason::Watchpoint, address, access.kind };
+                m_WatchHit = true;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void Debugger::WriteMemory(uint16_t address, const uint8_t* data, uint16_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        uint16_t target = (address + i) & m_Chip8.m_AddressMask;
+        m_Chip8.m_Data[target] = data[i];
+        m_Chip8.OnMemoryWrite(target, 1);
+    }
+}
+
+std::string Debugger::Disassembly(uint16_t address, unsigned int count) const {
+    std::string text;
+    uint32_t pc = address;
+    for (unsigned int line = 0; line < count; line++) {
+        uint16_t at = pc & m_Chip8.m_AddressMask;
+        uint16_t opcode = (ReadMemory(at) << 8) | ReadMemory(at + 1);
+        uint16_t next = (ReadMemory(at + 2) << 8) | ReadMemory(at + 3);
+        unsigned int length = InstructionLength(opcode, m_Chip8.m_Variant);
+
+        char prefix[32];
+        snprintf(prefix, sizeof(prefix), "%s%c0x%04X  %04X  ", at == m_Chip8.m_ProgramCounter ? "=>" : "  ",
+                 m_BreakAt[at] ? '*' : ' ', at, opcode);
+        text += prefix;
+        text += Disassemble(opcode, m_Chip8.m_Variant, next);
+        text += '\n';
+        pc += length;
+    }
+    return text;
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,178 @@
+#include "disassembler.hpp"
+#include "block_cache.hpp"
+#include <cstdio>
+
+namespace Chip8Emulator{
+
+namespace {
+
+bool IsSkip(OpcodeId id) {
+    switch (id) {
+        case OpcodeId::OP_3xkk:
+        case OpcodeId::OP_4xkk:
+        case OpcodeId::OP_5xy0:
+        case OpcodeId::OP_9xy0:
+        case OpcodeId::OP_Ex9E:
+        case OpcodeId::OP_ExA1:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Paths end here: the next instruction is not known statically, or there is none
+bool EndsPath(OpcodeId id) {
+    return id == OpcodeId::OP_00EE || id == OpcodeId::OP_1nnn || id == OpcodeId::OP_Bnnn ||
+           id == OpcodeId::OP_00FD;
+}
+
+} // namespace
+
+std::string Disassemble(uint16_t opcode, Variant variant, uint16_t next) {
+    const unsigned int x = (opcode >> 8) & 0xF;
+    const unsigned int y = (opcode >> 4) & 0xF;
+    const unsigned int n = opcode & 0xF;
+    const unsigned int kk = opcode & 0xFF;
+    const unsigned int nnn = opcode & 0xFFF;
+
+    char text[32];
+    switch (DecodeOpcodeId(opcode, variant)) {
+        case OpcodeId::OP_00E0: return "CLS";
+        case OpcodeId::OP_00EE: return "RET";
+        case OpcodeId::OP_1nnn: snprintf(text, sizeof(text), "JP 0x%03X", nnn); break;
+        case OpcodeId::OP_2nnn: snprintf(text, sizeof(text), "CALL 0x%03X", nnn); break;
+        case OpcodeId::OP_3xkk: snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, kk); break;
+        case OpcodeId::OP_4xkk: snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, kk); break;
+        case OpcodeId::OP_5xy0: snprintf(text, sizeof(text), "SE V%X, V%X", x, y); break;
+        case OpcodeId::OP_6xkk: snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, kk); break;
+        case OpcodeId::OP_7xkk: snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, kk); break;
+        case OpcodeId::OP_8xy0: snprintf(text, sizeof(text), "LD V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy1: snprintf(text, sizeof(text), "OR V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy2: snprintf(text, sizeof(text), "AND V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy3: snprintf(text, sizeof(text), "XOR V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy4: snprintf(text, sizeof(text), "ADD V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy5: snprintf(text, sizeof(text), "SUB V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy6: snprintf(text, sizeof(text), "SHR V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xy7: snprintf(text, sizeof(text), "SUBN V%X, V%X", x, y); break;
+        case OpcodeId::OP_8xyE: snprintf(text, sizeof(text), "SHL V%X, V%X", x, y); break;
+        case OpcodeId::OP_9xy0: snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+        case OpcodeId::OP_Annn: snprintf(text, sizeof(text), "LD I, 0x%03X", nnn); break;
+        case OpcodeId::OP_Bnnn: snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn); break;
+        case OpcodeId::OP_Cxkk: snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, kk); break;
+        case OpcodeId::OP_Dxyn: snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n); break;
+        case OpcodeId::OP_Ex9E: snprintf(text, sizeof(text), "SKP V%X", x); break;
+        case OpcodeId::OP_ExA1: snprintf(text, sizeof(text), "SKNP V%X", x); break;
+        case OpcodeId::OP_Fx07: snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+        case OpcodeId::OP_Fx0A: snprintf(text, sizeof(text), "LD V%X, K", x); break;
+        case OpcodeId::OP_Fx15: snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+        case OpcodeId::OP_Fx18: snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+        case OpcodeId::OP_Fx1E: snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+        case OpcodeId::OP_Fx29: snprintf(text, sizeof(text), "LD F, V%X", x); break;
+        case OpcodeId::OP_Fx33: snprintf(text, sizeof(text), "LD B, V%X", x); break;
+        case OpcodeId::OP_Fx55: snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+        case OpcodeId::OP_Fx65: snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+        case OpcodeId::OP_00Cn: snprintf(text, sizeof(text), "SCD %u", n); break;
+        case OpcodeId::OP_00FB: return "SCR";
+        case OpcodeId::OP_00FC: return "SCL";
+        case OpcodeId::OP_00FD: return "EXIT";
+        case OpcodeId::OP_00FE: return "LOW";
+        case OpcodeId::OP_00FF: return "HIGH";
+        case OpcodeId::OP_Fx30: snprintf(text, sizeof(text), "LD HF, V%X", x); break;
+        case OpcodeId::OP_Fx75: snprintf(text, sizeof(text), "LD R, V%X", x); break;
+        case OpcodeId::OP_Fx85: snprintf(text, sizeof(text), "LD V%X, R", x); break;
+        case OpcodeId::OP_00Dn: snprintf(text, sizeof(text), "SCU %u", n); break;
+        case OpcodeId::OP_5xy2: snprintf(text, sizeof(text), "SAVE V%X - V%X", x, y); break;
+        case OpcodeId::OP_5xy3: snprintf(text, sizeof(text), "LOAD V%X - V%X", x, y); break;
+        case OpcodeId::OP_F000: snprintf(text, sizeof(text), "LD I, 0x%04X", next); break;
+        case OpcodeId::OP_Fn01: snprintf(text, sizeof(text), "PLANE %u", x); break;
+        case OpcodeId::OP_F002: return "AUDIO";
+        case OpcodeId::OP_Fx3A: snprintf(text, sizeof(text), "PITCH V%X", x); break;
+        default: snprintf(text, sizeof(text), "DW 0x%04X", opcode); break;
+    }
+    return text;
+}
+
+unsigned int InstructionLength(uint16_t opcode, Variant variant) {
+    return variant == Variant::XoChip && opcode == 0xF000 ? 4 : 2;
+}
+
+std::vector<BasicBlock> FindBasicBlocks(const uint8_t* rom, size_t size, Variant variant) {
+    auto word = [&](uint32_t address) -> int {
+        size_t offset = address - START_ADDR;
+        if (address < START_ADDR || offset + 1 >= size) {
+            return -1;
+        }
+        return (rom[offset] << 8) | rom[offset + 1];
+    };
+
+    // Instruction starts reached, and the addresses that begin a block
+    std::vector<bool> code(MAX_MEMORY_SIZE);
+    std::vector<bool> leader(MAX_MEMORY_SIZE);
+    std::vector<uint32_t> pending;
+    auto branch = [&](uint32_t target) {
+        if (target < MAX_MEMORY_SIZE) {
+            leader[target] = true;
+            pending.push_back(target);
+        }
+    };
+
+    branch(START_ADDR);
+    while (!pending.empty()) {
+        uint32_t pc = pending.back();
+        pending.pop_back();
+
+        while (pc < MAX_MEMORY_SIZE && !code[pc]) {
+            int opcode = word(pc);
+            OpcodeId id = opcode < 0 ? OpcodeId::Unknown : DecodeOpcodeId(opcode, variant);
+            if (id == OpcodeId::Unknown) {
+                break; // Ran into data or off the image
+            }
+            code[pc] = true;
+
+            uint32_t next = pc + InstructionLength(opcode, variant);
+            if (EndsPath(id)) {
+                if (id == OpcodeId::OP_1nnn) {
+                    branch(opcode & 0x0FFF);
+                }
+                break;
+            }
+            if (id == OpcodeId::OP_2nnn) {
+                branch(opcode & 0x0FFF);
+                branch(next);
+                break;
+            }
+            if (IsSkip(id)) {
+                int skipped = word(next);
+                branch(next);
+                branch(next + (skipped < 0 ? 2 : InstructionLength(skipped, variant)));
+                break;
+            }
+            if (EndsBlock(id)) {
+                branch(next);
+                break;
+            }
+            pc = next;
+        }
+    }
+
+    std::vector<BasicBlock> blocks;
+    for (uint32_t start = 0; start < MAX_MEMORY_SIZE; start++) {
+        if (!leader[start] || !code[start]) {
+            continue;
+        }
+
+        uint32_t pc = start;
+        while (true) {
+            int opcode = word(pc);
+            OpcodeId id = DecodeOpcodeId(opcode, variant);
+            pc += InstructionLength(opcode, variant);
+            if (EndsPath(id) || EndsBlock(id) || pc >= MAX_MEMORY_SIZE || !code[pc] || leader[pc]) {
+                break;
+            }
+        }
+        blocks.push_back({ start, pc });
+    }
+    return blocks;
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,201 @@
+#include "emulation_thread.hpp"
+#include "audio.hpp"
+#include "capture.hpp"
+#include "input_log.hpp"
+#include "rewind.hpp"
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace Chip8Emulator{
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// How often turbo mode refreshes the effective clock rate
+constexpr std::chrono::milliseconds TURBO_REPORT_INTERVAL{250};
+
+Clock::time_point TickTime(Clock::time_point epoch, uint64_t tick) {
+    return epoch + std::chrono::nanoseconds(tick * 1'000'000'000ULL / TIMER_FREQUENCY);
+}
+
+} // namespace
+
+void CopyDisplay(const Chip8& chip8, Frame& frame) {
+    frame.width = static_cast<uint16_t>(chip8.GetDisplayWidth());
+    frame.height = static_cast<uint16_t>(chip8.GetDisplayHeight());
+    frame.planeCount = static_cast<uint8_t>(chip8.GetPlaneCount());
+    for (unsigned int plane = 0; plane < frame.planeCount; plane++) {
+        std::memcpy(frame.planes[plane], chip8.GetPlane(plane),
+                    frame.height * chip8.GetDisplayRowWords() * sizeof(uint64_t));
+    }
+    frame.cycle = chip8.GetCycleCount();
+}
+
+EmulationThread::EmulationThread(Chip8& chip8, uint32_t cyclesPerFrame, bool deterministic, InputRecorder* recorder,
+                                 ToneGenerator* tone, FrameCapture* capture)
+: m_Chip8(chip8),
+  m_CyclesPerFrame(cyclesPerFrame),
+  m_Deterministic(deterministic || recorder != nullptr),
+  m_Recorder(recorder),
+  m_Tone(tone),
+  m_Capture(capture)
+{
+}
+
+EmulationThread::~EmulationThread() {
+    m_StopRequested.store(true, std::memory_order_relaxed);
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+}
+
+void EmulationThread::Start() {
+    m_StopRequested.store(false, std::memory_order_relaxed);
+    m_Running.store(true, std::memory_order_release);
+    m_Thread = std::thread(&EmulationThread::Main, this);
+}
+
+void EmulationThread::Stop() {
+    m_StopRequested.store(true, std::memory_order_relaxed);
+    if (m_Thread.joinable()) {
+        m_Thread.join();
+    }
+
+    if (m_Error) {
+        std::rethrow_exception(std::exchange(m_Error, nullptr));
+    }
+}
+
+void EmulationThread::Main() {
+    try {
+        // The first frame is always published so the renderer has something to show
+        PublishFrame();
+
+        RunLoop();
+    } catch (...) {
+        m_Error = std::current_exception();
+    }
+
+    if (m_Tone) {
+        m_Tone->SetPlaying(false);
+    }
+    m_Running.store(false, std::memory_order_release);
+}
+
+double EmulationThread::GetAverageTurboHz() const {
+    uint64_t nanoseconds = m_TurboNanoseconds.load(std::memory_order_relaxed);
+    if (nanoseconds == 0) {
+        return 0.0;
+    }
+    return m_TurboCycles.load(std::memory_order_relaxed) * 1e9 / nanoseconds;
+}
+
+void EmulationThread::RunLoop() {
+    RewindBuffer rewind;
+    MachineState state;
+
+    auto epoch = Clock::now();
+    uint64_t tick = 0;
+    bool wasTurbo = false;
+    auto windowStart = epoch;
+    uint64_t windowCycles = 0;
+
+    while (!m_StopRequested.load(std::memory_order_relaxed)) {
+        bool rewinding = !m_Deterministic && m_Rewinding.load(std::memory_order_relaxed);
+        bool turbo = !rewinding && m_Turbo.load(std::memory_order_relaxed);
+        if (turbo != wasTurbo) {
+            auto now = Clock::now();
+            if (wasTurbo) {
+                m_TurboCycles.fetch_add(windowCycles, std::memory_order_relaxed);
+                m_TurboNanoseconds.fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - windowStart).count(), std::memory_order_relaxed);
+            }
+            epoch = windowStart = now;
+            tick = windowCycles = 0;
+            wasTurbo = turbo;
+        }
+
+        // Holding rewind steps back one recorded state per tick, silently
+        if (rewinding) {
+            if (rewind.Pop(state)) {
+                m_Chip8.LoadState(state);
+            }
+            if (m_Tone) {
+                m_Tone->SetPlaying(false);
+            }
+        } else {
+            Tick();
+            if (!m_Deterministic && !turbo) {
+                m_Chip8.SaveState(state);
+                rewind.Push(state);
+            }
+            PublishSound();
+        }
+        PublishFrame();
+        if (m_Capture) {
+            m_Capture->Capture(m_Chip8);
+        }
+
+        if (turbo) {
+            windowCycles += m_CyclesPerFrame;
+            auto now = Clock::now();
+            if (now - windowStart >= TURBO_REPORT_INTERVAL) {
+                uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - windowStart).count();
+                m_EffectiveHz.store(windowCycles * 1e9 / elapsed, std::memory_order_relaxed);
+                m_TurboCycles.fetch_add(windowCycles, std::memory_order_relaxed);
+                m_TurboNanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+                windowStart = now;
+                windowCycles = 0;
+            }
+            continue;
+        }
+
+        // Late ticks run back to back until caught up, so the timers never fall behind
+        auto due = TickTime(epoch, ++tick);
+        auto now = Clock::now();
+        if (now - due > MAX_SCHEDULE_LAG) {
+            epoch = now;
+            tick = 0;
+        } else {
+            std::this_thread::sleep_until(due);
+        }
+    }
+}
+
+void EmulationThread::Tick() {
+    uint16_t keys = m_Keys.load(std::memory_order_relaxed);
+    if (m_Recorder) {
+        m_Recorder->Record(m_Chip8.GetCycleCount(), keys);
+    }
+    UnpackKeys(keys, m_Chip8.getKeypad());
+
+    m_Chip8.Run(m_CyclesPerFrame);
+    m_Chip8.DecrementTimers();
+}
+
+void EmulationThread::PublishFrame() {
+    if (!m_Chip8.IsDisplayDirty()) {
+        return;
+    }
+
+    CopyDisplay(m_Chip8, m_Frames.Back());
+    m_Frames.Publish();
+    m_Chip8.ClearDisplayDirty();
+}
+
+void EmulationThread::PublishSound() {
+    if (!m_Tone) {
+        return;
+    }
+
+    // Pattern changes only matter while the buzzer sounds
+    bool playing = m_Chip8.GetSoundTimer() > 0;
+    if (playing) {
+        m_Tone->SetTone(CurrentTone(m_Chip8));
+    }
+    m_Tone->SetPlaying(playing);
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,92 @@
+#include "environment.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace Chip8Emulator{
+
+// Chunks per worker; enough for stealing to even out uneven instances
+constexpr size_t CHUNKS_PER_THREAD = 8;
+
+Environment::Environment(size_t count, const char* filename, unsigned int threads, int cyclesPerFrame)
+: m_Count(count),
+  m_CyclesPerFrame(cyclesPerFrame),
+  m_Rom(filename),
+  m_Instances(std::make_unique<Chip8[]>(count)),
+  m_Framebuffers(std::make_unique<const uint64_t*[]>(count)),
+  m_Faulted(std::make_unique<uint8_t[]>(count)),
+  m_Pool(threads)
+{
+    if (count == 0) {
+        throw std::invalid_argument("Environment needs at least one instance");
+    }
+    if (cyclesPerFrame <= 0) {
+        throw std::invalid_argument("cyclesPerFrame must be positive");
+    }
+
+    for (size_t i = 0; i < m_Count; i++) {
+        m_Instances[i].Seed(i);
+        m_Instances[i].LoadROM(m_Rom.GetData(), m_Rom.GetSize());
+        m_Framebuffers[i] = m_Instances[i].getDisplay();
+    }
+
+    m_Grain = std::max<size_t>(1, m_Count / (m_Pool.GetThreadCount() * CHUNKS_PER_THREAD));
+}
+
+size_t Environment::Step(const uint16_t* keys, unsigned int frames) {
+    m_Keys = keys;
+    m_Frames = frames;
+    m_FaultCount.store(0, std::memory_order_relaxed);
+
+    m_Pool.ParallelFor(m_Count, m_Grain, &Environment::RunChunk, this);
+
+    return m_FaultCount.load(std::memory_order_relaxed);
+}
+
+void Environment::RunChunk(void* context, size_t begin, size_t end) {
+    auto& env = *static_cast<Environment*>(context);
+    size_t faults = 0;
+
+    for (size_t i = begin; i < end; i++) {
+        if (env.m_Faulted[i]) {
+            faults++;
+            continue;
+        }
+
+        Chip8& chip8 = env.m_Instances[i];
+        if (env.m_Keys) {
+            uint8_t* keypad = chip8.getKeypad();
+            for (unsigned int key = 0; key < KEY_COUNT; key++) {
+                keypad[key] = (env.m_Keys[i] >> key) & 1;
+            }
+        }
+
+        try {
+            for (unsigned int frame = 0; frame < env.m_Frames; frame++) {
+                chip8.Run(env.m_CyclesPerFrame);
+                chip8.DecrementTimers();
+            }
+        } catch (const std::exception&) {
+            env.m_Faulted[i] = 1;
+            faults++;
+        }
+    }
+
+    if (faults != 0) {
+        env.m_FaultCount.fetch_add(faults, std::memory_order_relaxed);
+    }
+}
+
+void Environment::Reset(const uint8_t* mask) {
+    for (size_t i = 0; i < m_Count; i++) {
+        if (mask && !mask[i]) {
+            continue;
+        }
+
+        m_Instances[i].Reset();
+        m_Instances[i].Seed(i);
+        m_Instances[i].LoadROM(m_Rom.GetData(), m_Rom.GetSize());
+        m_Faulted[i] = 0;
+    }
+}
+
+} // namespace Chip8Emulator
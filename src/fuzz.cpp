@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "chip8.hpp"
+#include "save_state.hpp"
+#include <getopt.h>
+
+// Input layout: one configuration byte, two keypad bytes, then the ROM.
+// Configuration bits 0-1 pick the variant, 2-3 the quirk profile and 4-5 the
+// backend; out-of-range values wrap. Each input runs a bounded number of frames.
+constexpr size_t FUZZ_HEADER_SIZE = 3;
+constexpr uint32_t FUZZ_FRAMES = 8;
+constexpr uint32_t FUZZ_CYCLES_PER_FRAME = 64;
+
+constexpr Chip8Emulator::ExecutionMode FUZZ_BACKENDS[] = {
+    Chip8Emulator::ExecutionMode::Interpreter,
+    Chip8Emulator::ExecutionMode::BlockCache,
+    Chip8Emulator::ExecutionMode::Jit,
+};
+
+constexpr Chip8Emulator::Variant FUZZ_VARIANTS[] = {
+    Chip8Emulator::Variant::Chip8,
+    Chip8Emulator::Variant::SuperChip,
+    Chip8Emulator::Variant::XoChip,
+};
+
+// Built once per process. Every input starts from a power-on snapshot copied
+// in by LoadState instead of a freshly constructed machine.
+struct FuzzHarness {
+    Chip8Emulator::Chip8 machines[std::size(FUZZ_BACKENDS)];
+    Chip8Emulator::MachineState pristine[std::size(FUZZ_VARIANTS)];
+
+    FuzzHarness()
+    : machines{ Chip8Emulator::Chip8(0), Chip8Emulator::Chip8(0), Chip8Emulator::Chip8(0) }
+    {
+        for (size_t i = 0; i < std::size(FUZZ_BACKENDS); i++) {
+            machines[i].SetExecutionMode(FUZZ_BACKENDS[i]);
+        }
+        for (size_t i = 0; i < std::size(FUZZ_VARIANTS); i++) {
+            machines[0].SetVariant(FUZZ_VARIANTS[i]);
+            machines[0].SaveState(pristine[i]);
+        }
+    }
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    using namespace Chip8Emulator;
+
+    static FuzzHarness* harness = new FuzzHarness();
+    if (size < FUZZ_HEADER_SIZE) {
+        return 0;
+    }
+
+    const uint8_t config = data[0];
+    const size_t variant = (config & 0x3) % std::size(FUZZ_VARIANTS);
+    const auto profile = static_cast<QuirkProfile>(((config >> 2) & 0x3) % static_cast<size_t>(QuirkProfile::Count));
+    Chip8& chip8 = harness->machines[((config >> 4) & 0x3) % std::size(FUZZ_BACKENDS)];
+
+    chip8.LoadState(harness->pristine[variant]);
+    chip8.SetQuirkProfile(profile);
+
+    const uint16_t keys = data[1] | (data[2] << 8);
+    for (unsigned int key = 0; key < KEY_COUNT; key++) {
+        chip8.getKeypad()[key] = (keys >> key) & 1;
+    }
+
+    const size_t capacity = (FUZZ_VARIANTS[variant] == Variant::XoChip ? MAX_MEMORY_SIZE : MEMORY_SIZE) - START_ADDR;
+    chip8.LoadROM(data + FUZZ_HEADER_SIZE, std::min(size - FUZZ_HEADER_SIZE, capacity));
+
+    try {
+        for (uint32_t frame = 0; frame < FUZZ_FRAMES; frame++) {
+            chip8.Run(FUZZ_CYCLES_PER_FRAME);
+            chip8.DecrementTimers();
+        }
+    } catch (const std::runtime_error&) {
+        // Unknown opcodes halt the machine; that is expected behaviour, not a finding
+    }
+    return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+
+// Standalone driver for builds without libFuzzer: replays the given inputs
+// (files or directories, e.g. a crash or a corpus) or runs random ones
+int main(int argc, char* argv[])
+{
+    uint64_t randomRuns = 0;
+    size_t maxLength = 4096;
+    uint64_t seed = 1;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"random", required_argument, 0, 'r'},
+        {"max-len", required_argument, 0, 'm'},
+        {"seed", required_argument, 0, 's'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    bool validOptions = true;
+    while ((opt = getopt_long(argc, argv, "r:m:s:", long_options, &option_index)) != -1) {
+        try {
+            switch (opt) {
+                case 'r':
+                    randomRuns = std::stoull(optarg);
+                    break;
+                case 'm':
+                    maxLength = std::stoull(optarg);
+                    break;
+                case 's':
+                    seed = std::stoull(optarg);
+                    break;
+                default:
+                    validOptions = false;
+                    break;
+            }
+        } catch (const std::exception&) {
+            validOptions = false;
+        }
+    }
+
+    if (!validOptions || (randomRuns == 0 && optind == argc) || maxLength < FUZZ_HEADER_SIZE) {
+        std::cerr << "Usage: " << argv[0] << " [options] [input file or directory]...\n"
+                  << "Runs each input through the fuzz target once\n"
+                  << "Options:\n"
+                  << "  --random <n>   Also run n random inputs and report executions per second\n"
+                  << "  --max-len <n>  Longest random input in bytes (default: 4096)\n"
+                  << "  --seed <n>     Seed for the random inputs (default: 1)\n";
+        return 1;
+    }
+
+    namespace fs = std::filesystem;
+    std::vector<std::string> inputs;
+    for (int i = optind; i < argc; i++) {
+        std::error_code error;
+        if (!fs::is_directory(argv[i], error)) {
+            inputs.push_back(argv[i]);
+            continue;
+        }
+        for (const auto& entry : fs::recursive_directory_iterator(argv[i], error)) {
+            if (entry.is_regular_file()) {
+                inputs.push_back(entry.path().string());
+            }
+        }
+    }
+
+    for (const auto& input : inputs) {
+        // Empty and oversized inputs are valid fuzz inputs, so they are read
+        // directly rather than through RomImage's ROM checks
+        std::error_code error;
+        uintmax_t length = fs::file_size(input, error);
+        std::vector<uint8_t> bytes(error ? 0 : length);
+        FILE* file = std::fopen(input.c_str(), "rb");
+        if (file == nullptr || std::fread(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+            std::cerr << input << ": failed to read\n";
+            if (file != nullptr) {
+                std::fclose(file);
+            }
+            return 1;
+        }
+        std::fclose(file);
+
+        LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+        std::cout << input << ": ok\n";
+    }
+
+    if (randomRuns > 0) {
+        std::mt19937_64 random(seed);
+        std::vector<uint8_t> bytes(maxLength);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t run = 0; run < randomRuns; run++) {
+            size_t length = FUZZ_HEADER_SIZE + random() % (maxLength - FUZZ_HEADER_SIZE + 1);
+            for (size_t i = 0; i < length; i++) {
+                bytes[i] = static_cast<uint8_t>(random());
+            }
+            LLVMFuzzerTestOneInput(bytes.data(), length);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "random runs:    " << randomRuns << "\n"
+                  << "execs/sec:      " << static_cast<uint64_t>(randomRuns / seconds) << "\n";
+    }
+    return 0;
+}
+
+#endif // CHIP8_LIBFUZZER
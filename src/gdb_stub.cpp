@@ -0,0 +1,490 @@
+#include "gdb_stub.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "log.hpp"
+
+namespace Chip8Emulator{
+
+namespace {
+
+// Instructions a continue runs between checks for ^C from the client
+constexpr uint64_t RESUME_SLICE = 10000;
+
+constexpr unsigned int REGISTER_COUNT_GDB = 21;
+constexpr unsigned int REG_I = 16;
+constexpr unsigned int REG_PC = 17;
+constexpr unsigned int REG_SP = 18;
+constexpr unsigned int REG_DT = 19;
+constexpr unsigned int REG_ST = 20;
+
+const char TARGET_XML[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+    "<target version=\"1.0\">\n"
+    "  <feature name=\"org.chip8.cpu\">\n"
+    "    <reg name=\"v0\" bitsize=\"8\" regnum=\"0\"/>\n"
+    "    <reg name=\"v1\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v2\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v3\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v4\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v5\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v6\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v7\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v8\" bitsize=\"8\"/>\n"
+    "    <reg name=\"v9\" bitsize=\"8\"/>\n"
+    "    <reg name=\"va\" bitsize=\"8\"/>\n"
+    "    <reg name=\"vb\" bitsize=\"8\"/>\n"
+    "    <reg name=\"vc\" bitsize=\"8\"/>\n"
+    "    <reg name=\"vd\" bitsize=\"8\"/>\n"
+    "    <reg name=\"ve\" bitsize=\"8\"/>\n"
+    "    <reg name=\"vf\" bitsize=\"8\"/>\n"
+    "    <reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>\n"
+    "    <reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>\n"
+    "    <reg name=\"sp\" bitsize=\"8\"/>\n"
+    "    <reg name=\"dt\" bitsize=\"8\"/>\n"
+    "    <reg name=\"st\" bitsize=\"8\"/>\n"
+    "  </feature>\n"
+    "</target>\n";
+
+// Register sizes in bytes, indexed by GDB register number
+unsigned int RegisterSize(unsigned int reg) {
+    return reg == REG_I || reg == REG_PC ? 2 : 1;
+}
+
+void AppendHex(std::string& out, uint32_t value, unsigned int bytes) {
+    static const char DIGITS[] = "0123456789abcdef";
+    // Little-endian, as GDB reads target registers
+    for (unsigned int i = 0; i < bytes; i++) {
+        uint8_t byte = static_cast<uint8_t>(value >> (8 * i));
+        out += DIGITS[byte >> 4];
+        out += DIGITS[byte & 0xF];
+    }
+}
+
+bool ParseHexBytes(const std::string& hex, size_t pos, unsigned int bytes, uint32_t& value) {
+    if (pos + 2 * bytes > hex.size()) {
+        return false;
+    }
+    value = 0;
+    for (unsigned int i = 0; i < bytes; i++) {
+        char* end = nullptr;
+        std::string digits = hex.substr(pos + 2 * i, 2);
+        unsigned long byte = std::strtoul(digits.c_str(), &end, 16);
+        if (*end != '\0') {
+            return false;
+        }
+        value |= static_cast<uint32_t>(byte) << (8 * i);
+    }
+    return true;
+}
+
+// "addr,length" in big-endian hex, as memory packets write them
+bool ParseAddressLength(const std::string& text, uint32_t& address, uint32_t& length) {
+    char* end = nullptr;
+    address = static_cast<uint32_t>(std::strtoul(text.c_str(), &end, 16));
+    if (*end != ',') {
+        return false;
+    }
+    length = static_cast<uint32_t>(std::strtoul(end + 1, &end, 16));
+    return *end == '\0' || *end == ':';
+}
+
+std::string StopReply(const StopInfo& stop) {
+    if (stop.reason != StopReason::Watchpoint) {
+        return "S05";
+    }
+    char reply[32];
+    snprintf(reply, sizeof(reply), "T05%s:%x;", stop.access == WATCH_WRITE ? "watch" : "rwatch", stop.address);
+    return reply;
+}
+
+} // namespace
+
+GdbStub::GdbStub(Debugger& debugger, const std::string& socketPath)
+: m_Debugger(debugger),
+  m_Path(socketPath)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socketPath);
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // A socket left behind by an earlier session is replaced; anything else is not
+    struct stat info;
+    if (stat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(socketPath.c_str());
+    }
+
+    m_Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_Listener < 0 || bind(m_Listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(m_Listener, 1) != 0) {
+        std::string error = std::strerror(errno);
+        if (m_Listener >= 0) {
+            close(m_Listener);
+        }
+        throw std::runtime_error("Failed to listen on " + socketPath + ": " + error);
+    }
+}
+
+GdbStub::~GdbStub() {
+    if (m_Client >= 0) {
+        close(m_Client);
+    }
+    close(m_Listener);
+    unlink(m_Path.c_str());
+}
+
+bool GdbStub::Serve() {
+    m_Client = accept(m_Listener, nullptr, nullptr);
+    if (m_Client < 0) {
+        throw std::runtime_error(std::string("Failed to accept a debugger: ") + std::strerror(errno));
+    }
+    m_NoAck = false;
+    m_Input.clear();
+
+    bool done = false;
+    bool detached = false;
+    std::string packet;
+    while (!done && ReadPacket(packet)) {
+        // Kill has no reply
+        if (packet == "k") {
+            break;
+        }
+        SendPacket(Handle(packet, done, detached));
+        if (packet == "QStartNoAckMode") {
+            m_NoAck = true;
+        }
+    }
+
+    close(m_Client);
+    m_Client = -1;
+    return detached;
+}
+
+bool GdbStub::ReadPacket(std::string& packet) {
+    while (true) {
+        // Acks, and ^C outside of a continue, are dropped
+        size_t start = m_Input.find('$');
+        size_t hash = start == std::string::npos ? std::string::npos : m_Input.find('#', start);
+        if (hash != std::string::npos && hash + 2 < m_Input.size()) {
+            packet = m_Input.substr(start + 1, hash - start - 1);
+            unsigned int expected = static_cast<unsigned int>(std::strtoul(m_Input.substr(hash + 1, 2).c_str(), nullptr, 16));
+            m_Input.erase(0, hash + 3);
+
+            unsigned int sum = 0;
+            for (char c : packet) {
+                sum += static_cast<uint8_t>(c);
+            }
+            if (m_NoAck) {
+                return true;
+            }
+            if ((sum & 0xFF) == expected) {
+                SendRaw("+");
+                return true;
+            }
+            SendRaw("-");
+            continue;
+        }
+        if (start == std::string::npos) {
+            m_Input.clear();
+        }
+
+        char buffer[4096];
+        ssize_t received = recv(m_Client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return false;
+        }
+        m_Input.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+void GdbStub::SendPacket(const std::string& payload) {
+    unsigned int sum = 0;
+    for (char c : payload) {
+        sum += static_cast<uint8_t>(c);
+    }
+    char checksum[4];
+    snprintf(checksum, sizeof(checksum), "#%02x", sum & 0xFF);
+    SendRaw("$" + payload + checksum);
+}
+
+bool GdbStub::SendRaw(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(m_Client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool GdbStub::Interrupted() {
+    pollfd client{ m_Client, POLLIN, 0 };
+    if (poll(&client, 1, 0) <= 0) {
+        return false;
+    }
+
+    char buffer[256];
+    ssize_t received = recv(m_Client, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+        // Gone; the next ReadPacket ends the session
+        return true;
+    }
+    m_Input.append(buffer, static_cast<size_t>(received));
+
+    size_t interrupt = m_Input.find('\x03');
+    if (interrupt == std::string::npos) {
+        return false;
+    }
+    m_Input.erase(interrupt, 1);
+    return true;
+}
+
+std::string GdbStub::Resume(bool step) {
+    try {
+        if (step) {
+            return StopReply(m_Debugger.Step());
+        }
+        while (true) {
+            StopInfo stop = m_Debugger.Continue(RESUME_SLICE);
+            if (stop.reason != StopReason::Limit) {
+                return StopReply(stop);
+            }
+            if (Interrupted()) {
+                return "S02";
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        // Unknown opcodes stop the machine as an illegal instruction would
+        CHIP8_LOG_ERROR("%s", e.what());
+        return "S04";
+    }
+}
+
+std::string GdbStub::ReadRegisters() const {
+    std::string hex;
+    for (unsigned int reg = 0; reg < REGISTER_COUNT_GDB; reg++) {
+        std::string value;
+        ReadRegister(reg, value);
+        hex += value;
+    }
+    return hex;
+}
+
+bool GdbStub::WriteRegisters(const std::string& hex) {
+    size_t pos = 0;
+    for (unsigned int reg = 0; reg < REGISTER_COUNT_GDB; reg++) {
+        unsigned int size = RegisterSize(reg);
+        if (!WriteRegister(reg, hex.substr(pos, 2 * size))) {
+            return false;
+        }
+        pos += 2 * size;
+    }
+    return true;
+}
+
+bool GdbStub::ReadRegister(unsigned int reg, std::string& hex) const {
+    uint32_t value;
+    if (reg < REGISTER_COUNT) {
+        value = m_Debugger.GetRegister(reg);
+    } else if (reg == REG_I) {
+        value = m_Debugger.GetIndex();
+    } else if (reg == REG_PC) {
+        value = m_Debugger.GetProgramCounter();
+    } else if (reg == REG_SP) {
+        value = m_Debugger.GetStackPointer();
+    } else if (reg == REG_DT) {
+        value = m_Debugger.GetDelayTimer();
+    } else if (reg == REG_ST) {
+        value = m_Debugger.GetSoundTimer();
+    } else {
+        return false;
+    }
+    hex.clear();
+    AppendHex(hex, value, RegisterSize(reg));
+    return true;
+}
+
+bool GdbStub::WriteRegister(unsigned int reg, const std::string& hex) {
+    uint32_t value;
+    if (reg >= REGISTER_COUNT_GDB || !ParseHexBytes(hex, 0, RegisterSize(reg), value)) {
+        return false;
+    }
+
+    if (reg < REGISTER_COUNT) {
+        m_Debugger.SetRegister(reg, static_cast<uint8_t>(value));
+    } else if (reg == REG_I) {
+        m_Debugger.SetIndex(static_cast<uint16_t>(value));
+    } else if (reg == REG_PC) {
+        m_Debugger.SetProgramCounter(static_cast<uint16_t>(value));
+    } else if (reg == REG_DT) {
+        m_Debugger.SetTimers(static_cast<uint8_t>(value), m_Debugger.GetSoundTimer());
+    } else if (reg == REG_ST) {
+        m_Debugger.SetTimers(m_Debugger.GetDelayTimer(), static_cast<uint8_t>(value));
+    }
+    // SP is read-only: the stack contents are not exposed
+    return true;
+}
+
+std::string GdbStub::Handle(const std::string& packet, bool& done, bool& detached) {
+    // An empty packet is a command this stub does not support
+    if (packet.empty()) {
+        return "";
+    }
+
+    const std::string args = packet.substr(1);
+    switch (packet[0]) {
+        case '?':
+            return "S05";
+        case 'g':
+            return ReadRegisters();
+        case 'G':
+            return WriteRegisters(args) ? "OK" : "E01";
+        case 'p': {
+            std::string hex;
+            return ReadRegister(static_cast<unsigned int>(std::strtoul(args.c_str(), nullptr, 16)), hex) ? hex : "E01";
+        }
+        case 'P': {
+            size_t equals = args.find('=');
+            if (equals == std::string::npos) {
+                return "E01";
+            }
+            unsigned int reg = static_cast<unsigned int>(std::strtoul(args.substr(0, equals).c_str(), nullptr, 16));
+            return WriteRegister(reg, args.substr(equals + 1)) ? "OK" : "E01";
+        }
+        case 'm': {
+            uint32_t address, length;
+            if (!ParseAddressLength(args, address, length) || address + length > m_Debugger.GetMemorySize()) {
+                return "E01";
+            }
+            std::string hex;
+            for (uint32_t i = 0; i < length; i++) {
+                AppendHex(hex, m_Debugger.ReadMemory(static_cast<uint16_t>(address + i)), 1);
+            }
+            return hex;
+        }
+        case 'M': {
+            uint32_t address, length;
+            size_t colon = args.find(':');
+            if (colon == std::string::npos || !ParseAddressLength(args, address, length) ||
+                address + length > m_Debugger.GetMemorySize() || args.size() - colon - 1 != 2 * length) {
+                return "E01";
+            }
+            std::vector<uint8_t> bytes(length);
+            for (uint32_t i = 0; i < length; i++) {
+                uint32_t byte;
+                if (!ParseHexBytes(args, colon + 1 + 2 * i, 1, byte)) {
+                    return "E01";
+                }
+                bytes[i] = static_cast<uint8_t>(byte);
+            }
+            m_Debugger.WriteMemory(static_cast<uint16_t>(address), bytes.data(), static_cast<uint16_t>(length));
+            return "OK";
+        }
+        case 'c':
+        case 's':
+            if (!args.empty()) {
+                m_Debugger.SetProgramCounter(static_cast<uint16_t>(std::strtoul(args.c_str(), nullptr, 16)));
+            }
+            return Resume(packet[0] == 's');
+        case 'Z':
+        case 'z': {
+            uint32_t address, length;
+            if (args.size() < 2 || args[1] != ',' || !ParseAddressLength(args.substr(2), address, length) ||
+                address >= m_Debugger.GetMemorySize()) {
+                return "E01";
+            }
+            const bool insert = packet[0] == 'Z';
+            const uint16_t at = static_cast<uint16_t>(address);
+            switch (args[0]) {
+                case '0':
+                case '1':
+                    if (insert) {
+                        m_Debugger.AddBreakpoint(at);
+                    } else {
+                        m_Debugger.RemoveBreakpoint(at);
+                    }
+                    return "OK";
+                case '2':
+                case '3':
+                case '4': {
+                    static const uint8_t KINDS[] = { WATCH_WRITE, WATCH_READ, WATCH_ACCESS };
+                    uint8_t kind = KINDS[args[0] - '2'];
+                    if (insert) {
+                        m_Debugger.AddWatchpoint(at, static_cast<uint16_t>(length), kind);
+                    } else {
+                        m_Debugger.RemoveWatchpoint(at, static_cast<uint16_t>(length), kind);
+                    }
+                    return "OK";
+                }
+                default:
+                    return "";
+            }
+        }
+        case 'D':
+            done = true;
+            detached = true;
+            return "OK";
+        case 'H':
+        case 'T':
+            return "OK";
+        default:
+            break;
+    }
+
+    if (packet.starts_with("qSupported")) {
+        return "PacketSize=4000;qXfer:features:read+;QStartNoAckMode+";
+    }
+    if (packet == "QStartNoAckMode" || packet.starts_with("qSymbol")) {
+        return "OK";
+    }
+    if (packet == "qAttached") {
+        return "1";
+    }
+    if (packet == "qC") {
+        return "QC1";
+    }
+    if (packet == "qfThreadInfo") {
+        return "m1";
+    }
+    if (packet == "qsThreadInfo") {
+        return "l";
+    }
+    if (packet == "qOffsets") {
+        return "Text=0;Data=0;Bss=0";
+    }
+    if (packet.starts_with("qXfer:features:read:target.xml:")) {
+        uint32_t offset, length;
+        if (!ParseAddressLength(packet.substr(std::strlen("qXfer:features:read:target.xml:")), offset, length)) {
+            return "E01";
+        }
+        const std::string xml = TARGET_XML;
+        if (offset >= xml.size()) {
+            return "l";
+        }
+        std::string chunk = xml.substr(offset, length);
+        return (offset + chunk.size() < xml.size() ? "m" : "l") + chunk;
+    }
+    if (packet == "vCont?") {
+        return "vCont;c;C;s;S";
+    }
+    if (packet.starts_with("vCont;") && packet.size() > 6) {
+        return Resume(packet[6] == 's' || packet[6] == 'S');
+    }
+    return "";
+}
+
+} // namespace Chip8Emulator
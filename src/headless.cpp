@@ -0,0 +1,541 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "chip8.hpp"
+#include "batch.hpp"
+#include "capture.hpp"
+#include "display.hpp"
+#include "input_log.hpp"
+#include "profiler.hpp"
+#include "rom.hpp"
+#include "rom_catalog.hpp"
+#include "save_state.hpp"
+#include "trace.hpp"
+#include <getopt.h>
+
+constexpr int CPU_CLOCK_SPEED = 600; // 600 Hz
+constexpr int TIMER_FREQUENCY = 60; // 60 Hz
+constexpr int CYCLES_PER_FRAME = CPU_CLOCK_SPEED / TIMER_FREQUENCY;
+constexpr uint64_t DEFAULT_FRAMES = 60 * 60; // One emulated minute
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+struct RunResult {
+    uint64_t cycles;
+    uint64_t frames;
+    double seconds;
+};
+
+template <typename Machine>
+RunResult RunCycles(Machine& chip8, uint64_t cycles, int cyclesPerFrame, Chip8Emulator::FrameCapture* capture = nullptr);
+template <typename Machine>
+RunResult RunFrames(Machine& chip8, uint64_t frames, int cyclesPerFrame, Chip8Emulator::FrameCapture* capture = nullptr);
+int RunBatch(const char* romFilename, size_t lanes, uint64_t cycleCount, uint64_t frameCount, int cyclesPerFrame, bool verify);
+RunResult RunReplay(Chip8Emulator::Chip8& chip8, const Chip8Emulator::InputLog& log, Chip8Emulator::FrameCapture* capture);
+
+// Headless runs have no real-time clock to keep, so capture waits for the
+// encoder instead of dropping frames
+void Tick(Chip8Emulator::Chip8& chip8, Chip8Emulator::FrameCapture* capture) {
+    if (capture != nullptr) {
+        capture->Capture(chip8, true);
+    }
+    chip8.DecrementTimers();
+}
+void Tick(Chip8Emulator::Chip8Batch& batch, Chip8Emulator::FrameCapture*) { batch.DecrementTimers(); }
+
+int main(int argc, char* argv[])
+{
+    // Arguments - Default Values
+    uint64_t cycleCount = 0;
+    uint64_t frameCount = 0;
+    int cyclesPerFrame = CYCLES_PER_FRAME;
+    bool cyclesPerFrameSet = false;
+    const char* romFilename = nullptr;
+    size_t lanes = 0;
+    bool verify = false;
+    uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+    const char* replayFilename = nullptr;
+    std::string profilePrefix = "chip8-profile";
+    const char* traceFilename = nullptr;
+    Chip8Emulator::ExecutionMode mode = Chip8Emulator::ExecutionMode::Interpreter;
+    Chip8Emulator::Variant variant = Chip8Emulator::Variant::Chip8;
+    bool variantSet = false;
+    Chip8Emulator::QuirkProfile quirks{};
+    bool quirksSet = false;
+    const char* catalogFilename = nullptr;
+    const char* captureFilename = nullptr;
+    Chip8Emulator::CaptureFormat captureFormat = Chip8Emulator::CaptureFormat::Gif;
+    unsigned int captureScale = 4;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"cycles", required_argument, 0, 'c'},
+        {"frames", required_argument, 0, 'n'},
+        {"cycles-per-frame", required_argument, 0, 'p'},
+        {"backend", required_argument, 0, 'b'},
+        {"rom", required_argument, 0, 'r'},
+        {"lanes", required_argument, 0, 'l'},
+        {"verify", no_argument, 0, 'v'},
+        {"trace", required_argument, 0, 't'},
+        {"seed", required_argument, 0, 's'},
+        {"replay", required_argument, 0, 'y'},
+        {"profile", required_argument, 0, 'o'},
+        {"variant", required_argument, 0, 'V'},
+        {"quirks", required_argument, 0, 'q'},
+        {"catalog", required_argument, 0, 'C'},
+        {"capture", required_argument, 0, 'a'},
+        {"capture-format", required_argument, 0, 'f'},
+        {"capture-scale", required_argument, 0, 'x'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    while ((opt = getopt_long(argc, argv, "c:n:p:b:r:l:vs:y:o:t:V:q:C:a:f:x:", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'c':
+                cycleCount = std::stoull(optarg);
+                break;
+            case 'n':
+                frameCount = std::stoull(optarg);
+                break;
+            case 'p':
+                cyclesPerFrame = std::stoi(optarg);
+                cyclesPerFrameSet = true;
+                break;
+            case 'b':
+                if (!Chip8Emulator::ParseExecutionMode(optarg, mode)) {
+                    std::cerr << "Unknown backend: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case 'r':
+                romFilename = optarg;
+                break;
+            case 'l':
+                lanes = std::stoull(optarg);
+                break;
+            case 'v':
+                verify = true;
+                break;
+            case 's':
+                seed = std::stoull(optarg);
+                break;
+            case 'y':
+                replayFilename = optarg;
+                break;
+            case 'o':
+                profilePrefix = optarg;
+                break;
+            case 't':
+                traceFilename = optarg;
+                break;
+            case 'V':
+                if (!Chip8Emulator::ParseVariant(optarg, variant)) {
+                    std::cerr << "Unknown variant: " << optarg << "\n";
+                    return 1;
+                }
+                variantSet = true;
+                break;
+            case 'q':
+                if (!Chip8Emulator::ParseQuirkProfile(optarg, quirks)) {
+                    std::cerr << "Unknown quirk profile: " << optarg << "\n";
+                    return 1;
+                }
+                quirksSet = true;
+                break;
+            case 'C':
+                catalogFilename = optarg;
+                break;
+            case 'a':
+                captureFilename = optarg;
+                break;
+            case 'f':
+                if (!Chip8Emulator::ParseCaptureFormat(optarg, captureFormat)) {
+                    std::cerr << "Unknown capture format: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case 'x':
+                captureScale = static_cast<unsigned int>(std::stoul(optarg));
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0] << " [options] <ROM file>\n"
+                          << "Options:\n"
+                          << "  --cycles <n>             Run exactly n CPU cycles\n"
+                          << "  --frames <n>             Run n 60 Hz frames (default: 3600)\n"
+                          << "  --cycles-per-frame <n>   CPU cycles per frame (default: 10)\n"
+                          << "  --backend <name>         interpreter, block, jit or aot (default: interpreter)\n"
+                          << "  --lanes <n>              Run n instances in lockstep on the batch engine\n"
+                          << "  --verify                 With --lanes, feed each lane its own keys and compare its state with a Chip8\n"
+                          << "  --seed <n>               Seed the random number generator\n"
+                          << "  --replay <log>           Replay an input log recorded by chip-8 --record\n"
+                          << "  --profile <prefix>       Profile output path, CHIP8_PROFILE builds only (default: chip8-profile)\n"
+                          << "  --trace <file>           Write a binary instruction trace, CHIP8_TRACE builds only\n"
+                          << "  --variant <name>         chip8, schip or xochip (default: chip8)\n"
+                          << "  --quirks <name>          modern, cosmac, schip or xochip (default: the variant's)\n"
+                          << "  --catalog <file>         Take unset variant, quirks and clock from a ROM catalog\n"
+                          << "  --capture <path>         Record every frame (for ppm, the prefix of one file per frame)\n"
+                          << "  --capture-format <name>  raw, ppm or gif (default: gif)\n"
+                          << "  --capture-scale <n>      Pixel size of ppm and gif captures (default: 4)\n";
+                return 1;
+        }
+    }
+
+    // Get the ROM file from the last positional argument if not set by the --rom flag
+    if (romFilename == nullptr && optind < argc) {
+        romFilename = argv[optind];
+    }
+
+    if (romFilename == nullptr) {
+        std::cerr << "ROM file is required. Usage: " << argv[0] << " [options] <ROM file>\n";
+        return 1;
+    }
+
+    if (catalogFilename != nullptr) {
+        try {
+            Chip8Emulator::RomInfo info = Chip8Emulator::LookUpRom(catalogFilename, romFilename);
+            // The catalog's quirks belong to its variant
+            if (!variantSet) {
+                variant = info.variant;
+                if (!quirksSet) {
+                    quirks = info.quirks;
+                    quirksSet = true;
+                }
+            }
+            if (!cyclesPerFrameSet) {
+                cyclesPerFrame = static_cast<int>(info.clockHz / TIMER_FREQUENCY);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to look up ROM in catalog: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (cyclesPerFrame <= 0) {
+        std::cerr << "--cycles-per-frame must be positive\n";
+        return 1;
+    }
+
+    if (cycleCount == 0 && frameCount == 0) {
+        frameCount = DEFAULT_FRAMES;
+    }
+
+    if (lanes > 0) {
+        if (captureFilename != nullptr) {
+            std::cerr << "--capture records a single machine and cannot be used with --lanes\n";
+            return 1;
+        }
+        if (variant != Chip8Emulator::Variant::Chip8 || (quirksSet && quirks != Chip8Emulator::QuirkProfile::Modern)) {
+            std::cerr << "--lanes runs CHIP-8 ROMs with modern quirks only\n";
+            return 1;
+        }
+        return RunBatch(romFilename, lanes, cycleCount, frameCount, cyclesPerFrame, verify);
+    }
+
+    std::unique_ptr<Chip8Emulator::InputLog> replay;
+    if (replayFilename != nullptr) {
+        try {
+            replay = std::make_unique<Chip8Emulator::InputLog>(replayFilename);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to load input log: " << e.what() << "\n";
+            return 1;
+        }
+        seed = replay->GetSeed();
+        variant = replay->GetVariant();
+        quirks = replay->GetQuirkProfile();
+        quirksSet = true;
+    }
+
+    if (traceFilename != nullptr && !CHIP8_TRACE) {
+        std::cerr << "--trace needs a core built with CHIP8_TRACE\n";
+        return 1;
+    }
+
+    Chip8Emulator::Chip8 chip8(seed);
+    std::unique_ptr<Chip8Emulator::Tracer> tracer;
+    std::unique_ptr<Chip8Emulator::FrameCapture> capture;
+
+    try {
+        chip8.SetExecutionMode(mode);
+        chip8.SetVariant(variant);
+        if (quirksSet) {
+            chip8.SetQuirkProfile(quirks);
+        }
+        Chip8Emulator::RomImage rom(romFilename);
+        if (replay && replay->GetRomHash() != rom.GetHash()) {
+            std::cerr << "Input log was recorded with a different ROM\n";
+            return 1;
+        }
+        chip8.LoadROM(rom.GetData(), rom.GetSize());
+        if (traceFilename != nullptr) {
+            tracer = std::make_unique<Chip8Emulator::Tracer>(traceFilename);
+            chip8.SetTracer(tracer.get());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to load ROM: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (captureFilename != nullptr) {
+        try {
+            capture = std::make_unique<Chip8Emulator::FrameCapture>(captureFilename, captureFormat, variant, captureScale);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to start capture: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    RunResult result{};
+    try {
+        if (replay) {
+            result = RunReplay(chip8, *replay, capture.get());
+        } else {
+            result = cycleCount != 0 ? RunCycles(chip8, cycleCount, cyclesPerFrame, capture.get())
+                                     : RunFrames(chip8, frameCount, cyclesPerFrame, capture.get());
+        }
+        if (capture) {
+            capture->Stop();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Emulation stopped: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (const auto* profiler = chip8.GetProfiler()) {
+        profiler->Write(profilePrefix);
+    }
+
+    double cyclesPerSecond = result.seconds > 0.0 ? result.cycles / result.seconds : 0.0;
+
+    std::cout << "cycles:           " << result.cycles << "\n"
+              << "frames:           " << result.frames << "\n"
+              << "seconds:          " << result.seconds << "\n"
+              << "cycles/sec:       " << static_cast<uint64_t>(cyclesPerSecond) << "\n"
+              << "idle cycles:      " << chip8.GetIdleCycles() << "\n"
+              << "framebuffer hash: " << std::hex << chip8.GetDisplayHash() << std::dec << "\n";
+    if (capture) {
+        std::cout << "captured frames:  " << capture->GetCapturedCount() << "\n"
+                  << "dropped frames:   " << capture->GetDroppedCount() << "\n";
+    }
+    return 0;
+}
+
+// Runs a fixed number of CPU cycles, ticking the timers every cyclesPerFrame cycles
+template <typename Machine>
+RunResult RunCycles(Machine& chip8, uint64_t cycles, int cyclesPerFrame, Chip8Emulator::FrameCapture* capture)
+{
+    uint64_t frames = 0;
+    uint64_t remaining = cycles;
+    auto start = Clock::now();
+
+    while (remaining > 0) {
+        uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(remaining, cyclesPerFrame));
+        chip8.Run(count);
+        remaining -= count;
+
+        if (count == static_cast<uint32_t>(cyclesPerFrame)) {
+            Tick(chip8, capture);
+            frames++;
+        }
+    }
+
+    return { cycles, frames, std::chrono::duration_cast<Seconds>(Clock::now() - start).count() };
+}
+
+template <typename Machine>
+RunResult RunFrames(Machine& chip8, uint64_t frames, int cyclesPerFrame, Chip8Emulator::FrameCapture* capture)
+{
+    auto start = Clock::now();
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        chip8.Run(cyclesPerFrame);
+        Tick(chip8, capture);
+    }
+
+    return { frames * cyclesPerFrame, frames, std::chrono::duration_cast<Seconds>(Clock::now() - start).count() };
+}
+
+// Keys held on lane during frame under --verify: one or two keys from a
+// pattern of the lane's own, changing every 8 frames, with every other
+// period released so that Fx0A sees presses complete
+uint16_t VerifyKeys(size_t lane, uint64_t frame)
+{
+    const uint64_t period = frame / 8;
+    if (period % 2 == 0) {
+        return 0;
+    }
+    uint64_t x = (lane + 1) * 0x9E3779B97F4A7C15ull ^ period * 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 29;
+    return static_cast<uint16_t>((1u << (x % 16)) | (1u << ((x >> 8) % 16)));
+}
+
+// RunCycles with input: pressKeys(frame) sets the keypad before every frame
+template <typename Machine, typename PressKeys>
+RunResult RunCyclesWithKeys(Machine& chip8, uint64_t cycles, int cyclesPerFrame, PressKeys pressKeys)
+{
+    uint64_t frames = 0;
+    uint64_t remaining = cycles;
+    auto start = Clock::now();
+
+    while (remaining > 0) {
+        pressKeys(frames);
+        uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(remaining, cyclesPerFrame));
+        chip8.Run(count);
+        remaining -= count;
+
+        if (count == static_cast<uint32_t>(cyclesPerFrame)) {
+            Tick(chip8, nullptr);
+            frames++;
+        }
+    }
+
+    return { cycles, frames, std::chrono::duration_cast<Seconds>(Clock::now() - start).count() };
+}
+
+// The first part of the machine in which two CHIP-8 save states differ, or
+// null if they are identical
+const char* FirstDifference(const Chip8Emulator::MachineState& a, const Chip8Emulator::MachineState& b)
+{
+    Chip8Emulator::MachineStateHeader x;
+    Chip8Emulator::MachineStateHeader y;
+    std::memcpy(&x, a.bytes.data(), sizeof(x));
+    std::memcpy(&y, b.bytes.data(), sizeof(y));
+
+    if (std::memcmp(x.registers, y.registers, sizeof(x.registers)) != 0) {
+        return "V0-VF";
+    }
+    if (x.indexRegister != y.indexRegister) {
+        return "I";
+    }
+    if (x.programCounter != y.programCounter) {
+        return "PC";
+    }
+    if (x.stackPointer != y.stackPointer || std::memcmp(x.stack, y.stack, sizeof(x.stack)) != 0) {
+        return "stack";
+    }
+    if (x.delayTimer != y.delayTimer || x.soundTimer != y.soundTimer) {
+        return "timers";
+    }
+    if (x.randomState != y.randomState) {
+        return "random state";
+    }
+
+    const size_t memory = Chip8Emulator::MEMORY_SIZE;
+    if (a.bytes.size() != b.bytes.size() ||
+        std::memcmp(a.bytes.data() + sizeof(x), b.bytes.data() + sizeof(x), memory) != 0) {
+        return "memory";
+    }
+    if (std::memcmp(a.bytes.data() + sizeof(x) + memory, b.bytes.data() + sizeof(x) + memory,
+                    a.bytes.size() - sizeof(x) - memory) != 0) {
+        return "display";
+    }
+    return std::memcmp(&x, &y, sizeof(x)) != 0 ? "state" : nullptr;
+}
+
+// Runs the ROM on every lane of a batch; lane i is seeded with i so --verify
+// can replay it on a plain Chip8. Under --verify every lane also gets its own
+// keys, and the whole machine is compared: registers, I, PC, stack, timers,
+// random state, memory and display.
+int RunBatch(const char* romFilename, size_t lanes, uint64_t cycleCount, uint64_t frameCount, int cyclesPerFrame, bool verify)
+{
+    RunResult result{};
+
+    try {
+        Chip8Emulator::Chip8Batch batch(lanes);
+        batch.LoadROM(romFilename);
+        for (size_t lane = 0; lane < lanes; lane++) {
+            batch.Seed(lane, lane);
+        }
+
+        const uint64_t totalCycles = cycleCount != 0 ? cycleCount : frameCount * cyclesPerFrame;
+        if (verify) {
+            result = RunCyclesWithKeys(batch, totalCycles, cyclesPerFrame, [&](uint64_t frame) {
+                for (size_t lane = 0; lane < lanes; lane++) {
+                    batch.SetKeys(lane, VerifyKeys(lane, frame));
+                }
+            });
+        } else {
+            result = cycleCount != 0 ? RunCycles(batch, cycleCount, cyclesPerFrame)
+                                     : RunFrames(batch, frameCount, cyclesPerFrame);
+        }
+
+        double cyclesPerSecond = result.seconds > 0.0 ? result.cycles * lanes / result.seconds : 0.0;
+
+        std::cout << "lanes:            " << lanes << "\n"
+                  << "cycles:           " << result.cycles << " per lane\n"
+                  << "frames:           " << result.frames << "\n"
+                  << "seconds:          " << result.seconds << "\n"
+                  << "cycles/sec:       " << static_cast<uint64_t>(cyclesPerSecond) << " (all lanes)\n"
+                  << "framebuffer hash: " << std::hex << Chip8Emulator::HashDisplay(batch.getDisplay(0)) << std::dec << " (lane 0)\n";
+
+        if (!verify) {
+            return 0;
+        }
+
+        size_t mismatches = 0;
+        Chip8Emulator::MachineState expected;
+        Chip8Emulator::MachineState actual;
+        for (size_t lane = 0; lane < lanes; lane++) {
+            Chip8Emulator::Chip8 chip8;
+            chip8.LoadROM(romFilename);
+            chip8.Seed(lane);
+            RunCyclesWithKeys(chip8, totalCycles, cyclesPerFrame, [&](uint64_t frame) {
+                Chip8Emulator::UnpackKeys(VerifyKeys(lane, frame), chip8.getKeypad());
+            });
+
+            chip8.SaveState(expected);
+            batch.SaveState(lane, actual);
+            if (const char* part = FirstDifference(expected, actual)) {
+                std::cerr << "Lane " << lane << " differs from the reference in " << part << "\n";
+                mismatches++;
+            }
+        }
+
+        std::cout << "verify:           " << (mismatches == 0 ? "ok" : "FAILED") << "\n";
+        return mismatches == 0 ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Emulation stopped: " << e.what() << "\n";
+        return 1;
+    }
+}
+
+// Feeds the recorded keypad changes in at their cycle stamps, ticking the
+// timers every recorded frame, until the recorded session length is reached
+RunResult RunReplay(Chip8Emulator::Chip8& chip8, const Chip8Emulator::InputLog& log, Chip8Emulator::FrameCapture* capture)
+{
+    const uint64_t cyclesPerFrame = std::max<uint32_t>(log.GetCyclesPerFrame(), 1);
+    const uint64_t total = log.GetTotalCycles();
+    uint64_t frames = 0;
+    size_t next = 0;
+    auto start = Clock::now();
+
+    while (chip8.GetCycleCount() < total) {
+        uint64_t now = chip8.GetCycleCount();
+        while (next < log.GetEventCount() && log.GetEvent(next).cycle <= now) {
+            Chip8Emulator::UnpackKeys(log.GetEvent(next).keys, chip8.getKeypad());
+            next++;
+        }
+
+        uint64_t frameEnd = (now / cyclesPerFrame + 1) * cyclesPerFrame;
+        uint64_t stop = std::min(frameEnd, total);
+        if (next < log.GetEventCount()) {
+            stop = std::min(stop, log.GetEvent(next).cycle);
+        }
+
+        chip8.Run(static_cast<uint32_t>(stop - now));
+
+        if (chip8.GetCycleCount() == frameEnd) {
+            Tick(chip8, capture);
+            frames++;
+        }
+    }
+
+    return { total, frames, std::chrono::duration_cast<Seconds>(Clock::now() - start).count() };
+}
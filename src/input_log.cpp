@@ -0,0 +1,152 @@
+#include "input_log.hpp"
+#include "chip8.hpp"
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Chip8Emulator{
+
+namespace {
+
+void PutLE(uint8_t* out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint64_t GetLE(const uint8_t* in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+uint16_t PackKeys(const uint8_t* keypad) {
+    uint16_t keys = 0;
+    for (unsigned int key = 0; key < KEY_COUNT; key++) {
+        keys |= (keypad[key] ? 1 : 0) << key;
+    }
+    return keys;
+}
+
+void UnpackKeys(uint16_t keys, uint8_t* keypad) {
+    for (unsigned int key = 0; key < KEY_COUNT; key++) {
+        keypad[key] = (keys >> key) & 1;
+    }
+}
+
+InputRecorder::InputRecorder(const char* filename, uint64_t romHash, uint64_t seed, uint32_t cyclesPerFrame,
+                             Variant variant, QuirkProfile quirks)
+: m_File(std::fopen(filename, "wb")),
+  m_RomHash(romHash),
+  m_Seed(seed),
+  m_CyclesPerFrame(cyclesPerFrame),
+  m_Variant(variant),
+  m_Quirks(quirks)
+{
+    if (!m_File) {
+        throw std::runtime_error("Failed to create input log.");
+    }
+
+    WriteHeader(0);
+}
+
+InputRecorder::~InputRecorder() {
+    if (m_File) {
+        std::fclose(m_File);
+    }
+}
+
+void InputRecorder::WriteHeader(uint64_t totalCycles) {
+    uint8_t header[INPUT_LOG_HEADER_SIZE] = {};
+    PutLE(header, INPUT_LOG_MAGIC, 4);
+    PutLE(header + 4, INPUT_LOG_VERSION, 4);
+    PutLE(header + 8, m_Seed, 8);
+    PutLE(header + 16, m_CyclesPerFrame, 4);
+    PutLE(header + 20, static_cast<uint8_t>(m_Variant), 1);
+    PutLE(header + 21, static_cast<uint8_t>(m_Quirks), 1);
+    PutLE(header + 24, totalCycles, 8);
+    PutLE(header + 32, m_RomHash, 8);
+
+    std::fseek(m_File, 0, SEEK_SET);
+    std::fwrite(header, 1, sizeof(header), m_File);
+}
+
+void InputRecorder::Record(uint64_t cycle, uint16_t keys) {
+    if (!m_File || keys == m_LastKeys) {
+        return;
+    }
+
+    uint8_t event[INPUT_LOG_EVENT_SIZE];
+    PutLE(event, cycle, 8);
+    PutLE(event + 8, keys, 2);
+    std::fwrite(event, 1, sizeof(event), m_File);
+    m_LastKeys = keys;
+}
+
+void InputRecorder::Close(uint64_t totalCycles) {
+    if (!m_File) {
+        return;
+    }
+
+    WriteHeader(totalCycles);
+    std::fclose(m_File);
+    m_File = nullptr;
+}
+
+InputLog::InputLog(const char* filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open input log.");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < INPUT_LOG_HEADER_SIZE) {
+        close(fd);
+        throw std::runtime_error("Input log is truncated.");
+    }
+
+    m_Size = info.st_size;
+    void* mapping = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map input log.");
+    }
+    m_Bytes = static_cast<const uint8_t*>(mapping);
+
+    if (GetLE(m_Bytes, 4) != INPUT_LOG_MAGIC || GetLE(m_Bytes + 4, 4) != INPUT_LOG_VERSION) {
+        munmap(mapping, m_Size);
+        throw std::runtime_error("Unsupported input log version.");
+    }
+
+    m_Seed = GetLE(m_Bytes + 8, 8);
+    m_CyclesPerFrame = static_cast<uint32_t>(GetLE(m_Bytes + 16, 4));
+    uint64_t variant = GetLE(m_Bytes + 20, 1);
+    uint64_t quirks = GetLE(m_Bytes + 21, 1);
+    if (variant > static_cast<uint64_t>(Variant::XoChip) || quirks >= static_cast<uint64_t>(QuirkProfile::Count)) {
+        munmap(mapping, m_Size);
+        throw std::runtime_error("Unknown variant in input log.");
+    }
+    m_Variant = static_cast<Variant>(variant);
+    m_Quirks = static_cast<QuirkProfile>(quirks);
+    m_TotalCycles = GetLE(m_Bytes + 24, 8);
+    m_RomHash = GetLE(m_Bytes + 32, 8);
+    m_EventCount = (m_Size - INPUT_LOG_HEADER_SIZE) / INPUT_LOG_EVENT_SIZE;
+}
+
+InputLog::~InputLog() {
+    munmap(const_cast<uint8_t*>(m_Bytes), m_Size);
+}
+
+InputEvent InputLog::GetEvent(size_t index) const {
+    const uint8_t* event = m_Bytes + INPUT_LOG_HEADER_SIZE + index * INPUT_LOG_EVENT_SIZE;
+    return { GetLE(event, 8), static_cast<uint16_t>(GetLE(event + 8, 2)) };
+}
+
+} // namespace Chip8Emulator
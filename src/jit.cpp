@@ -0,0 +1,421 @@
+#include "jit.hpp"
+#include "block_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if CHIP8_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace Chip8Emulator{
+
+#if CHIP8_JIT_SUPPORTED
+
+namespace {
+
+// x86-64 register numbers used in ModRM.reg
+constexpr uint8_t AL = 0;
+constexpr uint8_t CL = 1;
+constexpr uint8_t DL = 2;
+
+// Upper bound on the code emitted for one block, so the buffer is flushed before compiling.
+// A store is the longest instruction: fallback call, validity check and two exits.
+constexpr size_t MAX_BLOCK_CODE_SIZE = MAX_BLOCK_LENGTH * 96 + 64;
+
+int32_t OffsetOf(const Chip8& chip8, const void* member) {
+    return static_cast<int32_t>(static_cast<const uint8_t*>(member) - reinterpret_cast<const uint8_t*>(&chip8));
+}
+
+} // namespace
+
+JitCompiler::JitCompiler(const Chip8& chip8)
+: m_RegisterOffset(OffsetOf(chip8, chip8.m_Register)),
+  m_IndexOffset(OffsetOf(chip8, &chip8.m_IndexRegister)),
+  m_ProgramCounterOffset(OffsetOf(chip8, &chip8.m_ProgramCounter)),
+  m_DelayTimerOffset(OffsetOf(chip8, &chip8.m_DelayTimer)),
+  m_SoundTimerOffset(OffsetOf(chip8, &chip8.m_SoundTimer))
+{
+    void* code = mmap(nullptr, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        throw std::runtime_error("Failed to allocate JIT code buffer");
+    }
+
+    m_Code = static_cast<uint8_t*>(code);
+    m_Emit.reserve(MAX_BLOCK_CODE_SIZE);
+    m_Blocks.reserve(MEMORY_SIZE);
+}
+
+JitCompiler::~JitCompiler() {
+    munmap(m_Code, JIT_CODE_BUFFER_SIZE);
+}
+
+void JitCompiler::Emit(std::initializer_list<uint8_t> bytes) {
+    for (uint8_t byte : bytes) {
+        m_Emit.push_back(byte);
+    }
+}
+
+void JitCompiler::Emit32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        m_Emit.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void JitCompiler::Emit64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        m_Emit.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+// <opcode> reg, [rbx + disp32]
+void JitCompiler::EmitRbx(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t offset) {
+    Emit(opcode);
+    m_Emit.push_back(static_cast<uint8_t>(0x80 | (reg << 3) | 0x3));
+    Emit32(static_cast<uint32_t>(offset));
+}
+
+// mov word [rbx + pc], imm16 (9 bytes)
+void JitCompiler::EmitStoreProgramCounter(uint16_t value) {
+    Emit({ 0x66 });
+    EmitRbx({ 0xC7 }, 0, m_ProgramCounterOffset);
+    Emit({ static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8) });
+}
+
+// return executed
+void JitCompiler::EmitReturn(uint16_t executed) {
+    Emit({ 0xB8 });                                             // mov eax, executed
+    Emit32(executed);
+    Emit({ 0x48, 0x83, 0xC4, 0x08 });                           // add rsp, 8
+    Emit({ 0x5D });                                             // pop rbp
+    Emit({ 0x5B });                                             // pop rbx
+    Emit({ 0xC3 });                                             // ret
+}
+
+// handler(*chip8, ins)
+void JitCompiler::EmitFallback(const Instruction& ins) {
+    Emit({ 0x48, 0x89, 0xDF });                                 // mov rdi, rbx
+    Emit({ 0x48, 0xBE });                                       // mov rsi, &ins
+    Emit64(reinterpret_cast<uint64_t>(&ins));
+    Emit({ 0x48, 0xB8 });                                       // mov rax, handler
+    Emit64(reinterpret_cast<uint64_t>(ins.handler));
+    Emit({ 0xFF, 0xD0 });                                       // call rax
+}
+
+void JitCompiler::EmitInstruction(const Instruction& ins, uint16_t address, const Quirks& quirks) {
+    const int32_t vx = m_RegisterOffset + ins.x;
+    const int32_t vy = m_RegisterOffset + ins.y;
+    const int32_t vf = m_RegisterOffset + 0xF;
+
+    switch (DecodeOpcodeId(ins.opcode)) {
+        case OpcodeId::OP_1nnn:
+            EmitStoreProgramCounter(ins.nnn);
+            break;
+        case OpcodeId::OP_3xkk:
+        case OpcodeId::OP_4xkk:
+            EmitStoreProgramCounter(address + 2);
+            EmitRbx({ 0x80 }, 7, vx);                           // cmp byte [Vx], kk
+            Emit({ ins.kk });
+            Emit({ static_cast<uint8_t>(DecodeOpcodeId(ins.opcode) == OpcodeId::OP_3xkk ? 0x75 : 0x74), 9 });
+            EmitStoreProgramCounter(address + 4);
+            break;
+        case OpcodeId::OP_5xy0:
+        case OpcodeId::OP_9xy0:
+            EmitStoreProgramCounter(address + 2);
+            EmitRbx({ 0x8A }, AL, vx);                          // mov al, [Vx]
+            EmitRbx({ 0x3A }, AL, vy);                          // cmp al, [Vy]
+            Emit({ static_cast<uint8_t>(DecodeOpcodeId(ins.opcode) == OpcodeId::OP_5xy0 ? 0x75 : 0x74), 9 });
+            EmitStoreProgramCounter(address + 4);
+            break;
+        case OpcodeId::OP_6xkk:
+            EmitRbx({ 0xC6 }, 0, vx);                           // mov byte [Vx], kk
+            Emit({ ins.kk });
+            break;
+        case OpcodeId::OP_7xkk:
+            EmitRbx({ 0x80 }, 0, vx);                           // add byte [Vx], kk
+            Emit({ ins.kk });
+            break;
+        case OpcodeId::OP_8xy0:
+            EmitRbx({ 0x8A }, AL, vy);                          // mov al, [Vy]
+            EmitRbx({ 0x88 }, AL, vx);                          // mov [Vx], al
+            break;
+        case OpcodeId::OP_8xy1:
+        case OpcodeId::OP_8xy2:
+        case OpcodeId::OP_8xy3: {
+            static constexpr uint8_t LOGIC_OPS[] = { 0x08, 0x20, 0x30 }; // or, and, xor [Vx], al
+            EmitRbx({ 0x8A }, AL, vy);
+            EmitRbx({ LOGIC_OPS[(ins.opcode & 0xF) - 1] }, AL, vx);
+            if (quirks.logicResetsVf) {
+                EmitRbx({ 0xC6 }, 0, vf);                       // mov byte [VF], 0
+                Emit({ 0 });
+            }
+            break;
+        }
+        case OpcodeId::OP_8xy4:
+            EmitRbx({ 0x0F, 0xB6 }, AL, vx);                    // movzx eax, byte [Vx]
+            EmitRbx({ 0x0F, 0xB6 }, CL, vy);                    // movzx ecx, byte [Vy]
+            Emit({ 0x01, 0xC8 });                               // add eax, ecx
+            EmitRbx({ 0x88 }, AL, vx);                          // mov [Vx], al
+            Emit({ 0xC1, 0xE8, 0x08 });                         // shr eax, 8
+            EmitRbx({ 0x88 }, AL, vf);                          // mov [VF], al
+            break;
+        case OpcodeId::OP_8xy5:
+            EmitRbx({ 0x8A }, AL, vx);                          // mov al, [Vx]
+            EmitRbx({ 0x3A }, AL, vy);                          // cmp al, [Vy]
+            Emit({ 0x0F, 0x97, 0xC2 });                         // seta dl
+            EmitRbx({ 0x88 }, DL, vf);                          // mov [VF], dl
+            EmitRbx({ 0x8A }, AL, vy);                          // mov al, [Vy]
+            EmitRbx({ 0x28 }, AL, vx);                          // sub [Vx], al
+            break;
+        case OpcodeId::OP_8xy6:
+            if (quirks.shiftUsesVy) {
+                EmitRbx({ 0x8A }, AL, vy);                      // mov al, [Vy]
+                Emit({ 0x88, 0xC2 });                           // mov dl, al
+                Emit({ 0x80, 0xE2, 0x01 });                     // and dl, 1
+                EmitRbx({ 0x88 }, DL, vf);                      // mov [VF], dl
+                Emit({ 0xD0, 0xE8 });                           // shr al, 1
+                EmitRbx({ 0x88 }, AL, vx);                      // mov [Vx], al
+                break;
+            }
+            EmitRbx({ 0x8A }, AL, vx);                          // mov al, [Vx]
+            Emit({ 0x24, 0x01 });                               // and al, 1
+            EmitRbx({ 0x88 }, AL, vf);                          // mov [VF], al
+            EmitRbx({ 0xD0 }, 5, vx);                           // shr byte [Vx], 1
+            break;
+        case OpcodeId::OP_8xy7:
+            EmitRbx({ 0x8A }, AL, vy);                          // mov al, [Vy]
+            EmitRbx({ 0x3A }, AL, vx);                          // cmp al, [Vx]
+            Emit({ 0x0F, 0x97, 0xC2 });                         // seta dl
+            EmitRbx({ 0x88 }, DL, vf);                          // mov [VF], dl
+            EmitRbx({ 0x8A }, AL, vy);                          // mov al, [Vy]
+            EmitRbx({ 0x2A }, AL, vx);                          // sub al, [Vx]
+            EmitRbx({ 0x88 }, AL, vx);                          // mov [Vx], al
+            break;
+        case OpcodeId::OP_8xyE:
+            if (quirks.shiftUsesVy) {
+                EmitRbx({ 0x8A }, AL, vy);                      // mov al, [Vy]
+                Emit({ 0x88, 0xC2 });                           // mov dl, al
+                Emit({ 0xC0, 0xEA, 0x07 });                     // shr dl, 7
+                EmitRbx({ 0x88 }, DL, vf);                      // mov [VF], dl
+                Emit({ 0xD0, 0xE0 });                           // shl al, 1
+                EmitRbx({ 0x88 }, AL, vx);                      // mov [Vx], al
+                break;
+            }
+            EmitRbx({ 0x8A }, AL, vx);                          // mov al, [Vx]
+            Emit({ 0xC0, 0xE8, 0x07 });                         // shr al, 7
+            EmitRbx({ 0x88 }, AL, vf);                          // mov [VF], al
+            EmitRbx({ 0xD0 }, 4, vx);                           // shl byte [Vx], 1
+            break;
+        case OpcodeId::OP_Annn:
+            Emit({ 0x66 });
+            EmitRbx({ 0xC7 }, 0, m_IndexOffset);                // mov word [I], nnn
+            Emit({ static_cast<uint8_t>(ins.nnn), static_cast<uint8_t>(ins.nnn >> 8) });
+            break;
+        case OpcodeId::OP_Fx07:
+            EmitRbx({ 0x8A }, AL, m_DelayTimerOffset);          // mov al, [DT]
+            EmitRbx({ 0x88 }, AL, vx);                          // mov [Vx], al
+            break;
+        case OpcodeId::OP_Fx15:
+            EmitRbx({ 0x8A }, AL, vx);                          // mov al, [Vx]
+            EmitRbx({ 0x88 }, AL, m_DelayTimerOffset);          // mov [DT], al
+            break;
+        case OpcodeId::OP_Fx18:
+            EmitRbx({ 0x8A }, AL, vx);                          // mov al, [Vx]
+            EmitRbx({ 0x88 }, AL, m_SoundTimerOffset);          // mov [ST], al
+            break;
+        case OpcodeId::OP_Fx1E:
+            EmitRbx({ 0x0F, 0xB6 }, AL, vx);                    // movzx eax, byte [Vx]
+            Emit({ 0x66 });
+            EmitRbx({ 0x01 }, AL, m_IndexOffset);               // add word [I], ax
+            break;
+        case OpcodeId::OP_Fx29:
+            EmitRbx({ 0x0F, 0xB6 }, AL, vx);                    // movzx eax, byte [Vx]
+            Emit({ 0x83, 0xE0, 0x0F });                         // and eax, 0xF
+            Emit({ 0x8D, 0x04, 0x80 });                         // lea eax, [rax + rax * 4]
+            Emit({ 0x83, 0xC0, static_cast<uint8_t>(FONTSET_START_ADDR) }); // add eax, FONTSET_START_ADDR
+            Emit({ 0x66 });
+            EmitRbx({ 0x89 }, AL, m_IndexOffset);               // mov word [I], ax
+            break;
+        default:
+            // Stack, display, keypad, RNG and memory access run through the interpreter
+            EmitStoreProgramCounter(address + 2);
+            m_Instructions.push_back(ins);
+            EmitFallback(m_Instructions.back());
+            break;
+    }
+}
+
+bool JitCompiler::Compile(const Chip8& chip8, uint16_t pc, CompiledBlock& block) {
+    block.start = pc;
+    block.count = 0;
+    m_Emit.clear();
+
+    // uint32_t block(Chip8* chip8 [rdi -> rbx], uint32_t budget [esi -> ebp])
+    Emit({ 0x53 });                                             // push rbx
+    Emit({ 0x55 });                                             // push rbp
+    Emit({ 0x48, 0x83, 0xEC, 0x08 });                           // sub rsp, 8 (keep calls 16-byte aligned)
+    Emit({ 0x48, 0x89, 0xFB });                                 // mov rbx, rdi
+    Emit({ 0x89, 0xF5 });                                       // mov ebp, esi
+
+    // (instruction index, jump displacement position) for each budget check
+    // and for each check after a store
+    std::vector<std::pair<uint16_t, size_t>> budgetExits;
+    std::vector<std::pair<uint16_t, size_t>> storeExits;
+
+    uint16_t address = pc;
+    bool endsBlock = false;
+    while (!endsBlock && block.count < MAX_BLOCK_LENGTH && address + 1u < MEMORY_SIZE) {
+        uint16_t opcode = (chip8.m_Data[address] << 8u) | chip8.m_Data[address + 1];
+        OpcodeId id = DecodeOpcodeId(opcode);
+
+        // Unknown opcodes are left to the interpreter so the exception is not thrown through native frames
+        if (id == OpcodeId::Unknown) {
+            break;
+        }
+
+        // Leave the block early once the cycle budget is spent
+        if (block.count > 0) {
+            Emit({ 0x83, 0xFD, static_cast<uint8_t>(block.count) }); // cmp ebp, count
+            Emit({ 0x0F, 0x84 });                               // je exit
+            budgetExits.emplace_back(block.count, m_Emit.size());
+            Emit32(0);
+        }
+
+        EmitInstruction(Chip8::Decode(opcode, Variant::Chip8, chip8.m_QuirkProfile), address, GetQuirks(chip8.m_QuirkProfile));
+        m_CodeBytes.Set(address);
+        m_CodeBytes.Set(address + 1);
+        block.count++;
+        address += 2;
+
+        // Stores stay in the block; leave it only if one overwrote it. The
+        // fallback has already stored the PC past the store.
+        if (WritesMemory(id)) {
+            Emit({ 0x48, 0xB8 });                               // mov rax, &block.valid
+            Emit64(reinterpret_cast<uint64_t>(&block.valid));
+            Emit({ 0x80, 0x38, 0x00 });                         // cmp byte [rax], 0
+            Emit({ 0x0F, 0x84 });                               // je exit
+            storeExits.emplace_back(block.count, m_Emit.size());
+            Emit32(0);
+        }
+        endsBlock = EndsBlock(id) && !WritesMemory(id);
+    }
+
+    block.end = address;
+    if (block.count == 0) {
+        return false;
+    }
+
+    if (!endsBlock) {
+        EmitStoreProgramCounter(address);
+    }
+    EmitReturn(block.count);
+
+    for (const auto& [count, displacement] : budgetExits) {
+        uint32_t target = static_cast<uint32_t>(m_Emit.size() - (displacement + 4));
+        std::memcpy(&m_Emit[displacement], &target, sizeof(target));
+        EmitStoreProgramCounter(pc + 2 * count);
+        EmitReturn(count);
+    }
+    for (const auto& [count, displacement] : storeExits) {
+        uint32_t target = static_cast<uint32_t>(m_Emit.size() - (displacement + 4));
+        std::memcpy(&m_Emit[displacement], &target, sizeof(target));
+        EmitReturn(count);
+    }
+
+    mprotect(m_Code, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE);
+    std::memcpy(m_Code + m_CodeSize, m_Emit.data(), m_Emit.size());
+    mprotect(m_Code, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_EXEC);
+
+    block.code = reinterpret_cast<uint32_t (*)(Chip8*, uint32_t)>(m_Code + m_CodeSize);
+    block.valid = true;
+    m_CodeSize += m_Emit.size();
+    return true;
+}
+
+const CompiledBlock* JitCompiler::Lookup(const Chip8& chip8, uint16_t pc) {
+    if (pc + 1u >= MEMORY_SIZE) {
+        return nullptr;
+    }
+
+    uint16_t index = m_BlockIndex[pc];
+    if (index != 0 && m_Blocks[index - 1].valid) {
+        return &m_Blocks[index - 1];
+    }
+
+    // Out of code space: drop everything and start over
+    if (m_CodeSize + MAX_BLOCK_CODE_SIZE > JIT_CODE_BUFFER_SIZE) {
+        Flush();
+        index = 0;
+    }
+
+    if (index == 0) {
+        m_Blocks.push_back({});
+        index = static_cast<uint16_t>(m_Blocks.size());
+        m_BlockIndex[pc] = index;
+    }
+
+    CompiledBlock& block = m_Blocks[index - 1];
+    return Compile(chip8, pc, block) ? &block : nullptr;
+}
+
+void JitCompiler::Execute(Chip8& chip8, uint32_t cycles) {
+    while (cycles > 0) {
+        const CompiledBlock* block = Lookup(chip8, chip8.m_ProgramCounter);
+
+        if (block == nullptr) {
+            chip8.Cycle();
+            cycles--;
+        } else {
+            cycles -= block->code(&chip8, cycles);
+        }
+    }
+}
+
+void JitCompiler::Invalidate(uint16_t address, uint16_t length) {
+    ForEachWrittenRange(address, length, [this](unsigned int first, unsigned int last) { InvalidateRange(first, last); });
+}
+
+void JitCompiler::InvalidateRange(unsigned int address, unsigned int last) {
+    if (!m_CodeBytes.Touches(address, last)) {
+        return;
+    }
+
+    // Invalidated code stays in the buffer (it may be executing) until the next flush
+    unsigned int first = address >= 2 * MAX_BLOCK_LENGTH ? address - 2 * MAX_BLOCK_LENGTH + 1 : 0;
+    for (unsigned int pc = first; pc <= last; pc++) {
+        uint16_t index = m_BlockIndex[pc];
+        if (index == 0) {
+            continue;
+        }
+
+        CompiledBlock& block = m_Blocks[index - 1];
+        if (block.valid && block.start <= last && block.end > address) {
+            block.valid = false;
+        }
+    }
+}
+
+void JitCompiler::Flush() {
+    m_BlockIndex.fill(0);
+    m_Blocks.clear();
+    m_Instructions.clear();
+    m_CodeBytes.Reset();
+    m_CodeSize = 0;
+}
+
+#else
+
+JitCompiler::JitCompiler(const Chip8&) {
+    throw std::runtime_error("The JIT backend is only available on x86-64 Linux and macOS");
+}
+
+JitCompiler::~JitCompiler() = default;
+
+void JitCompiler::Execute(Chip8&, uint32_t) {}
+void JitCompiler::Invalidate(uint16_t, uint16_t) {}
+void JitCompiler::Flush() {}
+
+#endif
+
+} // namespace Chip8Emulator
@@ -0,0 +1,109 @@
+#include "log.hpp"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+
+namespace Chip8Emulator{
+
+namespace {
+
+constexpr std::chrono::milliseconds DRAIN_INTERVAL{10};
+
+const char* const LEVEL_NAMES[] = { "trace", "debug", "info", "warn", "error" };
+
+} // namespace
+
+// The ring is the bounded MPMC queue of Vyukov, used with a single consumer:
+// a slot's sequence says whether it is free for the writer at that position
+// (sequence == position) or published for the reader (sequence == position + 1).
+struct Logger::Slot {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    char text[LOG_MESSAGE_SIZE];
+};
+
+Logger& Logger::Get() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+: m_Slots(std::make_unique<Slot[]>(LOG_RING_SIZE))
+{
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    m_Drain = std::thread([this]() {
+        while (!m_Stop.load(std::memory_order_acquire)) {
+            Drain();
+            std::this_thread::sleep_for(DRAIN_INTERVAL);
+        }
+        Drain();
+    });
+}
+
+Logger::~Logger() {
+    m_Stop.store(true, std::memory_order_release);
+    m_Drain.join();
+}
+
+void Logger::Write(LogLevel level, const char* format, ...) {
+    size_t position = m_WritePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &m_Slots[position & (LOG_RING_SIZE - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (difference == 0) {
+            if (m_WritePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            m_Dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = m_WritePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(slot->text, sizeof(slot->text), format, args);
+    va_end(args);
+
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::Drain() {
+    size_t position = m_ReadPos.load(std::memory_order_relaxed);
+    bool wrote = false;
+
+    for (;;) {
+        Slot& slot = m_Slots[position & (LOG_RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            break;
+        }
+
+        fprintf(stderr, "[%s] %s\n", LEVEL_NAMES[static_cast<int>(slot.level)], slot.text);
+        slot.sequence.store(position + LOG_RING_SIZE, std::memory_order_release);
+        position++;
+        wrote = true;
+    }
+
+    m_ReadPos.store(position, std::memory_order_release);
+    if (wrote) {
+        fflush(stderr);
+    }
+}
+
+void Logger::Flush() {
+    size_t target = m_WritePos.load(std::memory_order_acquire);
+    while (m_ReadPos.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(DRAIN_INTERVAL / 10);
+    }
+}
+
+} // namespace Chip8Emulator
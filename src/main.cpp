@@ -1,25 +1,25 @@
+#include <algorithm>
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <chrono>
 #include <stdexcept>
 #include "raylib.h"
 #include "screen.hpp"
+#include "capture.hpp"
 #include "chip8.hpp"
+#include "display.hpp"
+#include "input_log.hpp"
+#include "emulation_thread.hpp"
+#include "profiler.hpp"
+#include "rom.hpp"
+#include "rom_catalog.hpp"
 #include <getopt.h>
 
-constexpr int TEXTURE_WIDTH = 64;
-constexpr int TEXTURE_HEIGHT = 32;
-constexpr int CPU_CLOCK_SPEED = 600; // 600 Hz 
-constexpr float CYCLE_DURATION = 1000.0f / CPU_CLOCK_SPEED; // in milliseconds
-constexpr int TIMER_FREQUENCY = 60; // 60 Hz
-constexpr float TIMER_DURATION = 1000.0f / TIMER_FREQUENCY; // in milliseconds
+constexpr int TEXTURE_WIDTH = Chip8Emulator::HIRES_WIDTH;
+constexpr int TEXTURE_HEIGHT = Chip8Emulator::HIRES_HEIGHT;
 
-using Clock = std::chrono::high_resolution_clock;
-using Milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>;
-
-void RunEmulationLoop(Screen& screen, Chip8Emulator::Chip8& chip8);
-void HandleInput(Screen& screen, Chip8Emulator::Chip8& chip8, bool& shouldClose);
-void UpdateTimers(Clock::time_point& lastTimerUpdateTime, Chip8Emulator::Chip8& chip8, Screen& screen);
+void RunRenderLoop(Screen& screen, Chip8Emulator::EmulationThread& emulation, bool turbo);
 
 int main(int argc, char* argv[])
 {
@@ -28,19 +28,47 @@ int main(int argc, char* argv[])
     int screenHeight = 320;
     int framesPerSecond = 60;
     const char* romFilename = nullptr;
-    
+    Chip8Emulator::ExecutionMode mode = Chip8Emulator::ExecutionMode::Interpreter;
+    bool deterministic = false;
+    uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+    const char* recordFilename = nullptr;
+    uint32_t clockHz = Chip8Emulator::CPU_CLOCK_SPEED;
+    bool clockSet = false;
+    bool turbo = false;
+    Chip8Emulator::Variant variant = Chip8Emulator::Variant::Chip8;
+    bool variantSet = false;
+    Chip8Emulator::QuirkProfile quirks{};
+    bool quirksSet = false;
+    bool mute = false;
+    const char* catalogFilename = nullptr;
+    const char* captureFilename = nullptr;
+    Chip8Emulator::CaptureFormat captureFormat = Chip8Emulator::CaptureFormat::Gif;
+    unsigned int captureScale = 4;
+
     // Command-line options
     static struct option long_options[] = {
         {"width", required_argument, 0, 'w'},
         {"height", required_argument, 0, 'h'},
         {"fps", required_argument, 0, 'f'},
+        {"backend", required_argument, 0, 'b'},
+        {"seed", required_argument, 0, 's'},
+        {"record", required_argument, 0, 'o'},
+        {"clock", required_argument, 0, 'c'},
+        {"turbo", no_argument, 0, 't'},
+        {"variant", required_argument, 0, 'v'},
+        {"quirks", required_argument, 0, 'q'},
+        {"mute", no_argument, 0, 'm'},
+        {"catalog", required_argument, 0, 'a'},
         {"rom", required_argument, 0, 'r'},
+        {"capture", required_argument, 0, 'g'},
+        {"capture-format", required_argument, 0, 'e'},
+        {"capture-scale", required_argument, 0, 'x'},
         {0, 0, 0, 0}
     };
 
     int opt;
     int option_index = 0;
-    while ((opt = getopt_long(argc, argv, "w:h:f:r:", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "w:h:f:b:s:o:c:tv:q:ma:r:g:e:x:", long_options, &option_index)) != -1) {
         switch (opt) {
             case 'w':
                 screenWidth = std::stoi(optarg);
@@ -51,12 +79,77 @@ int main(int argc, char* argv[])
             case 'f':
                 framesPerSecond = std::stoi(optarg);
                 break;
+            case 'b':
+                if (!Chip8Emulator::ParseExecutionMode(optarg, mode)) {
+                    std::cerr << "Unknown backend: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case 's':
+                seed = std::stoull(optarg);
+                deterministic = true;
+                break;
+            case 'o':
+                recordFilename = optarg;
+                deterministic = true;
+                break;
+            case 'c':
+                clockHz = static_cast<uint32_t>(std::stoul(optarg));
+                clockSet = true;
+                break;
+            case 't':
+                turbo = true;
+                break;
+            case 'v':
+                if (!Chip8Emulator::ParseVariant(optarg, variant)) {
+                    std::cerr << "Unknown variant: " << optarg << "\n";
+                    return 1;
+                }
+                variantSet = true;
+                break;
+            case 'q':
+                if (!Chip8Emulator::ParseQuirkProfile(optarg, quirks)) {
+                    std::cerr << "Unknown quirk profile: " << optarg << "\n";
+                    return 1;
+                }
+                quirksSet = true;
+                break;
+            case 'm':
+                mute = true;
+                break;
+            case 'a':
+                catalogFilename = optarg;
+                break;
+            case 'g':
+                captureFilename = optarg;
+                break;
+            case 'e':
+                if (!Chip8Emulator::ParseCaptureFormat(optarg, captureFormat)) {
+                    std::cerr << "Unknown capture format: " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case 'x':
+                captureScale = static_cast<unsigned int>(std::stoul(optarg));
+                break;
             default:
                   std::cerr << "Usage: " << argv[0] << " [options] <ROM file>\n"
                           << "Options:\n"
                           << "  --width <width>     Set screen width (default: 640)\n"
                           << "  --height <height>   Set screen height (default: 320)\n"
-                          << "  --fps <fps>         Set frames per second (default: 60)\n";
+                          << "  --fps <fps>         Set frames per second (default: 60)\n"
+                          << "  --backend <name>    interpreter, block, jit or aot (default: interpreter)\n"
+                          << "  --seed <n>          Run deterministically with this RNG seed\n"
+                          << "  --record <file>     Run deterministically and record input to file\n"
+                          << "  --clock <hz>        CPU clock, rounded down to a multiple of 60 (default: 600)\n"
+                          << "  --turbo             Run uncapped (hold Tab to fast-forward otherwise)\n"
+                          << "  --variant <name>    chip8, schip or xochip (default: chip8)\n"
+                          << "  --quirks <name>     modern, cosmac, schip or xochip (default: the variant's)\n"
+                          << "  --mute              Run without an audio device\n"
+                          << "  --catalog <file>    Take unset variant, quirks and clock from a ROM catalog\n"
+                          << "  --capture <path>    Record every frame (for ppm, the prefix of one file per frame)\n"
+                          << "  --capture-format <name>  raw, ppm or gif (default: gif)\n"
+                          << "  --capture-scale <n> Pixel size of ppm and gif captures (default: 4)\n";
                 return 1;
         }
     }
@@ -71,68 +164,163 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    if (catalogFilename != nullptr) {
+        try {
+            Chip8Emulator::RomInfo info = Chip8Emulator::LookUpRom(catalogFilename, romFilename);
+            // The catalog's quirks belong to its variant
+            if (!variantSet) {
+                variant = info.variant;
+                if (!quirksSet) {
+                    quirks = info.quirks;
+                    quirksSet = true;
+                }
+            }
+            if (!clockSet) {
+                clockHz = info.clockHz;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to look up ROM in catalog: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    uint32_t cyclesPerFrame = Chip8Emulator::CyclesPerFrame(clockHz);
+    if (cyclesPerFrame == 0) {
+        std::cerr << "--clock must be at least " << Chip8Emulator::TIMER_FREQUENCY << " Hz\n";
+        return 1;
+    }
+
+    Chip8Emulator::ToneGenerator tone; // Outlives the screen's audio stream
     Screen screen("CHIP-8 Emulator", screenWidth, screenHeight, TEXTURE_WIDTH, TEXTURE_HEIGHT, framesPerSecond);
-    Chip8Emulator::Chip8 chip8;
+    Chip8Emulator::Chip8 chip8(seed);
+    std::unique_ptr<Chip8Emulator::InputRecorder> recorder;
+    std::unique_ptr<Chip8Emulator::FrameCapture> capture;
 
     try {
-        chip8.LoadROM(romFilename);
+        chip8.SetExecutionMode(mode);
+        chip8.SetVariant(variant);
+        if (quirksSet) {
+            chip8.SetQuirkProfile(quirks);
+        }
+        Chip8Emulator::RomImage rom(romFilename);
+        chip8.LoadROM(rom.GetData(), rom.GetSize());
+        if (recordFilename != nullptr) {
+            recorder = std::make_unique<Chip8Emulator::InputRecorder>(recordFilename, rom.GetHash(), seed,
+                                                                       cyclesPerFrame, variant,
+                                                                       chip8.GetQuirkProfile());
+        }
     } catch (const std::exception& e) {
         std::cerr << "Failed to load ROM: " << e.what() << "\n";
         return 1;
     }
 
-    RunEmulationLoop(screen, chip8);
+    if (captureFilename != nullptr) {
+        try {
+            capture = std::make_unique<Chip8Emulator::FrameCapture>(captureFilename, captureFormat, variant, captureScale);
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to start capture: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    // Muted runs leave the buzzer unconnected instead of opening a device
+    if (!mute) {
+        screen.StartAudio(tone);
+    }
+
+    Chip8Emulator::EmulationThread emulation(chip8, cyclesPerFrame, deterministic, recorder.get(),
+                                             mute ? nullptr : &tone, capture.get());
+    emulation.SetTurbo(turbo);
+    emulation.Start();
+    RunRenderLoop(screen, emulation, turbo);
+
+    try {
+        emulation.Stop();
+    } catch (const std::exception& e) {
+        std::cerr << "Emulation failed: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (double hz = emulation.GetAverageTurboHz(); hz > 0.0) {
+        std::cout << "turbo: " << hz / 1e6 << " MHz effective\n";
+    }
+
+    if (recorder) {
+        recorder->Close(chip8.GetCycleCount());
+    }
+
+    if (capture) {
+        try {
+            capture->Stop();
+        } catch (const std::exception& e) {
+            std::cerr << "Capture failed: " << e.what() << "\n";
+            return 1;
+        }
+        std::cout << "captured " << capture->GetCapturedCount() << " frames, dropped "
+                  << capture->GetDroppedCount() << "\n";
+    }
+
+    if (deterministic) {
+        std::cout << "cycles: " << chip8.GetCycleCount() << ", framebuffer hash: "
+                  << std::hex << chip8.GetDisplayHash() << std::dec << "\n";
+    }
+
+    // Profiling builds dump chip8-profile.json and chip8-profile.folded on exit
+    if (const auto* profiler = chip8.GetProfiler()) {
+        profiler->Write("chip8-profile");
+    }
     return 0;
 }
 
-void RunEmulationLoop(Screen& screen, Chip8Emulator::Chip8& chip8)
+// Presents the newest finished frame and forwards input; all emulation timing
+// lives on the emulation thread, so vsync or a slow frame here cannot stall it.
+void RunRenderLoop(Screen& screen, Chip8Emulator::EmulationThread& emulation, bool turbo)
 {
-    auto lastCycleTime = Clock::now();
-    auto lastTimerUpdateTime = lastCycleTime;
+    uint8_t keys[Chip8Emulator::KEY_COUNT] = {};
+    auto presented = std::make_unique<Chip8Emulator::Frame>();
+    presented->width = Chip8Emulator::VIDEO_WIDTH;
+    presented->height = Chip8Emulator::VIDEO_HEIGHT;
+    presented->planeCount = 1;
+    uint64_t dirtyRows = ~0ull; // Upload everything on the first frame
 
     bool shouldClose = false;
 
-    while (!shouldClose)
+    while (!shouldClose && emulation.IsRunning())
     {
-        HandleInput(screen, chip8, shouldClose);
+        if (WindowShouldClose() || screen.ProcessInput(keys)) {
+            shouldClose = true;
+        }
+        emulation.SetKeys(Chip8Emulator::PackKeys(keys));
 
-        auto currentTime = Clock::now();
-        auto dt = std::chrono::duration_cast<Milliseconds>(currentTime - lastCycleTime).count();
+        // Holding Backspace steps back one recorded state per timer tick
+        emulation.SetRewinding(IsKeyDown(KEY_BACKSPACE));
+        emulation.SetTurbo(turbo || IsKeyDown(KEY_TAB));
 
-        // Run multiple CPU cycles per frame to keep up with the desired CPU clock speed
-        while (dt >= CYCLE_DURATION)
-        {
-            chip8.Cycle();
-            dt -= CYCLE_DURATION;
-            lastCycleTime += std::chrono::milliseconds(static_cast<int>(CYCLE_DURATION));
+        if (emulation.UpdateFrame()) {
+            const auto& frame = emulation.GetFrame();
+            if (frame.width != presented->width || frame.planeCount != presented->planeCount) {
+                dirtyRows = ~0ull;
+            }
+            unsigned int rowWords = frame.width / 64;
+            for (unsigned int plane = 0; plane < frame.planeCount; plane++) {
+                dirtyRows |= Chip8Emulator::DiffDisplayRows(frame.planes[plane], presented->planes[plane], frame.height, rowWords);
+            }
+            *presented = frame;
         }
 
-        UpdateTimers(lastTimerUpdateTime, chip8, screen);
-
-        screen.Update2DTexture(chip8.getDisplay());
+        const uint64_t* planes[Chip8Emulator::MAX_PLANES];
+        for (unsigned int plane = 0; plane < Chip8Emulator::MAX_PLANES; plane++) {
+            planes[plane] = presented->planes[plane];
+        }
+        screen.Update2DTexture(planes, presented->planeCount, presented->width, presented->height, dirtyRows);
+        dirtyRows = 0;
 
         BeginDrawing();
         ClearBackground(BLACK);
         screen.DrawScaledTexture();
+        if (emulation.IsTurbo()) {
+            DrawText(TextFormat("TURBO %.2f MHz", emulation.GetEffectiveHz() / 1e6), 8, 8, 20, GREEN);
+        }
         EndDrawing();
     }
 }
-
-void HandleInput(Screen& screen, Chip8Emulator::Chip8& chip8, bool& shouldClose)
-{
-    if (WindowShouldClose() || screen.ProcessInput(chip8.getKeypad())) {
-        shouldClose = true;
-    }
-}
-
-void UpdateTimers(Clock::time_point& lastTimerUpdateTime, Chip8Emulator::Chip8& chip8, Screen& screen)
-{
-    auto currentTime = Clock::now();
-    auto timerDt = std::chrono::duration_cast<Milliseconds>(currentTime - lastTimerUpdateTime).count();
-
-    if (timerDt >= TIMER_DURATION)
-    {
-        chip8.DecrementTimers([&screen]() { screen.PlayBeep(); });
-        lastTimerUpdateTime += std::chrono::milliseconds(static_cast<int>(TIMER_DURATION));
-    }
-}
@@ -0,0 +1,144 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <vector>
+
+namespace Chip8Emulator{
+
+namespace {
+
+// Indexed by OpcodeId
+const char* const OPCODE_NAMES[] = {
+    "Unknown",
+    "OP_00E0", "OP_00EE", "OP_1nnn", "OP_2nnn", "OP_3xkk", "OP_4xkk", "OP_5xy0", "OP_6xkk", "OP_7xkk",
+    "OP_8xy0", "OP_8xy1", "OP_8xy2", "OP_8xy3", "OP_8xy4", "OP_8xy5", "OP_8xy6", "OP_8xy7", "OP_8xyE",
+    "OP_9xy0", "OP_Annn", "OP_Bnnn", "OP_Cxkk", "OP_Dxyn", "OP_Ex9E", "OP_ExA1",
+    "OP_Fx07", "OP_Fx0A", "OP_Fx15", "OP_Fx18", "OP_Fx1E", "OP_Fx29", "OP_Fx33", "OP_Fx55", "OP_Fx65",
+    "OP_00Cn", "OP_00FB", "OP_00FC", "OP_00FD", "OP_00FE", "OP_00FF", "OP_Fx30", "OP_Fx75", "OP_Fx85",
+    "OP_00Dn", "OP_5xy2", "OP_5xy3", "OP_F000", "OP_Fn01", "OP_F002", "OP_Fx3A",
+};
+
+static_assert(std::size(OPCODE_NAMES) == static_cast<size_t>(OpcodeId::Count));
+
+// Handlers grouped by their leading opcode nibble, e.g. OP_8xy4 -> 8xxx
+std::string OpcodeFamily(OpcodeId id) {
+    if (id == OpcodeId::Unknown) {
+        return "Unknown";
+    }
+    return std::string(1, OPCODE_NAMES[static_cast<size_t>(id)][3]) + "xxx";
+}
+
+std::string Hex(unsigned int value) {
+    char text[8];
+    snprintf(text, sizeof(text), "0x%03X", value);
+    return text;
+}
+
+struct HotLoop {
+    uint16_t start;
+    uint16_t end;
+    uint64_t iterations;
+    uint64_t instructions;
+    uint64_t ticks;
+};
+
+} // namespace
+
+const char* OpcodeName(OpcodeId id) {
+    return OPCODE_NAMES[static_cast<size_t>(id)];
+}
+
+Profiler::Profiler()
+: m_StartTicks(Now()),
+  m_StartTime(std::chrono::steady_clock::now())
+{
+}
+
+void Profiler::WriteJson(std::ostream& out) const {
+    uint64_t instructions = std::accumulate(m_OpcodeCounts.begin(), m_OpcodeCounts.end(), uint64_t{0});
+    uint64_t ticks = std::accumulate(m_OpcodeTicks.begin(), m_OpcodeTicks.end(), uint64_t{0});
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_StartTime).count();
+    double tickRate = seconds > 0.0 ? (Now() - m_StartTicks) / seconds : 0.0;
+
+    out << "{\n"
+        << "  \"instructions\": " << instructions << ",\n"
+        << "  \"ticks\": " << ticks << ",\n"
+        << "  \"ticks_per_second\": " << static_cast<uint64_t>(tickRate) << ",\n";
+
+    out << "  \"opcodes\": [";
+    bool first = true;
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (m_OpcodeCounts[i] == 0) {
+            continue;
+        }
+        out << (first ? "\n" : ",\n") << "    {\"name\": \"" << OPCODE_NAMES[i] << "\", \"count\": " << m_OpcodeCounts[i]
+            << ", \"ticks\": " << m_OpcodeTicks[i] << "}";
+        first = false;
+    }
+    out << "\n  ],\n";
+
+    out << "  \"pc_histogram\": [";
+    first = true;
+    for (unsigned int pc = 0; pc < MEMORY_SIZE; pc++) {
+        if (m_PcHits[pc] == 0) {
+            continue;
+        }
+        out << (first ? "\n" : ",\n") << "    {\"pc\": \"" << Hex(pc) << "\", \"hits\": " << m_PcHits[pc]
+            << ", \"ticks\": " << m_PcTicks[pc] << "}";
+        first = false;
+    }
+    out << "\n  ],\n";
+
+    // Each backward branch closes a loop; rank them by the instructions spent inside
+    std::vector<HotLoop> loops;
+    for (unsigned int pc = 0; pc < MEMORY_SIZE; pc++) {
+        if (m_BranchCount[pc] == 0) {
+            continue;
+        }
+
+        HotLoop loop{ m_BranchTarget[pc], static_cast<uint16_t>(pc), m_BranchCount[pc], 0, 0 };
+        for (unsigned int address = loop.start; address <= loop.end; address++) {
+            loop.instructions += m_PcHits[address];
+            loop.ticks += m_PcTicks[address];
+        }
+        loops.push_back(loop);
+    }
+
+    std::sort(loops.begin(), loops.end(), [](const HotLoop& a, const HotLoop& b) {
+        return a.instructions > b.instructions;
+    });
+    loops.resize(std::min(loops.size(), PROFILER_HOT_LOOPS));
+
+    out << "  \"hot_loops\": [";
+    first = true;
+    for (const auto& loop : loops) {
+        out << (first ? "\n" : ",\n") << "    {\"start\": \"" << Hex(loop.start) << "\", \"end\": \"" << Hex(loop.end)
+            << "\", \"iterations\": " << loop.iterations << ", \"instructions\": " << loop.instructions
+            << ", \"ticks\": " << loop.ticks << "}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
+
+void Profiler::WriteFolded(std::ostream& out) const {
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (m_OpcodeCounts[i] == 0) {
+            continue;
+        }
+
+        auto id = static_cast<OpcodeId>(i);
+        out << "chip8;" << OpcodeFamily(id) << ";" << OPCODE_NAMES[i] << " " << m_OpcodeTicks[i] << "\n";
+    }
+}
+
+void Profiler::Write(const std::string& prefix) const {
+    std::ofstream json(prefix + ".json");
+    WriteJson(json);
+
+    std::ofstream folded(prefix + ".folded");
+    WriteFolded(folded);
+}
+
+} // namespace Chip8Emulator
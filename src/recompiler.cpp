@@ -0,0 +1,319 @@
+#include "recompiler.hpp"
+#include "disassembler.hpp"
+#include "log.hpp"
+#include "profiler.hpp"
+#include "rom.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace Chip8Emulator{
+
+namespace {
+
+// Indexed by QuirkProfile
+const char* const PROFILE_ENUMERATORS[] = { "Modern", "Cosmac", "SuperChip", "XoChip" };
+
+static_assert(std::size(PROFILE_ENUMERATORS) == static_cast<size_t>(QuirkProfile::Count));
+
+class Writer {
+private:
+    std::string m_Text;
+    unsigned int m_Indent = 0;
+
+public:
+    void Indent(unsigned int levels) { m_Indent = levels; }
+
+    void Line(const char* format, ...) CHIP8_PRINTF_FORMAT(2, 3) {
+        m_Text.append(m_Indent * 4, ' ');
+
+        va_list args;
+        va_start(args, format);
+        va_list copy;
+        va_copy(copy, args);
+        int length = vsnprintf(nullptr, 0, format, copy);
+        va_end(copy);
+
+        size_t offset = m_Text.size();
+        m_Text.resize(offset + length + 1);
+        vsnprintf(m_Text.data() + offset, length + 1, format, args);
+        va_end(args);
+        m_Text.back() = '\n';
+    }
+
+    void Blank() { m_Text += '\n'; }
+
+    std::string& Text() { return m_Text; }
+};
+
+struct Generator {
+    const uint8_t* rom;
+    size_t size;
+    QuirkProfile profile;
+    std::vector<BasicBlock> blocks;
+    std::vector<int> blockAt = std::vector<int>(MEMORY_SIZE, -1); // Block index by start address
+    Writer out;
+
+    Generator(const uint8_t* rom, size_t size, QuirkProfile profile)
+    : rom(rom),
+      size(size),
+      profile(profile),
+      blocks(FindBasicBlocks(rom, size))
+    {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            blockAt[blocks[i].start] = static_cast<int>(i);
+        }
+    }
+
+    uint16_t Word(uint32_t address) const {
+        return (rom[address - START_ADDR] << 8) | rom[address - START_ADDR + 1];
+    }
+
+    // Leaves the block for target, running target's code directly if it was
+    // compiled, is still valid and budget remains
+    void Continue(uint32_t target) {
+        int block = target < MEMORY_SIZE ? blockAt[target] : -1;
+        if (block >= 0) {
+            out.Line("if (executed < budget && valid[%d]) return Block_%04X(chip8, valid, budget, executed, 0x%04X);",
+                     block, blocks[block].start, target);
+        }
+        out.Line("return Aot::Exit(chip8, 0x%04X, executed);", target & 0xFFFF);
+    }
+
+    void Call(uint32_t address, OpcodeId id, uint16_t opcode) {
+        out.Line("Aot::Call<Q>(chip8, 0x%04X, OpcodeId::%s, 0x%04X);", address, OpcodeName(id), opcode);
+    }
+
+    // Straight-line instructions that only touch registers, timers and I are
+    // written out in full, matching the interpreter's handlers for the profile.
+    // Returns false for anything that has to go through a handler.
+    bool Inline(OpcodeId id, uint16_t opcode) {
+        const unsigned int x = (opcode >> 8) & 0xF;
+        const unsigned int y = (opcode >> 4) & 0xF;
+        const unsigned int kk = opcode & 0xFF;
+        const unsigned int nnn = opcode & 0xFFF;
+        const Quirks& quirks = GetQuirks(profile);
+
+        switch (id) {
+            case OpcodeId::OP_6xkk: out.Line("V[0x%X] = 0x%02X;", x, kk); break;
+            case OpcodeId::OP_7xkk: out.Line("V[0x%X] += 0x%02X;", x, kk); break;
+            case OpcodeId::OP_8xy0:
+                if (x != y) {
+                    out.Line("V[0x%X] = V[0x%X];", x, y);
+                }
+                break;
+            case OpcodeId::OP_8xy1:
+            case OpcodeId::OP_8xy2:
+            case OpcodeId::OP_8xy3: {
+                const char op = id == OpcodeId::OP_8xy1 ? '|' : id == OpcodeId::OP_8xy2 ? '&' : '^';
+                out.Line("V[0x%X] %c= V[0x%X];", x, op, y);
+                if (quirks.logicResetsVf) {
+                    out.Line("V[0xF] = 0;");
+                }
+                break;
+            }
+            case OpcodeId::OP_8xy4:
+                out.Line("{ unsigned int sum = V[0x%X] + V[0x%X]; V[0x%X] = sum & 0xFF; V[0xF] = sum > 0xFF; }", x, y, x);
+                break;
+            case OpcodeId::OP_8xy5:
+            case OpcodeId::OP_8xy7:
+                if (x == y) {
+                    // Both clear VF and then Vx, written out to avoid self-comparisons
+                    out.Line("V[0xF] = 0;");
+                    out.Line("V[0x%X] = 0;", x);
+                } else if (id == OpcodeId::OP_8xy5) {
+                    out.Line("V[0xF] = V[0x%X] > V[0x%X];", x, y);
+                    out.Line("V[0x%X] -= V[0x%X];", x, y);
+                } else {
+                    out.Line("V[0xF] = V[0x%X] > V[0x%X];", y, x);
+                    out.Line("V[0x%X] = V[0x%X] - V[0x%X];", x, y, x);
+                }
+                break;
+            case OpcodeId::OP_8xy6:
+                if (quirks.shiftUsesVy) {
+                    out.Line("{ uint8_t source = V[0x%X]; V[0xF] = source & 0x1; V[0x%X] = source >> 1; }", y, x);
+                } else {
+                    out.Line("V[0xF] = V[0x%X] & 0x1;", x);
+                    out.Line("V[0x%X] >>= 1;", x);
+                }
+                break;
+            case OpcodeId::OP_8xyE:
+                if (quirks.shiftUsesVy) {
+                    out.Line("{ uint8_t source = V[0x%X]; V[0xF] = source >> 7; V[0x%X] = source << 1; }", y, x);
+                } else {
+                    out.Line("V[0xF] = V[0x%X] >> 7;", x);
+                    out.Line("V[0x%X] <<= 1;", x);
+                }
+                break;
+            case OpcodeId::OP_Annn: out.Line("Aot::Index(chip8) = 0x%03X;", nnn); break;
+            case OpcodeId::OP_Fx07: out.Line("V[0x%X] = Aot::DelayTimer(chip8);", x); break;
+            case OpcodeId::OP_Fx15: out.Line("Aot::DelayTimer(chip8) = V[0x%X];", x); break;
+            case OpcodeId::OP_Fx18: out.Line("Aot::SoundTimer(chip8) = V[0x%X];", x); break;
+            case OpcodeId::OP_Fx1E: out.Line("Aot::Index(chip8) += V[0x%X];", x); break;
+            case OpcodeId::OP_Fx29:
+                out.Line("Aot::Index(chip8) = FONTSET_START_ADDR + (V[0x%X] & 0xF) * 5;", x);
+                break;
+            default:
+                return false;
+        }
+        return true;
+    }
+
+    // The condition under which a skip instruction skips
+    static std::string SkipCondition(OpcodeId id, uint16_t opcode) {
+        const unsigned int x = (opcode >> 8) & 0xF;
+        const unsigned int y = (opcode >> 4) & 0xF;
+        const unsigned int kk = opcode & 0xFF;
+
+        // Compilers reject a register compared with itself
+        if ((id == OpcodeId::OP_5xy0 || id == OpcodeId::OP_9xy0) && x == y) {
+            return id == OpcodeId::OP_5xy0 ? "true" : "false";
+        }
+
+        char text[64];
+        switch (id) {
+            case OpcodeId::OP_3xkk: snprintf(text, sizeof(text), "V[0x%X] == 0x%02X", x, kk); break;
+            case OpcodeId::OP_4xkk: snprintf(text, sizeof(text), "V[0x%X] != 0x%02X", x, kk); break;
+            case OpcodeId::OP_5xy0: snprintf(text, sizeof(text), "V[0x%X] == V[0x%X]", x, y); break;
+            case OpcodeId::OP_9xy0: snprintf(text, sizeof(text), "V[0x%X] != V[0x%X]", x, y); break;
+            case OpcodeId::OP_Ex9E: snprintf(text, sizeof(text), "Aot::Keypad(chip8)[V[0x%X] & 0xF]", x); break;
+            case OpcodeId::OP_ExA1: snprintf(text, sizeof(text), "!Aot::Keypad(chip8)[V[0x%X] & 0xF]", x); break;
+            default: return {};
+        }
+        return text;
+    }
+
+    // Each instruction is a case label, so a block can be entered wherever the
+    // program counter stopped at the end of the previous budget
+    void Block(const BasicBlock& block) {
+        out.Indent(0);
+        out.Line("uint32_t Block_%04X(Chip8& chip8, [[maybe_unused]] const uint8_t* valid, [[maybe_unused]] uint32_t budget,",
+                 block.start);
+        out.Line("                    uint32_t executed, uint16_t entry) {");
+        out.Line("    [[maybe_unused]] uint8_t* V = Aot::Registers(chip8);");
+        out.Line("    switch (entry) {");
+
+        for (uint32_t pc = block.start; pc < block.end; pc += 2) {
+            const uint16_t opcode = Word(pc);
+            const OpcodeId id = DecodeOpcodeId(opcode);
+            const uint32_t next = pc + 2;
+
+            out.Indent(1);
+            out.Line("case 0x%04X:", pc);
+            out.Indent(2);
+            out.Line("// 0x%04X  %04X  %s", pc, opcode, Disassemble(opcode).c_str());
+
+            std::string skip = SkipCondition(id, opcode);
+            if (!skip.empty()) {
+                out.Line("executed++;");
+                out.Line("if (%s) {", skip.c_str());
+                out.Indent(3);
+                Continue(next + 2);
+                out.Indent(2);
+                out.Line("}");
+                Continue(next);
+            } else if (id == OpcodeId::OP_1nnn) {
+                out.Line("executed++;");
+                Continue(opcode & 0x0FFF);
+            } else if (id == OpcodeId::OP_2nnn) {
+                Call(pc, id, opcode);
+                out.Line("executed++;");
+                Continue(opcode & 0x0FFF);
+            } else if (id == OpcodeId::OP_00EE || id == OpcodeId::OP_Bnnn || id == OpcodeId::OP_Fx0A) {
+                // The next instruction is only known at run time
+                Call(pc, id, opcode);
+                out.Line("return executed + 1;");
+            } else {
+                if (!Inline(id, opcode)) {
+                    Call(pc, id, opcode);
+                }
+                out.Line("executed++;");
+                if (next == block.end) {
+                    Continue(next);
+                } else {
+                    out.Line("if (executed == budget) return Aot::Exit(chip8, 0x%04X, executed);", next);
+                    out.Line("[[fallthrough]];");
+                }
+            }
+        }
+
+        out.Indent(0);
+        out.Line("    }");
+        out.Line("    return Aot::Exit(chip8, entry, executed);");
+        out.Line("}");
+        out.Blank();
+    }
+};
+
+} // namespace
+
+std::string Recompile(const uint8_t* rom, size_t size, QuirkProfile profile, const std::string& name) {
+    if (size == 0 || size > MEMORY_SIZE - START_ADDR) {
+        throw std::runtime_error("ROM does not fit in CHIP-8 memory.");
+    }
+
+    Generator generator(rom, size, profile);
+    if (generator.blocks.empty()) {
+        throw std::runtime_error("No code found at the start of the ROM.");
+    }
+
+    std::string literal;
+    for (char c : name) {
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+        }
+        literal += c;
+    }
+
+    Writer& out = generator.out;
+    out.Line("// Generated by chip8-aot from %s (quirks: %s). Do not edit.", literal.c_str(), QuirkProfileName(profile));
+    out.Line("#include \"aot_runtime.hpp\"");
+    out.Blank();
+    out.Line("namespace {");
+    out.Blank();
+    out.Line("using namespace Chip8Emulator;");
+    out.Line("using Aot = AotAccess;");
+    out.Blank();
+    out.Line("constexpr QuirkProfile Q = QuirkProfile::%s;", PROFILE_ENUMERATORS[static_cast<size_t>(profile)]);
+    out.Blank();
+    out.Line("const uint8_t ROM[] = {");
+    for (size_t offset = 0; offset < size; offset += 16) {
+        std::string row = "   ";
+        for (size_t i = offset; i < std::min(size, offset + 16); i++) {
+            char byte[8];
+            snprintf(byte, sizeof(byte), " 0x%02X,", rom[i]);
+            row += byte;
+        }
+        out.Line("%s", row.c_str());
+    }
+    out.Line("};");
+    out.Blank();
+
+    for (const auto& block : generator.blocks) {
+        out.Line("uint32_t Block_%04X(Chip8& chip8, const uint8_t* valid, uint32_t budget, uint32_t executed, uint16_t entry);",
+                 block.start);
+    }
+    out.Blank();
+
+    for (const auto& block : generator.blocks) {
+        generator.Block(block);
+    }
+
+    out.Line("const AotBlock BLOCKS[] = {");
+    for (const auto& block : generator.blocks) {
+        out.Line("{ 0x%04X, 0x%04X, &Block_%04X },", block.start, block.end, block.start);
+    }
+    out.Line("};");
+    out.Blank();
+    out.Line("const AotProgram PROGRAM{ \"%s\", ROM, sizeof(ROM), 0x%016" PRIX64 "ull, Q, BLOCKS, std::size(BLOCKS) };",
+             literal.c_str(), HashBytes(rom, size));
+    out.Line("const AotRegistration REGISTRATION(PROGRAM);");
+    out.Blank();
+    out.Line("} // namespace");
+    return std::move(out.Text());
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,165 @@
+#include "rewind.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Chip8Emulator{
+
+namespace {
+
+// Run lengths are stored as 16 bits; longer runs are split
+constexpr size_t MAX_RUN = 0xFFFF;
+
+void PutLength(std::vector<uint8_t>& out, size_t length) {
+    out.push_back(static_cast<uint8_t>(length));
+    out.push_back(static_cast<uint8_t>(length >> 8));
+}
+
+size_t GetLength(const uint8_t* in) {
+    return in[0] | (in[1] << 8);
+}
+
+// Bytes of the state a delta applies to: the sum of its runs
+size_t DeltaSize(const std::vector<uint8_t>& delta) {
+    size_t size = 0;
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+    while (in < end) {
+        size_t changed = GetLength(in + 2);
+        size += GetLength(in) + changed;
+        in += 4 + changed;
+    }
+    return size;
+}
+
+} // namespace
+
+RewindBuffer::RewindBuffer(size_t capacity, size_t keyframeInterval)
+: m_Capacity(std::max<size_t>(capacity, 1)),
+  m_KeyframeInterval(std::max<size_t>(keyframeInterval, 1))
+{
+}
+
+// Delta format: repeated (unchanged run, changed run) 16-bit little-endian
+// lengths, each followed by the XOR of the changed bytes. A null from encodes
+// against all zeros, as keyframes are.
+void RewindBuffer::Encode(const MachineState* from, const MachineState& to, std::vector<uint8_t>& out) {
+    const uint8_t* b = to.bytes.data();
+    const size_t size = to.bytes.size();
+    auto before = [&](size_t k) -> uint8_t { return from ? from->bytes[k] : 0; };
+
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        size_t changed = i;
+        while (changed < size && changed - i < MAX_RUN && before(changed) == b[changed]) {
+            changed++;
+        }
+        size_t end = changed;
+        while (end < size && end - changed < MAX_RUN && before(end) != b[end]) {
+            end++;
+        }
+
+        PutLength(out, changed - i);
+        PutLength(out, end - changed);
+        for (size_t k = changed; k < end; k++) {
+            out.push_back(before(k) ^ b[k]);
+        }
+        i = end;
+    }
+}
+
+// Turns either end of a delta into the other
+void RewindBuffer::Apply(const std::vector<uint8_t>& delta, MachineState& state) {
+    uint8_t* out = state.bytes.data();
+
+    size_t position = 0;
+    const uint8_t* in = delta.data();
+    const uint8_t* end = in + delta.size();
+    while (in < end) {
+        position += GetLength(in);
+        size_t changed = GetLength(in + 2);
+        in += 4;
+
+        for (size_t k = 0; k < changed; k++) {
+            out[position++] ^= *in++;
+        }
+    }
+}
+
+void RewindBuffer::Push(const MachineState& state) {
+    // States of another size (another variant) cannot be diffed, so they start a group
+    if (m_Groups.empty() || m_Groups.back().deltas.size() + 1 >= m_KeyframeInterval ||
+        state.bytes.size() != m_Newest.bytes.size()) {
+        m_Groups.emplace_back();
+        Encode(nullptr, state, m_Groups.back().keyframe);
+    } else {
+        std::vector<uint8_t> delta;
+        if (!m_SpareDeltas.empty()) {
+            delta = std::move(m_SpareDeltas.back());
+            m_SpareDeltas.pop_back();
+        }
+        Encode(&m_Newest, state, delta);
+        m_Groups.back().deltas.push_back(std::move(delta));
+    }
+    m_Newest = state;
+    m_FrameCount++;
+
+    // Drop the oldest group once the rest still covers the capacity
+    while (m_FrameCount - (m_Groups.front().deltas.size() + 1) >= m_Capacity) {
+        Group& oldest = m_Groups.front();
+        m_FrameCount -= oldest.deltas.size() + 1;
+        for (auto& delta : oldest.deltas) {
+            m_SpareDeltas.push_back(std::move(delta));
+        }
+        m_Groups.pop_front();
+    }
+}
+
+bool RewindBuffer::Pop(MachineState& state) {
+    if (m_Groups.empty()) {
+        return false;
+    }
+
+    state = m_Newest;
+    m_FrameCount--;
+
+    Group& group = m_Groups.back();
+    if (!group.deltas.empty()) {
+        Apply(group.deltas.back(), m_Newest);
+        m_SpareDeltas.push_back(std::move(group.deltas.back()));
+        group.deltas.pop_back();
+        return true;
+    }
+
+    // The keyframe was the newest state; rebuild the previous group's last state
+    m_Groups.pop_back();
+    if (!m_Groups.empty()) {
+        const Group& previous = m_Groups.back();
+        m_Newest.bytes.assign(DeltaSize(previous.keyframe), 0);
+        Apply(previous.keyframe, m_Newest);
+        for (const auto& delta : previous.deltas) {
+            Apply(delta, m_Newest);
+        }
+    }
+
+    return true;
+}
+
+void RewindBuffer::Clear() {
+    m_Groups.clear();
+    m_FrameCount = 0;
+}
+
+size_t RewindBuffer::GetMemoryUsage() const {
+    size_t bytes = m_Groups.size() * sizeof(Group);
+    for (const auto& group : m_Groups) {
+        bytes += group.keyframe.size();
+        for (const auto& delta : group.deltas) {
+            bytes += delta.size();
+        }
+    }
+
+    return bytes;
+}
+
+} // namespace Chip8Emulator
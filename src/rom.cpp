@@ -0,0 +1,76 @@
+#include "rom.hpp"
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Chip8Emulator{
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+int64_t ModifiedTime(const struct stat& info) {
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+}
+
+} // namespace
+
+RomImage::RomImage(const char* filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open ROM file.");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        throw std::runtime_error("ROM is not a regular file.");
+    }
+    if (info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("ROM file is empty.");
+    }
+    if (static_cast<uint64_t>(info.st_size) > MAX_ROM_SIZE) {
+        close(fd);
+        throw std::runtime_error("ROM does not fit in memory.");
+    }
+
+    m_Size = info.st_size;
+    m_ModifiedTime = ModifiedTime(info);
+    void* mapping = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map ROM file.");
+    }
+    m_Bytes = static_cast<const uint8_t*>(mapping);
+}
+
+RomImage::~RomImage() {
+    munmap(const_cast<uint8_t*>(m_Bytes), m_Size);
+}
+
+uint64_t HashBytes(const uint8_t* data, size_t size) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool GetFileStamp(const char* filename, uint64_t& size, int64_t& modifiedTime) {
+    struct stat info;
+    if (stat(filename, &info) != 0) {
+        return false;
+    }
+
+    size = info.st_size;
+    modifiedTime = ModifiedTime(info);
+    return true;
+}
+
+} // namespace Chip8Emulator
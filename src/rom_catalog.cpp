@@ -0,0 +1,206 @@
+#include "rom_catalog.hpp"
+#include "disassembler.hpp"
+#include "rom.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace Chip8Emulator{
+
+namespace {
+
+const char* const CATALOG_HEADER = "# hash\tsize\tmtime\tvariant\tquirks\tclock\tpath\ttitle";
+constexpr size_t CATALOG_FIELDS = 8;
+
+std::vector<std::string> SplitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == std::string::npos) {
+            return fields;
+        }
+        start = end + 1;
+    }
+}
+
+} // namespace
+
+uint32_t SuggestedClock(Variant variant) {
+    switch (variant) {
+        case Variant::SuperChip: return 1800;
+        case Variant::XoChip: return 60000;
+        default: return 600;
+    }
+}
+
+Variant IdentifyVariant(const uint8_t* rom, size_t size) {
+    if (size > MEMORY_SIZE - START_ADDR) {
+        return Variant::XoChip;
+    }
+
+    // Code is only followed within the ROM image; anything computed (Bnnn) or
+    // written at run time is invisible to this scan
+    bool superChip = false;
+    for (const auto& block : FindBasicBlocks(rom, size, Variant::XoChip)) {
+        for (uint32_t pc = block.start; pc < block.end;) {
+            uint16_t opcode = (rom[pc - START_ADDR] << 8) | rom[pc - START_ADDR + 1];
+            if (DecodeOpcodeId(opcode, Variant::SuperChip) == OpcodeId::Unknown) {
+                return Variant::XoChip;
+            }
+            if (DecodeOpcodeId(opcode, Variant::Chip8) == OpcodeId::Unknown ||
+                (opcode & 0xF00F) == 0xD000) {
+                superChip = true;
+            }
+            pc += InstructionLength(opcode, Variant::XoChip);
+        }
+    }
+
+    return superChip ? Variant::SuperChip : Variant::Chip8;
+}
+
+void RomCatalog::Load(const char* filename) {
+    m_Entries.clear();
+    m_Scanned = 0;
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return;
+    }
+
+    std::string line;
+    size_t number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        auto fields = SplitFields(line);
+        RomInfo info{};
+        bool valid = fields.size() == CATALOG_FIELDS &&
+                     ParseVariant(fields[3], info.variant) &&
+                     ParseQuirkProfile(fields[4], info.quirks);
+        if (valid) {
+            try {
+                info.hash = std::stoull(fields[0], nullptr, 16);
+                info.size = std::stoull(fields[1]);
+                info.modifiedTime = std::stoll(fields[2]);
+                info.clockHz = static_cast<uint32_t>(std::stoul(fields[5]));
+            } catch (const std::exception&) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            throw std::runtime_error("Malformed ROM catalog line " + std::to_string(number) + ".");
+        }
+
+        info.title = fields[7];
+        m_Entries[fields[6]] = info;
+    }
+}
+
+void RomCatalog::Save(const char* filename) const {
+    std::vector<const std::pair<const std::string, RomInfo>*> sorted;
+    for (const auto& entry : m_Entries) {
+        sorted.push_back(&entry);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    // Written aside and renamed over the old catalog, so a crash never leaves half a file
+    std::string temporary = std::string(filename) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to write ROM catalog.");
+        }
+
+        file << CATALOG_HEADER << "\n";
+        for (const auto* entry : sorted) {
+            const RomInfo& info = entry->second;
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016" PRIx64, info.hash);
+            file << hash << "\t" << info.size << "\t" << info.modifiedTime << "\t"
+                 << VariantName(info.variant) << "\t" << QuirkProfileName(info.quirks) << "\t"
+                 << info.clockHz << "\t" << entry->first << "\t" << info.title << "\n";
+        }
+        if (!file.flush()) {
+            throw std::runtime_error("Failed to write ROM catalog.");
+        }
+    }
+
+    if (std::rename(temporary.c_str(), filename) != 0) {
+        throw std::runtime_error("Failed to replace ROM catalog.");
+    }
+}
+
+const RomInfo& RomCatalog::Update(const std::string& path) {
+    std::error_code error;
+    std::string key = std::filesystem::canonical(path, error).string();
+    if (error) {
+        key = path;
+    }
+
+    // The common case: size and mtime match, and the file is not opened at all
+    auto existing = m_Entries.find(key);
+    uint64_t size;
+    int64_t modifiedTime;
+    if (existing != m_Entries.end() && GetFileStamp(key.c_str(), size, modifiedTime) &&
+        existing->second.size == size && existing->second.modifiedTime == modifiedTime) {
+        return existing->second;
+    }
+
+    RomImage rom(key.c_str());
+    m_Scanned++;
+
+    RomInfo info{};
+    uint64_t hash = rom.GetHash();
+    if (existing != m_Entries.end() && existing->second.hash == hash) {
+        info = existing->second;
+    } else if (const RomInfo* known = Find(hash)) {
+        info = *known;
+    } else {
+        info.variant = IdentifyVariant(rom.GetData(), rom.GetSize());
+        info.quirks = DefaultQuirkProfile(info.variant);
+        info.clockHz = SuggestedClock(info.variant);
+        info.title = std::filesystem::path(key).stem().string();
+    }
+    info.hash = hash;
+    info.size = rom.GetSize();
+    info.modifiedTime = rom.GetModifiedTime();
+
+    return m_Entries[key] = info;
+}
+
+size_t RomCatalog::Prune() {
+    return std::erase_if(m_Entries, [](const auto& entry) {
+        std::error_code error;
+        return !std::filesystem::exists(entry.first, error);
+    });
+}
+
+const RomInfo* RomCatalog::Find(uint64_t hash) const {
+    for (const auto& entry : m_Entries) {
+        if (entry.second.hash == hash) {
+            return &entry.second;
+        }
+    }
+    return nullptr;
+}
+
+RomInfo LookUpRom(const char* catalogFilename, const char* romFilename) {
+    RomCatalog catalog;
+    catalog.Load(catalogFilename);
+    RomInfo info = catalog.Update(romFilename);
+    if (catalog.GetScannedCount() > 0) {
+        catalog.Save(catalogFilename);
+    }
+    return info;
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "environment.hpp"
+#include <getopt.h>
+
+using Clock = std::chrono::steady_clock;
+using Seconds = std::chrono::duration<double>;
+
+// Steps the same set of instances on 1..N worker threads and reports the
+// aggregate emulated frames per second for each thread count
+int main(int argc, char* argv[])
+{
+    // Arguments - Default Values
+    size_t instances = 4096;
+    unsigned int steps = 20;
+    unsigned int framesPerStep = 4;
+    unsigned int maxThreads = std::thread::hardware_concurrency();
+    const char* romFilename = nullptr;
+
+    // Command-line options
+    static struct option long_options[] = {
+        {"instances", required_argument, 0, 'i'},
+        {"steps", required_argument, 0, 's'},
+        {"frames-per-step", required_argument, 0, 'k'},
+        {"max-threads", required_argument, 0, 't'},
+        {"rom", required_argument, 0, 'r'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    int option_index = 0;
+    while ((opt = getopt_long(argc, argv, "i:s:k:t:r:", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'i':
+                instances = std::stoull(optarg);
+                break;
+            case 's':
+                steps = std::stoul(optarg);
+                break;
+            case 'k':
+                framesPerStep = std::stoul(optarg);
+                break;
+            case 't':
+                maxThreads = std::stoul(optarg);
+                break;
+            case 'r':
+                romFilename = optarg;
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0] << " [options] <ROM file>\n"
+                          << "Options:\n"
+                          << "  --instances <n>        Emulator instances (default: 4096)\n"
+                          << "  --steps <n>            Steps per thread count (default: 20)\n"
+                          << "  --frames-per-step <k>  Frames each instance runs per step (default: 4)\n"
+                          << "  --max-threads <n>      Highest thread count to try (default: all cores)\n";
+                return 1;
+        }
+    }
+
+    if (romFilename == nullptr && optind < argc) {
+        romFilename = argv[optind];
+    }
+
+    if (romFilename == nullptr) {
+        std::cerr << "ROM file is required. Usage: " << argv[0] << " [options] <ROM file>\n";
+        return 1;
+    }
+
+    maxThreads = std::max(1u, maxThreads);
+    std::vector<uint16_t> keys(instances, 0);
+
+    std::cout << "threads  frames/sec      speedup\n";
+
+    double baseline = 0.0;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+        try {
+            Chip8Emulator::Environment env(instances, romFilename, threads);
+
+            // Warm up caches and page in every instance before timing
+            env.Step(keys.data(), 1);
+
+            auto start = Clock::now();
+            for (unsigned int step = 0; step < steps; step++) {
+                env.Step(keys.data(), framesPerStep);
+            }
+            double seconds = std::chrono::duration_cast<Seconds>(Clock::now() - start).count();
+
+            double framesPerSecond = static_cast<double>(instances) * steps * framesPerStep / seconds;
+            if (threads == 1) {
+                baseline = framesPerSecond;
+            }
+
+            std::cout << threads << "\t " << static_cast<uint64_t>(framesPerSecond)
+                      << "\t " << framesPerSecond / baseline << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "Benchmark failed: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
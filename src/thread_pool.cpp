@@ -0,0 +1,147 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Chip8Emulator{
+
+bool ThreadPool::WorkQueue::PopBack(Range& range) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == tail) {
+        return false;
+    }
+
+    range = ranges[--tail];
+    return true;
+}
+
+bool ThreadPool::WorkQueue::PopFront(Range& range) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == tail) {
+        return false;
+    }
+
+    range = ranges[head++];
+    return true;
+}
+
+ThreadPool::ThreadPool(unsigned int threads, bool pin) {
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    if (threads == 0) {
+        threads = cores;
+    }
+
+    m_Queues = std::make_unique<WorkQueue[]>(threads);
+    m_Workers.reserve(threads);
+
+    for (unsigned int id = 0; id < threads; id++) {
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, id);
+
+#ifdef __linux__
+        if (pin) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(id % cores, &cpus);
+            pthread_setaffinity_np(m_Workers.back().native_handle(), sizeof(cpus), &cpus);
+        }
+#else
+        (void)pin;
+#endif
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_WorkReady.notify_all();
+
+    for (auto& worker : m_Workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain, TaskFunc func, void* context) {
+    if (count == 0) {
+        return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    unsigned int threads = GetThreadCount();
+
+    // Deal the chunks out round-robin so every worker starts on local work
+    for (unsigned int id = 0; id < threads; id++) {
+        WorkQueue& queue = m_Queues[id];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.head = 0;
+        queue.tail = 0;
+
+        size_t needed = (chunks + threads - 1 - id) / threads;
+        if (queue.ranges.size() < needed) {
+            queue.ranges.resize(needed);
+        }
+    }
+
+    m_Func = func;
+    m_Context = context;
+    m_Remaining.store(chunks, std::memory_order_relaxed);
+
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        WorkQueue& queue = m_Queues[chunk % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        size_t begin = chunk * grain;
+        queue.ranges[queue.tail++] = { begin, std::min(begin + grain, count) };
+    }
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Generation++;
+    m_WorkReady.notify_all();
+    m_WorkDone.wait(lock, [this]() { return m_Remaining.load(std::memory_order_acquire) == 0; });
+}
+
+bool ThreadPool::NextRange(unsigned int id, Range& range) {
+    if (m_Queues[id].PopBack(range)) {
+        return true;
+    }
+
+    unsigned int threads = GetThreadCount();
+    for (unsigned int offset = 1; offset < threads; offset++) {
+        if (m_Queues[(id + offset) % threads].PopFront(range)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned int id) {
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WorkReady.wait(lock, [&]() { return m_Stop || m_Generation != seen; });
+            if (m_Stop) {
+                return;
+            }
+            seen = m_Generation;
+        }
+
+        Range range;
+        while (NextRange(id, range)) {
+            m_Func(m_Context, range.begin, range.end);
+
+            if (m_Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_WorkDone.notify_all();
+            }
+        }
+    }
+}
+
+} // namespace Chip8Emulator
@@ -0,0 +1,51 @@
+#include "trace.hpp"
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+namespace Chip8Emulator{
+
+namespace {
+
+constexpr size_t WRITE_BATCH = 4096;
+
+} // namespace
+
+Tracer::Tracer(const char* filename)
+: m_File(std::fopen(filename, "wb"))
+{
+    if (!m_File) {
+        throw std::runtime_error("Failed to create trace file.");
+    }
+
+    uint32_t header[2] = { TRACE_MAGIC, TRACE_VERSION };
+    std::fwrite(header, sizeof(header), 1, m_File);
+
+    m_Writer = std::thread([this]() {
+        auto buffer = std::make_unique<TraceRecord[]>(WRITE_BATCH);
+        while (!m_Stop.load(std::memory_order_acquire)) {
+            Drain(buffer.get(), WRITE_BATCH);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Drain(buffer.get(), WRITE_BATCH);
+    });
+}
+
+Tracer::~Tracer() {
+    m_Stop.store(true, std::memory_order_release);
+    m_Writer.join();
+    std::fclose(m_File);
+}
+
+void Tracer::Drain(TraceRecord* buffer, size_t capacity) {
+    size_t count;
+    do {
+        count = 0;
+        while (count < capacity && m_Ring.Pop(buffer[count])) {
+            count++;
+        }
+        std::fwrite(buffer, sizeof(TraceRecord), count, m_File);
+    } while (count == capacity);
+}
+
+} // namespace Chip8Emulator